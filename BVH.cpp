@@ -0,0 +1,158 @@
+#include "BVH.h"
+#include <algorithm>
+
+namespace {
+    const int BIN_COUNT = 12;
+    /// <summary>
+    /// Past this depth splits fall back to the object median so traversal stacks stay bounded
+    /// </summary>
+    const int MAX_SAH_DEPTH = 32;
+
+    struct Bin {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+}
+
+void BVH::Build(const std::vector<AABB>& primitiveBounds, uint32_t maxLeafSize) {
+    Clear();
+    uint32_t primitiveCount = (uint32_t)primitiveBounds.size();
+    if (primitiveCount == 0) return;
+    if (maxLeafSize == 0) maxLeafSize = 1;
+
+    std::vector<glm::vec3> centroids(primitiveCount);
+    primitives.resize(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
+        centroids[i] = primitiveBounds[i].Center();
+        primitives[i] = i;
+    }
+
+    nodes.reserve(2 * primitiveCount / maxLeafSize + 1);
+    nodes.emplace_back();
+    nodes[0].leftFirst = 0;
+    nodes[0].count = primitiveCount;
+
+    struct Task {
+        uint32_t node;
+        int depth;
+    };
+    std::vector<Task> tasks;
+    tasks.push_back({ 0, 0 });
+
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        uint32_t first = nodes[task.node].leftFirst;
+        uint32_t count = nodes[task.node].count;
+
+        AABB bounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; ++i) {
+            bounds.Expand(primitiveBounds[primitives[i]]);
+            centroidBounds.Expand(centroids[primitives[i]]);
+        }
+        nodes[task.node].bounds = bounds;
+
+        if (count <= maxLeafSize)
+            continue;
+
+        glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+        int axis = 0;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+        // every centroid coincides, nothing to split on
+        if (extent[axis] <= 0.0f)
+            continue;
+
+        uint32_t mid = first;
+        if (task.depth < MAX_SAH_DEPTH) {
+            //Binned surface area heuristic
+            Bin bins[BIN_COUNT];
+            float scale = BIN_COUNT / extent[axis];
+            for (uint32_t i = first; i < first + count; ++i) {
+                int b = std::min(BIN_COUNT - 1, (int)((centroids[primitives[i]][axis] - centroidBounds.min[axis]) * scale));
+                bins[b].count++;
+                bins[b].bounds.Expand(primitiveBounds[primitives[i]]);
+            }
+
+            float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+            uint32_t leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+            AABB leftBox, rightBox;
+            uint32_t leftSum = 0, rightSum = 0;
+            for (int i = 0; i < BIN_COUNT - 1; ++i) {
+                leftSum += bins[i].count;
+                leftCount[i] = leftSum;
+                leftBox.Expand(bins[i].bounds);
+                leftArea[i] = leftBox.IsValid() ? leftBox.SurfaceArea() : 0.0f;
+
+                rightSum += bins[BIN_COUNT - 1 - i].count;
+                rightCount[BIN_COUNT - 2 - i] = rightSum;
+                rightBox.Expand(bins[BIN_COUNT - 1 - i].bounds);
+                rightArea[BIN_COUNT - 2 - i] = rightBox.IsValid() ? rightBox.SurfaceArea() : 0.0f;
+            }
+
+            float bestCost = FLT_MAX;
+            int bestSplit = -1;
+            for (int i = 0; i < BIN_COUNT - 1; ++i) {
+                if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = i;
+                }
+            }
+
+            // Splitting has to beat intersecting everything in one leaf
+            float leafCost = count * bounds.SurfaceArea();
+            if (bestSplit >= 0 && (bestCost < leafCost || count > 4 * maxLeafSize)) {
+                auto it = std::partition(primitives.begin() + first, primitives.begin() + first + count,
+                    [&](uint32_t p) {
+                        int b = std::min(BIN_COUNT - 1, (int)((centroids[p][axis] - centroidBounds.min[axis]) * scale));
+                        return b <= bestSplit;
+                    });
+                mid = (uint32_t)(it - primitives.begin());
+            }
+            else {
+                continue;
+            }
+        }
+
+        if (mid == first || mid == first + count) {
+            // Object median split
+            mid = first + count / 2;
+            std::nth_element(primitives.begin() + first, primitives.begin() + mid, primitives.begin() + first + count,
+                [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+
+        uint32_t leftIndex = (uint32_t)nodes.size();
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[leftIndex].leftFirst = first;
+        nodes[leftIndex].count = mid - first;
+        nodes[leftIndex + 1].leftFirst = mid;
+        nodes[leftIndex + 1].count = first + count - mid;
+
+        nodes[task.node].leftFirst = leftIndex;
+        nodes[task.node].count = 0;
+
+        tasks.push_back({ leftIndex, task.depth + 1 });
+        tasks.push_back({ leftIndex + 1, task.depth + 1 });
+    }
+}
+
+void BVH::Refit(const std::vector<AABB>& primitiveBounds) {
+    //children are always stored after their parent, so walking backwards finishes them first
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        AABB bounds;
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.count; ++i)
+                bounds.Expand(primitiveBounds[primitives[node.leftFirst + i]]);
+        }
+        else {
+            bounds.Expand(nodes[node.leftFirst].bounds);
+            bounds.Expand(nodes[node.leftFirst + 1].bounds);
+        }
+        node.bounds = bounds;
+    }
+}
\ No newline at end of file
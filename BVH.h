@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Bounds.h"
+
+/// <summary>
+/// Bounding volume hierarchy over a list of boxes. Only stores primitive indices, so the same tree type is used
+/// for scene objects and for triangles of a single mesh.
+/// </summary>
+class BVH {
+public:
+    struct Node {
+        AABB bounds;
+        /// <summary>
+        /// Index of the left child for interior nodes (right child is leftFirst + 1), first primitive slot for leaves
+        /// </summary>
+        uint32_t leftFirst = 0;
+        /// <summary>
+        /// Number of primitives, 0 for interior nodes
+        /// </summary>
+        uint32_t count = 0;
+
+        bool IsLeaf() const { return count > 0; }
+    };
+
+    std::vector<Node> nodes;
+    /// <summary>
+    /// Primitive indices, leaves reference contiguous ranges of this array
+    /// </summary>
+    std::vector<uint32_t> primitives;
+
+    /// <summary>
+    /// Builds the tree with binned SAH splits. primitiveBounds[i] is the box of primitive i.
+    /// </summary>
+    void Build(const std::vector<AABB>& primitiveBounds, uint32_t maxLeafSize = 4);
+
+    /// <summary>
+    /// Recomputes every node's box from primitiveBounds and keeps the splits. Much cheaper than Build when the same
+    /// primitives have moved, but queries slow down as they drift from where the splits were chosen.
+    /// </summary>
+    void Refit(const std::vector<AABB>& primitiveBounds);
+
+    void Clear() {
+        nodes.clear();
+        primitives.clear();
+    }
+
+    bool Empty() const {
+        return nodes.empty();
+    }
+
+    /// <summary>
+    /// Calls visit(primitiveIndex, containment) for every primitive whose node is not outside the frustum.
+    /// Primitives under a fully contained node are reported as Inside without testing them,
+    /// the others are tested against their own box.
+    /// </summary>
+    template<typename Visit>
+    void QueryFrustum(const Frustum& frustum, const std::vector<AABB>& primitiveBounds, Visit&& visit) const {
+        if (nodes.empty()) return;
+        uint32_t stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            Containment c = frustum.TestAABB(node.bounds);
+            if (c == Containment::Outside)
+                continue;
+            if (c == Containment::Inside) {
+                VisitAll(node, Containment::Inside, visit);
+                continue;
+            }
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    uint32_t prim = primitives[node.leftFirst + i];
+                    Containment pc = frustum.TestAABB(primitiveBounds[prim]);
+                    if (pc != Containment::Outside)
+                        visit(prim, pc);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.leftFirst;
+            stack[stackSize++] = node.leftFirst + 1;
+        }
+    }
+
+    /// <summary>
+    /// Calls visit(primitiveIndex) for every primitive whose box the ray crosses in front of its origin.
+    /// Nothing is sorted or cut short, callers that only want the closest hit have to keep track themselves.
+    /// </summary>
+    template<typename Visit>
+    void QueryRay(const glm::vec3& origin, const glm::vec3& dir, const std::vector<AABB>& primitiveBounds, Visit&& visit) const {
+        if (nodes.empty()) return;
+        glm::vec3 invDir = 1.0f / dir;
+        uint32_t stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (!node.bounds.IntersectsRay(origin, invDir))
+                continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    uint32_t prim = primitives[node.leftFirst + i];
+                    if (primitiveBounds[prim].IntersectsRay(origin, invDir))
+                        visit(prim);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.leftFirst;
+            stack[stackSize++] = node.leftFirst + 1;
+        }
+    }
+
+    /// <summary>
+    /// Calls visit(primitiveIndex) for every primitive whose box overlaps box
+    /// </summary>
+    template<typename Visit>
+    void QueryBox(const AABB& box, const std::vector<AABB>& primitiveBounds, Visit&& visit) const {
+        if (nodes.empty()) return;
+        uint32_t stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (!node.bounds.Intersects(box))
+                continue;
+            if (node.IsLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    uint32_t prim = primitives[node.leftFirst + i];
+                    if (primitiveBounds[prim].Intersects(box))
+                        visit(prim);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.leftFirst;
+            stack[stackSize++] = node.leftFirst + 1;
+        }
+    }
+
+private:
+    template<typename Visit>
+    void VisitAll(const Node& root, Containment c, Visit& visit) const {
+        uint32_t stack[128];
+        int stackSize = 0;
+        const Node* node = &root;
+        while (true) {
+            if (node->IsLeaf()) {
+                for (uint32_t i = 0; i < node->count; ++i)
+                    visit(primitives[node->leftFirst + i], c);
+            }
+            else {
+                stack[stackSize++] = node->leftFirst + 1;
+                stack[stackSize++] = node->leftFirst;
+            }
+            if (stackSize == 0)
+                break;
+            node = &nodes[stack[--stackSize]];
+        }
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+
+/// <summary>
+/// Axis aligned bounding box. Starts out inverted so the first Expand call initializes it.
+/// </summary>
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool IsValid() const {
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    void Expand(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void Expand(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 Center() const {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 Extents() const {
+        return (max - min) * 0.5f;
+    }
+
+    float SurfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    /// <summary>
+    /// True when the boxes overlap, touching counts
+    /// </summary>
+    bool Intersects(const AABB& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x &&
+            min.y <= other.max.y && other.min.y <= max.y &&
+            min.z <= other.max.z && other.min.z <= max.z;
+    }
+
+    /// <summary>
+    /// Slab test of the ray origin + t * dir for t >= 0, invDir is 1 / dir per component (infinities are fine)
+    /// </summary>
+    bool IntersectsRay(const glm::vec3& origin, const glm::vec3& invDir) const {
+        glm::vec3 t0 = (min - origin) * invDir;
+        glm::vec3 t1 = (max - origin) * invDir;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+        float exit = glm::min(glm::min(tFar.x, tFar.y), tFar.z);
+        return enter <= exit;
+    }
+
+    /// <summary>
+    /// Bounds of this box after being transformed by an affine matrix (Arvo's method, no corner loop)
+    /// </summary>
+    AABB Transformed(const glm::mat4& m) const {
+        if (!IsValid()) return *this;
+        glm::vec3 center = glm::vec3(m * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 newExtents(0.0f);
+        for (int col = 0; col < 3; ++col) {
+            newExtents += glm::abs(glm::vec3(m[col])) * extents[col];
+        }
+        AABB result;
+        result.min = center - newExtents;
+        result.max = center + newExtents;
+        return result;
+    }
+};
+
+/// <summary>
+/// Sphere enclosing a set of points, radius is negative while empty
+/// </summary>
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f;
+
+    bool IsValid() const {
+        return radius >= 0.0f;
+    }
+
+    /// <summary>
+    /// Sphere after an affine transform, non uniform scales grow the radius by the largest axis scale
+    /// </summary>
+    BoundingSphere Transformed(const glm::mat4& m) const {
+        if (!IsValid()) return *this;
+        BoundingSphere result;
+        result.center = glm::vec3(m * glm::vec4(center, 1.0f));
+        float maxScale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        result.radius = radius * maxScale;
+        return result;
+    }
+};
+
+/// <summary>
+/// Result of testing a volume against a frustum
+/// </summary>
+enum class Containment {
+    Outside = 0,
+    Intersecting = 1,
+    Inside = 2
+};
+
+/// <summary>
+/// Six inward facing planes (xyz = normal, w = distance) extracted from a view projection matrix.
+/// </summary>
+struct Frustum {
+    glm::vec4 planes[6];
+
+    /// <summary>
+    /// Extracts the planes bounding the part of clip space that maps to [ndcMin, ndcMax] in normalized device coordinates.
+    /// The default range is the whole view, a smaller range gives the sub-frustum of a screen rectangle.
+    /// </summary>
+    static Frustum FromMatrix(const glm::mat4& viewProjection,
+        glm::vec2 ndcMin = glm::vec2(-1.0f),
+        glm::vec2 ndcMax = glm::vec2(1.0f))
+    {
+        // rows of the matrix, glm is column major
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row0 - ndcMin.x * row3; // left:   x >= xmin * w
+        frustum.planes[1] = ndcMax.x * row3 - row0; // right:  x <= xmax * w
+        frustum.planes[2] = row1 - ndcMin.y * row3; // bottom: y >= ymin * w
+        frustum.planes[3] = ndcMax.y * row3 - row1; // top:    y <= ymax * w
+        frustum.planes[4] = row3 + row2;            // near
+        frustum.planes[5] = row3 - row2;            // far
+        for (auto& p : frustum.planes) {
+            p /= glm::length(glm::vec3(p));
+        }
+        return frustum;
+    }
+
+    /// <summary>
+    /// Returns this frustum expressed in the local space of an object with the given model matrix.
+    /// </summary>
+    Frustum ToLocalSpace(const glm::mat4& model) const {
+        Frustum local;
+        glm::mat4 modelT = glm::transpose(model);
+        for (int i = 0; i < 6; ++i) {
+            local.planes[i] = modelT * planes[i];
+            local.planes[i] /= glm::length(glm::vec3(local.planes[i]));
+        }
+        return local;
+    }
+
+    bool ContainsPoint(const glm::vec3& p) const {
+        for (const auto& plane : planes) {
+            if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    Containment TestSphere(const glm::vec3& center, float radius) const {
+        Containment result = Containment::Inside;
+        for (const auto& plane : planes) {
+            float d = glm::dot(glm::vec3(plane), center) + plane.w;
+            if (d < -radius)
+                return Containment::Outside;
+            if (d < radius)
+                result = Containment::Intersecting;
+        }
+        return result;
+    }
+
+    Containment TestAABB(const AABB& box) const {
+        if (!box.IsValid()) return Containment::Outside;
+        glm::vec3 center = box.Center();
+        glm::vec3 extents = box.Extents();
+        Containment result = Containment::Inside;
+        for (const auto& plane : planes) {
+            glm::vec3 n(plane);
+            float d = glm::dot(n, center) + plane.w;
+            float r = glm::dot(glm::abs(n), extents);
+            if (d < -r)
+                return Containment::Outside;
+            if (d < r)
+                result = Containment::Intersecting;
+        }
+        return result;
+    }
+
+    /// <summary>
+    /// Exact test of a triangle against the frustum by clipping it against every plane.
+    /// </summary>
+    bool IntersectsTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) const {
+        // Clip polygon can gain one vertex per plane: 3 + 6
+        glm::vec3 polygon[9] = { v0, v1, v2 };
+        glm::vec3 clipped[9];
+        int count = 3;
+        for (const auto& plane : planes) {
+            int outCount = 0;
+            for (int i = 0; i < count; ++i) {
+                const glm::vec3& a = polygon[i];
+                const glm::vec3& b = polygon[(i + 1) % count];
+                float da = glm::dot(glm::vec3(plane), a) + plane.w;
+                float db = glm::dot(glm::vec3(plane), b) + plane.w;
+                if (da >= 0.0f)
+                    clipped[outCount++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f))
+                    clipped[outCount++] = a + (b - a) * (da / (da - db));
+            }
+            count = outCount;
+            if (count == 0)
+                return false;
+            for (int i = 0; i < count; ++i)
+                polygon[i] = clipped[i];
+        }
+        return true;
+    }
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Mesh elements live in their mesh's ElementPool, so dropping one of these pointers frees nothing
+/// </summary>
+struct PooledElement {
+    template <typename T>
+    void operator()(T*) const noexcept {}
+};
+
+/// <summary>
+/// Pointer to a vertex, half edge or face owned by its mesh's pool
+/// </summary>
+template <typename T>
+using ElementPtr = std::unique_ptr<T, PooledElement>;
+
+/// <summary>
+/// Storage for one kind of mesh element, handed out from blocks that are all freed together with the pool.
+/// Whole topology rebuilds take a single block instead of one allocation per element. Removed elements keep
+/// their slot until the pool goes.
+/// </summary>
+template <typename T>
+class ElementPool {
+public:
+    /// <summary>
+    /// Blocks for elements added one at a time start small and double up to this
+    /// </summary>
+    static constexpr size_t MAX_GROWTH = 1 << 16;
+
+    ElementPool() = default;
+
+    ElementPool(const ElementPool&) = delete;
+    ElementPool& operator=(const ElementPool&) = delete;
+
+    ElementPool(ElementPool&& other) noexcept
+        : blocks(std::move(other.blocks)), used(std::exchange(other.used, 0)), capacity(std::exchange(other.capacity, 0)),
+        allocated(std::exchange(other.allocated, 0)) {}
+
+    ElementPool& operator=(ElementPool&& other) noexcept {
+        blocks = std::move(other.blocks);
+        used = std::exchange(other.used, 0);
+        capacity = std::exchange(other.capacity, 0);
+        allocated = std::exchange(other.allocated, 0);
+        return *this;
+    }
+
+    /// <summary>
+    /// Returns count default constructed elements next to each other
+    /// </summary>
+    T* Allocate(size_t count = 1) {
+        if (count == 0)
+            return nullptr;
+        if (count > capacity - used) {
+            size_t size = std::max(count, std::min(std::max<size_t>(256, allocated), MAX_GROWTH));
+            blocks.emplace_back(new T[size]);
+            used = 0;
+            capacity = size;
+            allocated += size;
+        }
+        T* first = blocks.back().get() + used;
+        used += count;
+        return first;
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>> blocks;
+    //of the last block
+    size_t used = 0, capacity = 0;
+    size_t allocated = 0;
+};
\ No newline at end of file
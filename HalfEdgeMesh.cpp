@@ -0,0 +1,578 @@
+#include "HalfEdgeMesh.h"
+#include "Trace.h"
+#include "Parallel.h"
+#include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <atomic>
+
+/// <summary>
+/// Orders faces along a Morton curve through their first vertex so consecutive faces are spatially close
+/// </summary>
+static void SortFacesSpatially(std::vector<const Face*>& faces)
+{
+    AABB bounds;
+    for (const Face* f : faces)
+        bounds.Expand(f->edge->origin->position);
+    glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(1e-20f));
+
+    //spread the low 10 bits of x so there are two zero bits between each
+    auto spreadBits = [](uint32_t x) {
+        x = (x | (x << 16)) & 0x030000FF;
+        x = (x | (x << 8)) & 0x0300F00F;
+        x = (x | (x << 4)) & 0x030C30C3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    };
+
+    std::vector<std::pair<uint32_t, const Face*>> keyed;
+    keyed.reserve(faces.size());
+    for (const Face* f : faces) {
+        glm::vec3 t = (f->edge->origin->position - bounds.min) / extent;
+        glm::uvec3 q = glm::uvec3(glm::clamp(t, 0.0f, 1.0f) * 1023.0f);
+        keyed.push_back({ spreadBits(q.x) | (spreadBits(q.y) << 1) | (spreadBits(q.z) << 2), f });
+    }
+    std::stable_sort(keyed.begin(), keyed.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (size_t i = 0; i < keyed.size(); ++i)
+        faces[i] = keyed[i].second;
+}
+
+/// <summary>
+/// Unnormalized normal of the plane through the first three vertices, same as ComputeNormals uses
+/// </summary>
+static glm::vec3 FaceNormal(const Face* f)
+{
+    const HalfEdge* e0 = f->edge;
+    glm::vec3 p0 = e0->origin->position;
+    glm::vec3 p1 = e0->next->origin->position;
+    glm::vec3 p2 = e0->next->next->origin->position;
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+/// <summary>
+/// Boundary edges and edges whose faces meet at more than the feature angle. Edges with a twin are only reported from one side.
+/// </summary>
+static bool IsFeatureEdge(const HalfEdge* e)
+{
+    if (!e->twin)
+        return true;
+    if (!std::less<const HalfEdge*>()(e, e->twin))
+        return false;
+    glm::vec3 a = FaceNormal(e->face), b = FaceNormal(e->twin->face);
+    float lengths = glm::length(a) * glm::length(b);
+    return lengths > 0.0f && glm::dot(a, b) < FEATURE_EDGE_COSINE * lengths;
+}
+
+void HalfEdgeMesh::MeshToTriangles(const HalfEdgeMesh& mesh,
+    std::vector<glm::vec3>& outPositions,
+    std::vector<glm::vec3>& outNormals,
+    std::vector<unsigned int>& outIndices,
+    std::vector<unsigned int>& outEdgeIndices,
+    std::vector<MeshCluster>* outClusters,
+    std::vector<unsigned int>* outFeatureEdges
+)
+{
+    TRACE_SCOPE("Triangulate");
+    outPositions.clear();
+    outNormals.clear();
+    outIndices.clear();
+    outEdgeIndices.clear();
+    if (outClusters)
+        outClusters->clear();
+    if (outFeatureEdges)
+        outFeatureEdges->clear();
+
+    //Faces are visited in spatial order when clustering so each cluster ends up a compact patch
+    bool clustering = outClusters && mesh.faces.size() >= CLUSTER_MIN_FACES;
+    std::vector<const Face*> faceOrder;
+    faceOrder.reserve(mesh.faces.size());
+    for (auto& f : mesh.faces)
+        faceOrder.push_back(f.get());
+    if (clustering)
+        SortFacesSpatially(faceOrder);
+
+    //Smooth shading shares vertices, so edges are deduplicated by sorting their keys.
+    //This happens per cluster so an edge on a cluster border belongs to both and stays visible if either is drawn
+    std::vector<uint64_t> edgeKeys;
+    MeshCluster cluster;
+    auto closeCluster = [&]() {
+        if (!edgeKeys.empty()) {
+            std::sort(edgeKeys.begin(), edgeKeys.end());
+            edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+            for (uint64_t key : edgeKeys) {
+                outEdgeIndices.push_back((unsigned int)(key >> 32));
+                outEdgeIndices.push_back((unsigned int)(key & 0xFFFFFFFF));
+            }
+            edgeKeys.clear();
+        }
+        if (clustering && outIndices.size() > cluster.indexOffset) {
+            cluster.indexCount = (unsigned int)outIndices.size() - cluster.indexOffset;
+            cluster.edgeCount = (unsigned int)outEdgeIndices.size() - cluster.edgeOffset;
+            outClusters->push_back(cluster);
+        }
+        cluster = MeshCluster();
+        cluster.indexOffset = (unsigned int)outIndices.size();
+        cluster.edgeOffset = (unsigned int)outEdgeIndices.size();
+    };
+    auto clusterFull = [&]() {
+        return clustering && outIndices.size() - cluster.indexOffset >= CLUSTER_TRIANGLES * 3;
+    };
+
+    if (!mesh.flatShading)
+    {
+        std::unordered_map<const Vertex*, unsigned int> vertexToIndex;
+
+        unsigned int index = 0;
+        //Push all vertices to the vertex buffer
+        for (auto& v : mesh.vertices) {
+            outPositions.push_back(v->position);
+            outNormals.push_back(v->normal);
+            //Add all vertices to a dictionary with an increasing key
+            vertexToIndex[v.get()] = index++;
+        }
+
+        std::vector<unsigned int> faceIndices;
+        //Loop through all faces
+        for (const Face* f : faceOrder) {
+            faceIndices.clear();
+            const HalfEdge* start = f->edge;
+            const HalfEdge* e = start;
+
+            //Loop through each half edge on the face
+            do {
+                faceIndices.push_back(vertexToIndex.at(e->origin));
+                //calculate edge pairs
+                unsigned int i0 = vertexToIndex.at(e->origin);
+                unsigned int i1 = vertexToIndex.at(e->next->origin);
+
+                // Sort to avoid duplicate reversed edge pairs
+                unsigned int a = std::min(i0, i1);
+                unsigned int b = std::max(i0, i1);
+
+                // Unique edge key
+                edgeKeys.push_back((uint64_t)a << 32 | b);
+
+                if (outFeatureEdges && IsFeatureEdge(e)) {
+                    outFeatureEdges->push_back(i0);
+                    outFeatureEdges->push_back(i1);
+                }
+
+                e = e->next;
+            } while (e != start);
+
+            //Triangulate the polygon with fanning
+            for (size_t i = 1; i + 1 < faceIndices.size(); ++i) {
+                outIndices.push_back(faceIndices[0]);
+                outIndices.push_back(faceIndices[i]);
+                outIndices.push_back(faceIndices[i + 1]);
+            }
+            if (clusterFull())
+                closeCluster();
+        }
+    }
+    else
+    {
+        std::vector<glm::vec3> faceVerts;
+        //Will result in duplicate vertices, which is intended for flat shading since a vertex can only store one normal
+        for (const Face* f : faceOrder) {
+            const HalfEdge* start = f->edge;
+            const HalfEdge* e = start;
+
+            faceVerts.clear();
+            //Push back all connected vertices into vertex buffer for each face
+            do {
+                faceVerts.push_back(e->origin->position);
+
+                e = e->next;
+            } while (e != start);
+
+            // Compute face normal once
+            if (faceVerts.size() >= 3) {
+                unsigned int faceStart = outPositions.size();
+                glm::vec3 n = glm::normalize(glm::cross(faceVerts[1] - faceVerts[0],
+                    faceVerts[2] - faceVerts[0]));
+
+                // Fan triangulate with duplicated vertices
+                for (size_t i = 1; i + 1 < faceVerts.size(); ++i) {
+                    glm::vec3 p0 = faceVerts[0];
+                    glm::vec3 p1 = faceVerts[i];
+                    glm::vec3 p2 = faceVerts[i + 1];
+
+
+                    unsigned int startIndex = outPositions.size();
+
+                    outPositions.push_back(p0);
+                    outPositions.push_back(p1);
+                    outPositions.push_back(p2);
+
+                    outNormals.push_back(n);
+                    outNormals.push_back(n);
+                    outNormals.push_back(n);
+
+                    outIndices.push_back(startIndex);
+                    outIndices.push_back(startIndex + 1);
+                    outIndices.push_back(startIndex + 2);
+
+                    //Get edge indices
+                    //TODO: use a hash map of vertex positions to prevent duplicates
+                    outEdgeIndices.push_back(startIndex + 1);
+                    outEdgeIndices.push_back(startIndex + 2);
+                    if (i == faceVerts.size() - 2) {
+                        outEdgeIndices.push_back(startIndex);
+                        outEdgeIndices.push_back(startIndex + 2);
+                    }
+                    if (i == 1) {
+                        outEdgeIndices.push_back(startIndex);
+                        outEdgeIndices.push_back(startIndex + 1);
+                    }
+                }
+
+                if (outFeatureEdges) {
+                    //render vertex of face corner k: the first triangle holds corners 0 and 1,
+                    //every later corner is the middle vertex of its triangle and the last one closes the fan
+                    size_t n = faceVerts.size();
+                    auto cornerIndex = [&](size_t k) -> unsigned int {
+                        if (k == 0) return faceStart;
+                        if (k == n - 1) return faceStart + 3 * (unsigned int)(n - 3) + 2;
+                        return faceStart + 3 * (unsigned int)(k - 1) + 1;
+                    };
+                    const HalfEdge* fe = start;
+                    size_t k = 0;
+                    do {
+                        if (IsFeatureEdge(fe)) {
+                            outFeatureEdges->push_back(cornerIndex(k));
+                            outFeatureEdges->push_back(cornerIndex((k + 1) % n));
+                        }
+                        fe = fe->next;
+                        k++;
+                    } while (fe != start);
+                }
+            }
+            if (clusterFull())
+                closeCluster();
+        }
+    }
+    closeCluster();
+
+    if (clustering) {
+        for (auto& c : *outClusters)
+            ComputeClusterBounds(c, outPositions, outIndices);
+    }
+}
+
+void HalfEdgeMesh::ComputeNormals(HalfEdgeMesh& mesh)
+{
+    TRACE_SCOPE("Normals");
+    // Reset all vertex normals
+    for (auto& v : mesh.vertices)
+        v->normal = glm::vec3(0.0f);
+
+    // Compute face normals and accumulate into vertex normals
+    for (auto& f : mesh.faces)
+    {
+        HalfEdge* e0 = f->edge;
+        if (!e0 || !e0->next || !e0->next->next)
+            continue;
+
+        glm::vec3 p0 = e0->origin->position;
+        glm::vec3 p1 = e0->next->origin->position;
+        glm::vec3 p2 = e0->next->next->origin->position;
+
+        glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+
+        // Assign to all vertices in this face
+        HalfEdge* e = e0;
+        do {
+            e->origin->normal += normal;
+            e = e->next;
+        } while (e != e0);
+    }
+
+    // Normalize accumulated vertex normals
+    for (auto& v : mesh.vertices)
+        v->normal = glm::normalize(v->normal);
+}
+
+Vertex* HalfEdgeMesh::addVertex(const glm::vec3& pos) {
+    vertices.emplace_back(vertexPool.Allocate());
+    Vertex* v = vertices.back().get();
+    v->position = pos;
+    boundsDirty = true;
+    return v;
+}
+
+Face* HalfEdgeMesh::addFace(const std::vector<Vertex*>& verts) {
+    if (verts.size() < 3) return nullptr;
+    if (edgeMapDirty)
+        RebuildEdgeMap();
+
+    faces.emplace_back(facePool.Allocate());
+    Face* face = faces.back().get();
+
+    std::vector<HalfEdge*> edges;
+    edges.reserve(verts.size());
+
+    // Create one edge per vertex
+    for (size_t i = 0; i < verts.size(); ++i) {
+        halfEdges.emplace_back(halfEdgePool.Allocate());
+        HalfEdge* e = halfEdges.back().get();
+
+        e->origin = verts[i];
+        e->face = face;
+        edges.push_back(e);
+
+        if (!verts[i]->outgoing)
+            verts[i]->outgoing = e;
+    }
+
+    // Link edges circularly
+    for (size_t i = 0; i < edges.size(); ++i) {
+        edges[i]->next = edges[(i + 1) % edges.size()];
+    }
+
+    face->edge = edges[0];
+
+    // Twin linking (works the same as before)
+    for (auto* e : edges) {
+        auto key = std::make_pair(e->next->origin, e->origin);
+        auto reverseKey = std::make_pair(e->origin, e->next->origin);
+
+        if (edgeMap.count(reverseKey)) {
+            e->twin = edgeMap[reverseKey];
+            e->twin->twin = e;
+        }
+        else {
+            edgeMap[key] = e;
+        }
+    }
+
+    return face;
+}
+
+void HalfEdgeMesh::RebuildEdgeMap() {
+    edgeMap.clear();
+    edgeMap.reserve(halfEdges.size() / 2 + 1);
+    for (auto& he : halfEdges) {
+        if (!he->twin || std::less<const HalfEdge*>()(he.get(), he->twin))
+            edgeMap[{ he->next->origin, he->origin }] = he.get();
+    }
+    edgeMapDirty = false;
+}
+
+void HalfEdgeMesh::FlipFaces(const std::vector<Face*>* selection) {
+    TRACE_SCOPE("Flip Faces");
+    size_t count = selection ? selection->size() : faces.size();
+    auto faceAt = [&](size_t i) {
+        return selection ? (*selection)[i] : faces[i].get();
+    };
+
+    //Every half edge keeps its edge but runs the other way: it starts where it used to end and its next is its old previous
+    ParallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            HalfEdge* start = faceAt(i)->edge;
+            HalfEdge* previous = start;
+            while (previous->next != start)
+                previous = previous->next;
+            Vertex* startOrigin = start->origin;
+            HalfEdge* e = start;
+            do {
+                HalfEdge* oldNext = e->next;
+                e->origin = oldNext == start ? startOrigin : oldNext->origin;
+                e->next = previous;
+                previous = e;
+                e = oldNext;
+            } while (e != start);
+        }
+    });
+
+    //An outgoing edge that turned around now ends on its vertex, the edge after it in the new order leaves it
+    bool all = selection == nullptr;
+    ParallelFor(vertices.size(), [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            Vertex* vertex = vertices[v].get();
+            if (vertex->outgoing && vertex->outgoing->origin != vertex)
+                vertex->outgoing = vertex->outgoing->next;
+            if (all)
+                vertex->normal = -vertex->normal;
+        }
+    });
+
+    if (selection) {
+        //the unflipped side is only reachable through its flipped twin, so every cut has a single writer
+        ParallelFor(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                HalfEdge* start = faceAt(i)->edge;
+                HalfEdge* e = start;
+                do {
+                    if (e->twin && e->twin->origin == e->origin) {
+                        e->twin->twin = nullptr;
+                        e->twin = nullptr;
+                    }
+                    e = e->next;
+                } while (e != start);
+            }
+        });
+    }
+
+    if (edgeMapDirty)
+        return;
+    //Entries of flipped edges are keyed the old way round. Where the twin survived it now runs the keyed way,
+    //so only the value changes and the buckets can be walked in parallel. Twinless ones need rekeying.
+    std::atomic<size_t> rekeyCount{ 0 };
+    ParallelFor(edgeMap.bucket_count(), [&](size_t begin, size_t end) {
+        size_t stale = 0;
+        for (size_t b = begin; b < end; ++b) {
+            for (auto it = edgeMap.begin(b); it != edgeMap.end(b); ++it) {
+                HalfEdge* he = it->second;
+                if (he->next->origin == it->first.first && he->origin == it->first.second)
+                    continue;
+                if (he->twin)
+                    it->second = he->twin;
+                else
+                    stale++;
+            }
+        }
+        rekeyCount += stale;
+    });
+    if (rekeyCount == 0)
+        return;
+    //Reinserting an extracted node neither allocates nor rehashes, a node visited again after its move already matches
+    for (auto it = edgeMap.begin(); it != edgeMap.end();) {
+        HalfEdge* he = it->second;
+        std::pair<Vertex*, Vertex*> key(he->next->origin, he->origin);
+        if (key == it->first) {
+            ++it;
+            continue;
+        }
+        auto node = edgeMap.extract(it++);
+        node.key() = key;
+        edgeMap.insert(std::move(node));
+    }
+}
+
+AABB HalfEdgeMesh::ComputeLocalBounds() const {
+    AABB bounds;
+    for (auto& v : vertices) {
+        bounds.Expand(v->position);
+    }
+    return bounds;
+}
+
+void HalfEdgeMesh::CloneInto(HalfEdgeMesh& copy) const
+{
+    copy.flatShading = flatShading;
+    copy.boundsDirty = boundsDirty;
+    copy.edgeMapDirty = edgeMapDirty;
+
+    // --- Step 1: Duplicate all objects ---
+    std::unordered_map<const Vertex*, Vertex*> vertexMap;
+    std::unordered_map<const HalfEdge*, HalfEdge*> halfEdgeMap;
+    std::unordered_map<const Face*, Face*> faceMap;
+
+    // Duplicate vertices
+    Vertex* newVertices = copy.vertexPool.Allocate(vertices.size());
+    for (const auto& v : vertices) {
+        *newVertices = *v;
+        copy.vertices.emplace_back(newVertices++);
+        vertexMap[v.get()] = copy.vertices.back().get();
+    }
+
+    // Duplicate faces
+    Face* newFaces = copy.facePool.Allocate(faces.size());
+    for (const auto& f : faces) {
+        *newFaces = *f;
+        copy.faces.emplace_back(newFaces++);
+        faceMap[f.get()] = copy.faces.back().get();
+    }
+
+    // Duplicate half-edges
+    HalfEdge* newHalfEdges = copy.halfEdgePool.Allocate(halfEdges.size());
+    for (const auto& he : halfEdges) {
+        *newHalfEdges = *he;
+        copy.halfEdges.emplace_back(newHalfEdges++);
+        halfEdgeMap[he.get()] = copy.halfEdges.back().get();
+    }
+
+    // --- Step 2: Fix up internal pointers ---
+    for (const auto& he : halfEdges) {
+        HalfEdge* newHe = halfEdgeMap[he.get()];
+
+        if (he->next) newHe->next = halfEdgeMap[he->next];
+        if (he->twin) newHe->twin = halfEdgeMap[he->twin];
+        if (he->origin) newHe->origin = vertexMap[he->origin];
+        if (he->face) newHe->face = faceMap[he->face];
+    }
+
+    for (const auto& f : faces) {
+        Face* newF = faceMap[f.get()];
+        if (f->edge) newF->edge = halfEdgeMap[f->edge];
+    }
+
+    for (const auto& v : vertices) {
+        Vertex* newV = vertexMap[v.get()];
+        if (v->outgoing) newV->outgoing = halfEdgeMap[v->outgoing];
+    }
+
+    // --- Step 3: Rebuild edge map ---
+    for (const auto& [edgePair, he] : edgeMap) {
+        Vertex* newV1 = vertexMap[edgePair.first];
+        Vertex* newV2 = vertexMap[edgePair.second];
+        HalfEdge* newHe = halfEdgeMap[he];
+        copy.edgeMap[{newV1, newV2}] = newHe;
+    }
+}
+
+bool HalfEdgeMesh::Raycast(const glm::vec3& origin, const glm::vec3& dir, float& outT, Face*& outFace) const
+{
+    outFace = nullptr;
+    outT = FLT_MAX;
+
+    for (auto& f : faces)
+    {
+        // Fan triangulate through all edges
+        const HalfEdge* start = f->edge;
+        const HalfEdge* e1 = start->next;
+        const HalfEdge* e2 = e1->next;
+
+        while (e2 != start) {
+            float t;
+            if (RayTriangle(origin, dir, start->origin->position, e1->origin->position, e2->origin->position, t) && t < outT) {
+                outT = t;
+                outFace = f.get();
+            }
+            // Move forward in fan
+            e1 = e2;
+            e2 = e2->next;
+        }
+    }
+    return (outFace != nullptr);
+}
+
+bool HalfEdgeMesh::RayTriangle(const glm::vec3& orig, const glm::vec3& dir,
+    const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+    float& tOut)
+{
+    const float EPSILON = 0.000001f;
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+
+    glm::vec3 pvec = glm::cross(dir, edge2);
+    float det = glm::dot(edge1, pvec);
+    //small determinants are measured against the triangle's size, tiny triangles of finely subdivided meshes have tiny ones
+    if (std::fabs(det) < EPSILON && det * det < EPSILON * EPSILON * glm::dot(edge1, edge1) * glm::dot(edge2, edge2) * glm::dot(dir, dir))
+        return false;
+
+    float invDet = 1.0f / det;
+    glm::vec3 tvec = orig - v0;
+    float u = glm::dot(tvec, pvec) * invDet;
+    if (u < 0 || u > 1) return false;
+
+    glm::vec3 qvec = glm::cross(tvec, edge1);
+    float v = glm::dot(dir, qvec) * invDet;
+    if (v < 0 || u + v > 1) return false;
+
+    tOut = glm::dot(edge2, qvec) * invDet;
+    return (tOut > EPSILON);
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include "Vertex.h"
+#include "HalfEdge.h"
+#include "Face.h"
+#include "ElementPool.h"
+#include "Bounds.h"
+#include "MeshCluster.h"
+
+/// <summary>
+/// Cosine of the dihedral angle past which an edge counts as sharp (30 degrees)
+/// </summary>
+const float FEATURE_EDGE_COSINE = 0.866f;
+
+/// <summary>
+/// Used for hashing a pair of vertices when inserting a half edge into a lookup table
+/// </summary>
+struct PairHash {
+    size_t operator()(const std::pair<Vertex*, Vertex*>& p) const noexcept {
+        return std::hash<Vertex*>()(p.first) ^ (std::hash<Vertex*>()(p.second) << 1);
+    }
+};
+
+/// <summary>
+/// Half edge topology and the geometry built from it: triangulation, normals, bounds and ray picking.
+/// Doesn't touch OpenGL so it can be built and benchmarked without a window, Mesh adds the GPU side.
+/// </summary>
+class HalfEdgeMesh {
+public:
+    //Mesh Data, the elements are stored in the pools below
+    std::vector<ElementPtr<Vertex>> vertices;
+    std::vector<ElementPtr<HalfEdge>> halfEdges;
+    std::vector<ElementPtr<Face>> faces;
+    ElementPool<Vertex> vertexPool;
+    ElementPool<HalfEdge> halfEdgePool;
+    ElementPool<Face> facePool;
+    /// <summary>
+    /// Used to store an edge as a pair of vertices for quick lookup when finding the adjacent halfedge (twin)
+    /// </summary>
+    std::unordered_map<std::pair<Vertex*, Vertex*>, HalfEdge*, PairHash> edgeMap;
+    /// <summary>
+    /// Set by operations that rebuild the whole topology at once and leave edgeMap empty, addFace refills it before using it
+    /// </summary>
+    bool edgeMapDirty = false;
+    /// <summary>
+    /// Set whenever vertex positions change so the local bounds get recomputed
+    /// </summary>
+    bool boundsDirty = true;
+    /// <summary>
+    /// MeshToTriangles gives every face its own vertices with the face normal instead of sharing smoothed ones
+    /// </summary>
+    bool flatShading = true;
+
+    HalfEdgeMesh() = default;
+
+    HalfEdgeMesh(const HalfEdgeMesh&) = delete;
+    HalfEdgeMesh& operator=(const HalfEdgeMesh&) = delete;
+
+    HalfEdgeMesh(HalfEdgeMesh&&) noexcept = default;
+    HalfEdgeMesh& operator=(HalfEdgeMesh&&) noexcept = default;
+
+    /// <summary>
+    /// Deep copies the topology into copy, which should be empty. Pointers are remapped to the new elements.
+    /// </summary>
+    void CloneInto(HalfEdgeMesh& copy) const;
+
+    static void MeshToTriangles(const HalfEdgeMesh& mesh,
+        std::vector<glm::vec3>& outPositions,
+        std::vector<glm::vec3>& outNormals,
+        std::vector<unsigned int>& outIndices,
+        std::vector<unsigned int>& outEdgeIndices,
+        std::vector<MeshCluster>* outClusters = nullptr,
+        std::vector<unsigned int>* outFeatureEdges = nullptr);
+
+    static void ComputeNormals(HalfEdgeMesh& mesh);
+
+    Vertex* addVertex(const glm::vec3& pos);
+
+    Face* addFace(const std::vector<Vertex*>& verts);
+
+    /// <summary>
+    /// Refills edgeMap from the half edges, keeping one half of every edge like addFace does
+    /// </summary>
+    void RebuildEdgeMap();
+
+    /// <summary>
+    /// Reverses the winding of the given faces, or of every face with null, in place and without allocating.
+    /// Twins stay linked where both sides flip, edges between a flipped and an unflipped face are cut since
+    /// their halves would run the same way. edgeMap is rekeyed to match. Each face may only be listed once.
+    /// </summary>
+    void FlipFaces(const std::vector<Face*>* selection = nullptr);
+
+    AABB ComputeLocalBounds() const;
+
+    /// <summary>
+    /// Closest face hit by a ray in the mesh's local space, faces are fan triangulated like MeshToTriangles does.
+    /// outT is the distance along dir, so it is only a length when dir is normalized.
+    /// </summary>
+    bool Raycast(const glm::vec3& origin, const glm::vec3& dir, float& outT, Face*& outFace) const;
+
+    /// <summary>
+    /// Moller-Trumbore ray/triangle intersection, hits behind the origin don't count
+    /// </summary>
+    static bool RayTriangle(const glm::vec3& orig, const glm::vec3& dir,
+        const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+        float& tOut);
+};
\ No newline at end of file
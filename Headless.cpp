@@ -0,0 +1,373 @@
+#include "Headless.h"
+#include "Viewport.h"
+#include "ObjectPrimitives.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+namespace {
+    /// <summary>
+    /// Spacing between meshes of the scene grid
+    /// </summary>
+    const float SCENE_SPACING = 2.0f;
+    /// <summary>
+    /// The camera orbits the scene once over the measured frames, looking down at this angle
+    /// </summary>
+    const float ORBIT_PITCH = -30.0f;
+
+    struct FrameTiming {
+        /// <summary>
+        /// Wall time of the render including glFinish
+        /// </summary>
+        double frameMs = 0.0;
+        /// <summary>
+        /// GPU time from the viewport's query, negative when the driver didn't give a usable result
+        /// </summary>
+        double gpuMs = 0.0;
+        size_t triangles = 0;
+        int drawCalls = 0;
+        int meshesDrawn = 0;
+    };
+
+    /// <summary>
+    /// Creates a hidden window on GLFW's null platform, so nothing needs a display server.
+    /// EGL surfaceless comes first, OSMesa covers Mesa builds without it.
+    /// </summary>
+    GLFWwindow* CreateHeadlessContext(int width, int height) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        if (!glfwInit())
+            return nullptr;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        const int contextApis[] = { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+        for (int api : contextApis) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+            GLFWwindow* window = glfwCreateWindow(width, height, "EdgeForm", NULL, NULL);
+            if (window)
+                return window;
+        }
+        glfwTerminate();
+        return nullptr;
+    }
+
+    std::unique_ptr<Mesh> CreateSceneMesh(const HeadlessOptions& options) {
+        if (options.scene == "cylinders")
+            return CreateCylinder(options.detail, 0.5f, 1.0f);
+        if (options.scene == "cones")
+            return CreateCone(options.detail, 0.5f, 1.0f);
+        return CreateCube(1.0f);
+    }
+
+    /// <summary>
+    /// Replaces the default scene with a grid of primitives. Render data, uploads and level of detail chains are
+    /// finished here so every measured frame draws the same thing.
+    /// </summary>
+    void LoadScene(Viewport& viewport, const HeadlessOptions& options) {
+        viewport.ClearSelection();
+        viewport.sceneMeshes.clear();
+        float offset = (options.count - 1) * SCENE_SPACING * 0.5f;
+        for (int y = 0; y < options.count; ++y) {
+            for (int x = 0; x < options.count; ++x) {
+                std::unique_ptr<Mesh> mesh = CreateSceneMesh(options);
+                mesh->Translation = glm::vec3(x * SCENE_SPACING - offset, y * SCENE_SPACING - offset, 0.5f);
+                mesh->transformDirty = true;
+                mesh->subdivisionLevels = options.subdivide;
+                viewport.sceneMeshes.push_back(std::move(mesh));
+            }
+        }
+        if (options.decimate < 1.0f) {
+            DecimateOptions decimateOptions;
+            decimateOptions.ratio = options.decimate;
+            for (const auto& mesh : viewport.sceneMeshes)
+                mesh->StartDecimateJob(decimateOptions);
+            for (const auto& mesh : viewport.sceneMeshes)
+                mesh->FinishDecimateJob();
+        }
+        for (const auto& mesh : viewport.sceneMeshes) {
+            if (mesh->gpuDirty) {
+                mesh->RebuildRenderData();
+                mesh->UploadToGPU();
+            }
+        }
+        for (const auto& mesh : viewport.sceneMeshes)
+            mesh->FinishLodJob();
+        viewport.Invalidate();
+    }
+
+    /// <summary>
+    /// Reads the last rendered frame back from the viewport's fbo, top row first
+    /// </summary>
+    void ReadFrame(const Viewport& viewport, std::vector<unsigned char>& outPixels) {
+        int width = viewport.frameWidth, height = viewport.frameHeight;
+        std::vector<unsigned char> rows((size_t)width * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, viewport.fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rows.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        outPixels.resize(rows.size());
+        size_t stride = (size_t)width * 3;
+        for (int y = 0; y < height; ++y)
+            std::copy_n(rows.begin() + (height - 1 - y) * stride, stride, outPixels.begin() + y * stride);
+    }
+
+    bool WritePpm(const std::string& path, int width, int height, const std::vector<unsigned char>& pixels) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+        out << "P6\n" << width << " " << height << "\n255\n";
+        out.write((const char*)pixels.data(), pixels.size());
+        return (bool)out;
+    }
+
+    bool ReadPpm(const std::string& path, int& outWidth, int& outHeight, std::vector<unsigned char>& outPixels) {
+        std::ifstream in(path, std::ios::binary);
+        std::string magic;
+        int maxValue = 0;
+        if (!(in >> magic >> outWidth >> outHeight >> maxValue) || magic != "P6" || maxValue != 255)
+            return false;
+        //a single whitespace byte separates the header from the pixels
+        in.get();
+        outPixels.resize((size_t)outWidth * outHeight * 3);
+        in.read((char*)outPixels.data(), outPixels.size());
+        return (bool)in;
+    }
+
+    /// <summary>
+    /// Number of pixels with a channel further than tolerance from the reference, -1 if the sizes differ
+    /// </summary>
+    long long CountDifferentPixels(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance) {
+        if (a.size() != b.size())
+            return -1;
+        long long different = 0;
+        for (size_t i = 0; i < a.size(); i += 3) {
+            for (int c = 0; c < 3; ++c) {
+                if (std::abs(a[i + c] - b[i + c]) > tolerance) {
+                    different++;
+                    break;
+                }
+            }
+        }
+        return different;
+    }
+
+    void PrintSummary(const char* label, std::vector<double> values) {
+        if (values.empty())
+            return;
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double v : values)
+            sum += v;
+        auto percentile = [&](double p) {
+            return values[std::min((size_t)(p * (values.size() - 1) + 0.5), values.size() - 1)];
+        };
+        std::printf("%-9s mean %8.3f  p50 %8.3f  p95 %8.3f  max %8.3f ms\n",
+            label, sum / values.size(), percentile(0.5), percentile(0.95), values.back());
+    }
+
+    /// <summary>
+    /// Swells and shrinks every mesh along its height, with the wave running around the orbit.
+    /// The topology stays, only positions change.
+    /// </summary>
+    void DeformScene(Viewport& viewport, const std::vector<std::vector<glm::vec3>>& restPositions, int frame, int frames) {
+        float phase = 6.2831853f * frame / frames;
+        for (size_t m = 0; m < viewport.sceneMeshes.size(); ++m) {
+            Mesh& mesh = *viewport.sceneMeshes[m];
+            const std::vector<glm::vec3>& rest = restPositions[m];
+            for (size_t v = 0; v < rest.size(); ++v) {
+                float swell = 1.0f + 0.25f * std::sin(phase + rest[v].z * 4.0f);
+                mesh.vertices[v]->position = glm::vec3(rest[v].x * swell, rest[v].y * swell, rest[v].z);
+            }
+            mesh.MarkPositionsDirty();
+        }
+    }
+
+    std::string FramePath(const std::string& directory, int frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%04d.ppm", frame);
+        return directory + "/" + name;
+    }
+}
+
+bool ParseHeadlessOptions(int argc, char** argv, HeadlessOptions& options) {
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--scene" && hasValue)
+            options.scene = argv[++i];
+        else if (arg == "--count" && hasValue)
+            options.count = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--detail" && hasValue)
+            options.detail = std::max(3, std::atoi(argv[++i]));
+        else if (arg == "--subdivide" && hasValue)
+            options.subdivide = std::clamp(std::atoi(argv[++i]), 0, SUBDIVISION_MAX_LEVELS);
+        else if (arg == "--deform")
+            options.deform = true;
+        else if (arg == "--decimate" && hasValue)
+            options.decimate = std::clamp((float)std::atof(argv[++i]), 0.0f, 1.0f);
+        else if (arg == "--frames" && hasValue)
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--size" && hasValue)
+            std::sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+        else if (arg == "--images" && hasValue)
+            options.imageDir = argv[++i];
+        else if (arg == "--golden" && hasValue)
+            options.goldenDir = argv[++i];
+        else if (arg == "--tolerance" && hasValue)
+            options.tolerance = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--timings" && hasValue)
+            options.timingsPath = argv[++i];
+    }
+    options.width = std::max(options.width, 1);
+    options.height = std::max(options.height, 1);
+    return headless;
+}
+
+int RunHeadless(const HeadlessOptions& options) {
+    if (options.scene != "cubes" && options.scene != "cylinders" && options.scene != "cones") {
+        std::cout << "Unknown scene " << options.scene << ", expected cubes, cylinders or cones" << std::endl;
+        return 2;
+    }
+    GLFWwindow* window = CreateHeadlessContext(options.width, options.height);
+    if (!window) {
+        std::cout << "Failed to create a headless GL context" << std::endl;
+        return 2;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to load GL" << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 2;
+    }
+    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    //Nothing shows the overlay here, profile scopes still reach the trace
+    Profiler::Get().enabled = false;
+
+    int result = 0;
+    {
+        Viewport viewport;
+        //every frame is a full resolution render, there is no input to navigate with
+        viewport.dynamicResolution = false;
+        viewport.navigationProxy = NavigationProxy::Off;
+        viewport.ResizeViewportFramebuffer(options.width, options.height);
+        viewport.CreateViewportFramebuffer();
+        LoadScene(viewport, options);
+
+        float sceneSize = options.count * SCENE_SPACING;
+        viewport.viewportCamera->SetFocus(glm::vec3(0.0f), sceneSize * 0.9f + 3.0f);
+
+        std::vector<std::vector<glm::vec3>> restPositions;
+        if (options.deform) {
+            for (const auto& mesh : viewport.sceneMeshes) {
+                restPositions.emplace_back();
+                for (const auto& v : mesh->vertices)
+                    restPositions.back().push_back(v->position);
+            }
+        }
+
+        std::vector<FrameTiming> timings;
+        std::vector<unsigned char> pixels, reference;
+        int mismatchedFrames = 0;
+        for (int frame = -options.warmupFrames; frame < options.frames; ++frame) {
+            viewport.viewportCamera->SetOrientation(360.0f * std::max(frame, 0) / options.frames, ORBIT_PITCH);
+
+            Trace::Clock::time_point start = Trace::Clock::now();
+            {
+                PROFILE_SCOPE("Headless Frame");
+                if (options.deform)
+                    DeformScene(viewport, restPositions, std::max(frame, 0), options.frames);
+                viewport.RenderScene();
+                glFinish();
+            }
+            FrameTiming timing;
+            timing.frameMs = std::chrono::duration<double, std::milli>(Trace::Clock::now() - start).count();
+            //the query of the render that just finished is the previous one from the viewport's point of view
+            viewport.ReadRenderTimeQuery();
+            timing.gpuMs = viewport.lastRenderSeconds * 1000.0;
+            //the frame was fenced so the GPU can't have taken longer, software drivers report junk for some queries
+            if (timing.gpuMs > timing.frameMs)
+                timing.gpuMs = -1.0;
+            timing.triangles = viewport.stats.trianglesDrawn;
+            timing.drawCalls = viewport.renderQueue.stats.drawCalls;
+            timing.meshesDrawn = viewport.stats.meshesDrawn;
+            if (frame < 0)
+                continue;
+            timings.push_back(timing);
+
+            if (options.imageDir.empty() && options.goldenDir.empty())
+                continue;
+            ReadFrame(viewport, pixels);
+            if (!options.imageDir.empty() && !WritePpm(FramePath(options.imageDir, frame), viewport.frameWidth, viewport.frameHeight, pixels)) {
+                std::cout << "Could not write " << FramePath(options.imageDir, frame) << std::endl;
+                result = 2;
+                break;
+            }
+            if (!options.goldenDir.empty()) {
+                int width = 0, height = 0;
+                std::string path = FramePath(options.goldenDir, frame);
+                long long different = ReadPpm(path, width, height, reference) ? CountDifferentPixels(pixels, reference, options.tolerance) : -1;
+                if (different < 0 || different > GOLDEN_MAX_DIFFERENT_PIXELS * viewport.frameWidth * viewport.frameHeight) {
+                    if (different < 0)
+                        std::cout << "Frame " << frame << ": missing or mismatched reference " << path << std::endl;
+                    else
+                        std::cout << "Frame " << frame << ": " << different << " pixels differ from " << path << std::endl;
+                    mismatchedFrames++;
+                }
+            }
+        }
+
+        if (!options.timingsPath.empty()) {
+            std::ofstream csv(options.timingsPath);
+            csv << "frame,frame_ms,gpu_ms,triangles,draw_calls,meshes_drawn\n";
+            for (size_t i = 0; i < timings.size(); ++i) {
+                const FrameTiming& t = timings[i];
+                csv << i << "," << t.frameMs << ",";
+                if (t.gpuMs >= 0.0)
+                    csv << t.gpuMs;
+                csv << "," << t.triangles << "," << t.drawCalls << "," << t.meshesDrawn << "\n";
+            }
+            if (!csv) {
+                std::cout << "Could not write " << options.timingsPath << std::endl;
+                result = 2;
+            }
+        }
+
+        std::vector<double> frameMs, gpuMs;
+        for (const FrameTiming& t : timings) {
+            frameMs.push_back(t.frameMs);
+            if (t.gpuMs >= 0.0)
+                gpuMs.push_back(t.gpuMs);
+        }
+        std::printf("%d frames of %s, %d meshes at %dx%d, %zu triangles\n", (int)timings.size(), options.scene.c_str(),
+            (int)viewport.sceneMeshes.size(), options.width, options.height, timings.empty() ? (size_t)0 : timings.back().triangles);
+        PrintSummary("Frame", frameMs);
+        PrintSummary("GPU", gpuMs);
+        if (gpuMs.size() < frameMs.size())
+            std::printf("GPU time unavailable for %d frames\n", (int)(frameMs.size() - gpuMs.size()));
+        if (!options.goldenDir.empty())
+            std::printf("%d of %d frames differ from the references\n", mismatchedFrames, (int)timings.size());
+        if (mismatchedFrames > 0 && result == 0)
+            result = 1;
+
+        //the viewport's meshes and targets are deleted here, while the context is still current
+    }
+    //their cancelled jobs may still be winding down
+    WaitForDetachedTasks();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+/// <summary>
+/// Settings for a headless run, filled from the command line by ParseHeadlessOptions
+/// </summary>
+struct HeadlessOptions {
+    /// <summary>
+    /// Procedural scene to load: cubes, cylinders or cones
+    /// </summary>
+    std::string scene = "cubes";
+    /// <summary>
+    /// Meshes per side of the scene grid
+    /// </summary>
+    int count = 10;
+    /// <summary>
+    /// Segments of the round primitives
+    /// </summary>
+    int detail = 32;
+    /// <summary>
+    /// Subdivision preview levels of every scene mesh, 0 renders the primitives as they are
+    /// </summary>
+    int subdivide = 0;
+    /// <summary>
+    /// Moves the control vertices every frame, so previews take the positions only update path
+    /// </summary>
+    bool deform = false;
+    /// <summary>
+    /// Fraction of the triangles every scene mesh keeps, decimated through the background job before timing starts.
+    /// 1 leaves the primitives as they are.
+    /// </summary>
+    float decimate = 1.0f;
+    int frames = 120;
+    int width = 1280, height = 720;
+    /// <summary>
+    /// Renders before timing starts, they upload the meshes and warm up the driver
+    /// </summary>
+    int warmupFrames = 5;
+    /// <summary>
+    /// Directory frames are written to as frame_0000.ppm, empty to skip
+    /// </summary>
+    std::string imageDir;
+    /// <summary>
+    /// Directory with reference frames to compare against, empty to skip
+    /// </summary>
+    std::string goldenDir;
+    /// <summary>
+    /// Largest per channel difference a pixel may have and still match its reference
+    /// </summary>
+    int tolerance = 8;
+    /// <summary>
+    /// CSV file with one row of timings per frame, empty to skip
+    /// </summary>
+    std::string timingsPath;
+};
+
+/// <summary>
+/// Fraction of a frame's pixels that may differ from the reference before the comparison fails
+/// </summary>
+const double GOLDEN_MAX_DIFFERENT_PIXELS = 0.001;
+
+/// <summary>
+/// Returns true if --headless is on the command line, options are filled from the flags that follow it
+/// </summary>
+bool ParseHeadlessOptions(int argc, char** argv, HeadlessOptions& options);
+
+/// <summary>
+/// Renders the scene from an orbit of camera positions into the viewport's offscreen targets without a window,
+/// on an EGL surfaceless or OSMesa context so it runs on machines without a display or GPU.
+/// Returns the process exit code: 0 on success, 1 when a frame doesn't match its reference, 2 when setup failed.
+/// </summary>
+int RunHeadless(const HeadlessOptions& options);
\ No newline at end of file
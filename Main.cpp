@@ -18,8 +18,36 @@
 //Local includes
 #include "ObjectPrimitives.h"
 #include "Viewport.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include "Headless.h"
+#include "Subdivision.h"
+#include "MeshOrient.h"
+#include "MeshWeld.h"
+#include "MeshBoolean.h"
 
 Viewport* viewport;
+/// <summary>
+/// ImGui needs a few frames after an input to settle hover states and layout, the loop keeps polling that long
+/// </summary>
+const int UI_SETTLE_FRAMES = 3;
+/// <summary>
+/// Longest the loop sleeps waiting for input, short while background work will change the scene
+/// </summary>
+const double IDLE_WAIT_SECONDS = 0.5;
+const double PENDING_WORK_WAIT_SECONDS = 0.05;
+int settleFrames = UI_SETTLE_FRAMES;
+//Options of the operations in the Modify tab
+int subdivisionLevels = 1;
+bool subdivisionCreases = false;
+float decimateRatio = 0.5f;
+bool decimateFeatures = true;
+float mergeDistance = 0.0001f;
+/// <summary>
+/// How many vertices the last Merge by Distance welded, -1 before it has run
+/// </summary>
+int mergedVertices = -1;
+int booleanOperation = (int)BooleanOperation::Difference;
 ImGuiWindowFlags host_flags =
 ImGuiWindowFlags_NoTitleBar |
 ImGuiWindowFlags_NoCollapse |
@@ -33,11 +61,13 @@ ImGuiWindowFlags_NoScrollbar;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+	settleFrames = UI_SETTLE_FRAMES;
 	glViewport(0, 0, width, height);
 }
 
 void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	settleFrames = UI_SETTLE_FRAMES;
 	ImGui_ImplGlfw_CursorPosCallback(window, xpos, ypos);
 	if (ImGui::GetIO().WantCaptureMouse && !viewport->IsActive) {
 		return;
@@ -46,6 +76,7 @@ void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 }
 
 void scroll_callback(GLFWwindow* window, double xpos, double ypos) {
+	settleFrames = UI_SETTLE_FRAMES;
 	ImGui_ImplGlfw_ScrollCallback(window, xpos, ypos);
 	if (ImGui::GetIO().WantCaptureMouse && !viewport->IsActive) {
 		return;
@@ -54,6 +85,7 @@ void scroll_callback(GLFWwindow* window, double xpos, double ypos) {
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+	settleFrames = UI_SETTLE_FRAMES;
 	ImGui_ImplGlfw_MouseButtonCallback(window, button, action, mods);
 	if (ImGui::GetIO().WantCaptureMouse && !viewport->IsActive) {
 		return;
@@ -62,6 +94,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	settleFrames = UI_SETTLE_FRAMES;
 	ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
 	if (ImGui::GetIO().WantCaptureKeyboard && !viewport->IsActive) {
 		return;
@@ -75,7 +108,7 @@ void DrawToolWindow() {
 	//export drawing of tabs to viewport
 	if (ImGui::BeginTabBar("Mesh Tools"))
 	{
-		if (viewport->selectedMesh) {
+		if (viewport->activeMesh) {
 			//Mesh transformations tab
 			ImGuiTabItemFlags meshFlags = viewport->forceMeshTab ? ImGuiTabItemFlags_SetSelected : 0;
 			if (ImGui::BeginTabItem("Mesh", nullptr, meshFlags)) {
@@ -84,40 +117,250 @@ void DrawToolWindow() {
 				//GLobal transformations
 				ImGui::Text("Translation:");
 				ImGui::PushItemWidth(-1);
-				changed |= ImGui::DragFloat("##01", &viewport->selectedMesh->Translation.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
-				changed |= ImGui::DragFloat("##02", &viewport->selectedMesh->Translation.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
-				changed |= ImGui::DragFloat("##03", &viewport->selectedMesh->Translation.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
+				changed |= ImGui::DragFloat("##01", &viewport->activeMesh->Translation.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
+				changed |= ImGui::DragFloat("##02", &viewport->activeMesh->Translation.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
+				changed |= ImGui::DragFloat("##03", &viewport->activeMesh->Translation.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
 				ImGui::PopItemWidth();
 				ImGui::Text("Rotation:");
 				ImGui::PushItemWidth(-1);
-				changed |= ImGui::DragFloat("##04", &viewport->selectedMesh->Rotation.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
-				changed |= ImGui::DragFloat("##05", &viewport->selectedMesh->Rotation.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
-				changed |= ImGui::DragFloat("##06", &viewport->selectedMesh->Rotation.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
+				changed |= ImGui::DragFloat("##04", &viewport->activeMesh->Rotation.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
+				changed |= ImGui::DragFloat("##05", &viewport->activeMesh->Rotation.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
+				changed |= ImGui::DragFloat("##06", &viewport->activeMesh->Rotation.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
 				ImGui::PopItemWidth();
 				ImGui::Text("Scale:");
 				ImGui::PushItemWidth(-1);
-				changed |= ImGui::DragFloat("##07", &viewport->selectedMesh->Scale.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
-				changed |= ImGui::DragFloat("##08", &viewport->selectedMesh->Scale.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
-				changed |= ImGui::DragFloat("##09", &viewport->selectedMesh->Scale.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
+				changed |= ImGui::DragFloat("##07", &viewport->activeMesh->Scale.x, 0.1f, 0.0f, 0.0f, "X:\t%.4f");
+				changed |= ImGui::DragFloat("##08", &viewport->activeMesh->Scale.y, 0.1f, 0.0f, 0.0f, "Y:\t%.4f");
+				changed |= ImGui::DragFloat("##09", &viewport->activeMesh->Scale.z, 0.1f, 0.0f, 0.0f, "Z:\t%.4f");
 				ImGui::PopItemWidth();
 				if (changed) {
-					viewport->selectedMesh->transformDirty = true;
+					viewport->activeMesh->transformDirty = true;
 				}
 
-				if (ImGui::Checkbox("Flat Shading", &viewport->selectedMesh->flatShading)) {
-					viewport->selectedMesh->gpuDirty = !viewport->selectedMesh->gpuDirty;
+				if (ImGui::Checkbox("Flat Shading", &viewport->activeMesh->flatShading)) {
+					viewport->activeMesh->gpuDirty = !viewport->activeMesh->gpuDirty;
+				}
+				//Preview only changes the render data, the Subdivide button in Modify applies it to the mesh
+				ImGui::PushItemWidth(-1);
+				if (ImGui::SliderInt("##SubdivisionPreview", &viewport->activeMesh->subdivisionLevels, 0, SUBDIVISION_MAX_LEVELS, "Subdivision Preview: %d")) {
+					viewport->activeMesh->gpuDirty = true;
+				}
+				ImGui::PopItemWidth();
+				if (ImGui::Checkbox("Preview Sharp Edges", &viewport->activeMesh->subdivisionCreases)) {
+					viewport->activeMesh->gpuDirty = true;
+				}
+				if (ImGui::ColorEdit4("Object Color", glm::value_ptr(viewport->activeMesh->ObjectColor), ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_DisplayRGB | ImGuiColorEditFlags_DisplayHex)) {
+					viewport->Invalidate();
 				}
-				ImGui::ColorEdit4("Object Color", glm::value_ptr(viewport->selectedMesh->ObjectColor), ImGuiColorEditFlags_NoInputs | ImGuiColorEditFlags_DisplayRGB | ImGuiColorEditFlags_DisplayHex);
 				ImGui::EndTabItem();
 			}
 			//mesh modifiers tab
 			if (ImGui::BeginTabItem("Modify")) {
-				ImGui::Button("Flip Normals");
-				ImGui::Button("Subdivide");
+				//the decimated snapshot replaces the whole mesh when it lands, edits made before then would be lost
+				bool decimating = viewport->activeMesh->DecimateJobPending();
+				ImGui::BeginDisabled(decimating);
+				if (ImGui::Button("Flip Normals")) {
+					viewport->activeMesh->FlipNormals();
+					viewport->Invalidate();
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Recalculate Outside")) {
+					PROFILE_SCOPE("Recalculate Outside");
+					RecalculateNormalsOutside(*viewport->activeMesh);
+					viewport->activeMesh->gpuDirty = true;
+				}
+				if (ImGui::Button("Merge by Distance")) {
+					PROFILE_SCOPE("Merge by Distance");
+					mergedVertices = (int)MergeByDistance(*viewport->activeMesh, mergeDistance);
+					viewport->activeMesh->gpuDirty = true;
+				}
+				ImGui::SameLine();
+				ImGui::PushItemWidth(-1);
+				ImGui::DragFloat("##MergeDistance", &mergeDistance, 0.0001f, 0.0f, 1.0f, "Distance: %.4f");
+				ImGui::PopItemWidth();
+				if (mergedVertices >= 0) {
+					ImGui::Text("Merged %d vertices", mergedVertices);
+				}
+				if (ImGui::Button("Subdivide")) {
+					PROFILE_SCOPE("Subdivide");
+					SubdivideCatmullClark(*viewport->activeMesh, subdivisionLevels, subdivisionCreases);
+					viewport->activeMesh->gpuDirty = true;
+				}
+				ImGui::SameLine();
+				ImGui::PushItemWidth(-1);
+				ImGui::SliderInt("##SubdivisionLevels", &subdivisionLevels, 1, SUBDIVISION_MAX_LEVELS, "Levels: %d");
+				ImGui::PopItemWidth();
+				ImGui::Checkbox("Keep Sharp Edges", &subdivisionCreases);
+				//every other selected mesh is combined into the active one, the others stay in the scene
+				if (viewport->selectedMeshes.size() >= 2) {
+					if (ImGui::Button("Boolean")) {
+						PROFILE_SCOPE("Boolean");
+						Mesh* active = viewport->activeMesh;
+						glm::mat4 worldToActive = glm::inverse(active->GetModelMatrix());
+						for (Mesh* other : viewport->selectedMeshes) {
+							if (other == active || other->DecimateJobPending())
+								continue;
+							MeshArrays arrays;
+							MeshBoolean(*active, *other, worldToActive * other->GetModelMatrix(),
+								(BooleanOperation)booleanOperation, arrays);
+							ArraysToMesh(arrays, *active);
+						}
+						active->gpuDirty = true;
+					}
+					ImGui::SameLine();
+					ImGui::PushItemWidth(-1);
+					ImGui::Combo("##BooleanOperation", &booleanOperation, "Union\0Difference\0Intersection\0");
+					ImGui::PopItemWidth();
+				}
+				ImGui::EndDisabled();
+				if (decimating) {
+					if (ImGui::Button("Cancel")) {
+						viewport->activeMesh->CancelDecimateJob();
+					}
+					ImGui::SameLine();
+					ImGui::ProgressBar(viewport->activeMesh->DecimateJobProgress());
+				}
+				else {
+					if (ImGui::Button("Decimate")) {
+						DecimateOptions options;
+						options.ratio = decimateRatio;
+						options.preserveFeatures = decimateFeatures;
+						viewport->activeMesh->StartDecimateJob(options);
+					}
+					ImGui::SameLine();
+					ImGui::PushItemWidth(-1);
+					ImGui::SliderFloat("##DecimateRatio", &decimateRatio, 0.01f, 1.0f, "Keep: %.2f");
+					ImGui::PopItemWidth();
+					ImGui::Checkbox("Keep Feature Edges", &decimateFeatures);
+				}
 				ImGui::Button("Duplicate");
 				ImGui::Button("Delete");
 				ImGui::EndTabItem();
 			}
+			//non destructive modifiers, evaluated in the background on top of the mesh
+			if (ImGui::BeginTabItem("Modifiers")) {
+				Mesh* mesh = viewport->activeMesh;
+				ImGui::PushItemWidth(-1);
+				if (ImGui::BeginCombo("##AddModifier", "Add Modifier")) {
+					for (int type = 0; type < MODIFIER_TYPE_COUNT; ++type) {
+						if (!ImGui::Selectable(ModifierTypeName((ModifierType)type)))
+							continue;
+						Modifier& modifier = mesh->AddModifier((ModifierType)type);
+						//a boolean cuts with the other selected object and an array can follow its vertices, from then on
+						for (Mesh* other : viewport->selectedMeshes) {
+							if (other != mesh && (modifier.type == ModifierType::Boolean || modifier.type == ModifierType::Array)) {
+								modifier.operandSource = other;
+								break;
+							}
+						}
+					}
+					ImGui::EndCombo();
+				}
+				ImGui::PopItemWidth();
+				std::vector<Modifier>& modifiers = mesh->modifierStack.modifiers;
+				int removed = -1, swapped = -1;
+				for (size_t i = 0; i < modifiers.size(); ++i) {
+					Modifier& modifier = modifiers[i];
+					ImGui::PushID((int)i);
+					ImGui::Separator();
+					bool changed = ImGui::Checkbox(ModifierTypeName(modifier.type), &modifier.enabled);
+					ImGui::SameLine();
+					if (ImGui::ArrowButton("##Up", ImGuiDir_Up) && i > 0)
+						swapped = (int)i - 1;
+					ImGui::SameLine();
+					if (ImGui::ArrowButton("##Down", ImGuiDir_Down) && i + 1 < modifiers.size())
+						swapped = (int)i;
+					ImGui::SameLine();
+					if (ImGui::Button("X"))
+						removed = (int)i;
+					ImGui::PushItemWidth(-1);
+					switch (modifier.type) {
+					case ModifierType::Subdivision:
+						changed |= ImGui::SliderInt("##Levels", &modifier.levels, 1, SUBDIVISION_MAX_LEVELS, "Levels: %d");
+						changed |= ImGui::Checkbox("Keep Sharp Edges", &modifier.creases);
+						break;
+					case ModifierType::Solidify:
+						changed |= ImGui::DragFloat("##Thickness", &modifier.thickness, 0.01f, 0.0f, 0.0f, "Thickness: %.3f");
+						break;
+					case ModifierType::Boolean: {
+						int operation = (int)modifier.operation;
+						if (ImGui::Combo("##Operation", &operation, "Union\0Difference\0Intersection\0")) {
+							modifier.operation = (BooleanOperation)operation;
+							changed = true;
+						}
+						if (!modifier.operandSource && !modifier.operand)
+							ImGui::TextDisabled("Select the operand with the object when adding");
+						break;
+					}
+					case ModifierType::Decimate:
+						changed |= ImGui::SliderFloat("##Ratio", &modifier.decimate.ratio, 0.01f, 1.0f, "Keep: %.2f");
+						changed |= ImGui::Checkbox("Keep Feature Edges", &modifier.decimate.preserveFeatures);
+						break;
+					case ModifierType::Weld:
+						changed |= ImGui::DragFloat("##Distance", &modifier.distance, 0.0001f, 0.0f, 1.0f, "Distance: %.4f");
+						break;
+					case ModifierType::Array: {
+						int mode = (int)modifier.arrayMode;
+						if (ImGui::Combo("##ArrayMode", &mode, "Linear\0Radial\0Curve\0")) {
+							modifier.arrayMode = (ArrayMode)mode;
+							changed = true;
+						}
+						changed |= ImGui::DragInt("##Count", &modifier.count, 1.0f, 1, 1000, "Count: %d");
+						if (modifier.arrayMode != ArrayMode::Curve)
+							changed |= ImGui::DragFloat3("##Offset", glm::value_ptr(modifier.offset), 0.05f, 0.0f, 0.0f, "%.3f");
+						if (modifier.arrayMode == ArrayMode::Radial) {
+							changed |= ImGui::DragFloat3("##Axis", glm::value_ptr(modifier.axis), 0.01f, -1.0f, 1.0f, "%.2f");
+							changed |= ImGui::DragFloat("##Angle", &modifier.angle, 1.0f, -360.0f, 360.0f, "Angle: %.1f");
+						}
+						if (modifier.arrayMode == ArrayMode::Curve) {
+							changed |= ImGui::Checkbox("Closed", &modifier.closedCurve);
+							if (!modifier.operandSource && !modifier.operand)
+								ImGui::TextDisabled("Select the curve object with the object when adding");
+						}
+						//seams are only welded when the copies turn into geometry
+						changed |= ImGui::Checkbox("Merge Seams", &modifier.merge);
+						if (modifier.merge)
+							changed |= ImGui::DragFloat("##MergeDistance", &modifier.distance, 0.0001f, 0.0f, 1.0f, "Distance: %.4f");
+						break;
+					}
+					case ModifierType::Mirror:
+						changed |= ImGui::Checkbox("X", &modifier.mirrorAxes.x);
+						ImGui::SameLine();
+						changed |= ImGui::Checkbox("Y", &modifier.mirrorAxes.y);
+						ImGui::SameLine();
+						changed |= ImGui::Checkbox("Z", &modifier.mirrorAxes.z);
+						//the viewport keeps the center on the cursor from then on, the local origin otherwise
+						if (ImGui::Checkbox("Around 3D Cursor", &modifier.mirrorAtCursor)) {
+							modifier.mirrorCenter = glm::vec3(0.0f);
+							changed = true;
+						}
+						//the seam is only welded when the mirror turns into geometry
+						changed |= ImGui::DragFloat("##MergeDistance", &modifier.distance, 0.0001f, 0.0f, 1.0f, "Seam Distance: %.4f");
+						break;
+					}
+					ImGui::PopItemWidth();
+					if (changed)
+						mesh->ModifierChanged(i);
+					ImGui::PopID();
+				}
+				if (swapped >= 0)
+					mesh->SwapModifiers((size_t)swapped);
+				if (removed >= 0)
+					mesh->RemoveModifier((size_t)removed);
+				if (!modifiers.empty()) {
+					ImGui::Separator();
+					//the decimated snapshot would replace the applied result too
+					ImGui::BeginDisabled(mesh->DecimateJobPending());
+					if (ImGui::Button("Apply"))
+						mesh->ApplyModifiers();
+					ImGui::EndDisabled();
+					if (mesh->ModifierJobPending()) {
+						ImGui::SameLine();
+						ImGui::TextDisabled("Evaluating...");
+					}
+				}
+				ImGui::EndTabItem();
+			}
 		}
 		if (ImGui::BeginTabItem("Create")) {
 			if (ImGui::Button("New Cube")) {
@@ -140,8 +383,60 @@ void DrawToolWindow() {
 	ImGui::End();
 }
 
-int main() 
+void DrawStatsWindow() {
+	ImGui::Begin("Stats");
+	const ViewportStats& stats = viewport->stats;
+	ImGui::Text("Meshes: %d", stats.meshesTotal);
+	ImGui::Text("Drawn: %d", stats.meshesDrawn);
+	ImGui::Text("Culled: %d", stats.meshesCulled);
+	ImGui::Text("Clusters Culled: %d", stats.clustersCulled);
+	ImGui::Text("Reduced LOD: %d", stats.meshesReducedLod);
+	ImGui::Text("Reduced Edges: %d", stats.edgeOverlaysReduced);
+	ImGui::Text("Triangles: %zu", stats.trianglesDrawn);
+	const RenderQueueStats& queueStats = viewport->renderQueue.stats;
+	ImGui::Separator();
+	ImGui::Text("Draw Calls: %d", queueStats.drawCalls);
+	ImGui::Text("Shader Changes: %d", queueStats.shaderChanges);
+	ImGui::Text("VAO Changes: %d", queueStats.vaoChanges);
+	ImGui::Text("Texture Changes: %d", queueStats.textureChanges);
+	ImGui::Text("State Changes: %d", queueStats.stateChanges);
+	ImGui::Separator();
+	if (ImGui::Checkbox("Frustum Culling", &viewport->frustumCulling))
+		viewport->Invalidate();
+	ImGui::Text("Resolution: %d%%", (int)(viewport->resolutionScale * 100.0f + 0.5f));
+	ImGui::Text("Proxies: %d", stats.meshesProxied);
+	ImGui::Text("Triangle Budget: %.0f", viewport->triangleBudget);
+	const char* proxyModes[] = { "Off", "Lowest LOD", "Bounding Box" };
+	int proxyMode = (int)viewport->navigationProxy;
+	if (ImGui::Combo("Navigation Proxies", &proxyMode, proxyModes, IM_ARRAYSIZE(proxyModes))) {
+		viewport->navigationProxy = (NavigationProxy)proxyMode;
+		viewport->Invalidate();
+	}
+	if (ImGui::Checkbox("Dynamic Resolution", &viewport->dynamicResolution))
+		viewport->Invalidate();
+	ImGui::End();
+}
+
+int main(int argc, char** argv) 
 {
+	//--trace <file> records from startup and writes the trace when the app closes
+	const char* traceOnExit = nullptr;
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::string(argv[i]) == "--trace")
+			traceOnExit = argv[i + 1];
+	}
+	Trace::SetThreadName("Main");
+	Trace::enabled.store(traceOnExit != nullptr);
+
+	//--headless renders a scripted benchmark offscreen and exits, see ParseHeadlessOptions for its flags
+	HeadlessOptions headlessOptions;
+	if (ParseHeadlessOptions(argc, argv, headlessOptions)) {
+		int result = RunHeadless(headlessOptions);
+		if (traceOnExit && !Trace::WriteChromeTrace(traceOnExit))
+			std::cout << "Failed to write trace to " << traceOnExit << std::endl;
+		return result;
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -190,7 +485,19 @@ int main()
 	SetupImGuiStyle();
 	bool first_time = true;
 	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		Profiler::Get().BeginFrame();
+		//Only spin while something is changing, otherwise sleep until input arrives
+		{
+			PROFILE_SCOPE("Events");
+			if (settleFrames > 0 || viewport->NeedsRender()) {
+				glfwPollEvents();
+				if (settleFrames > 0)
+					settleFrames--;
+			}
+			else {
+				glfwWaitEventsTimeout(viewport->HasPendingWork() ? PENDING_WORK_WAIT_SECONDS : IDLE_WAIT_SECONDS);
+			}
+		}
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -207,10 +514,14 @@ int main()
 			ImGuiID dock_main = dockspace_id;
 			ImGuiID dock_right;
 			ImGui::DockBuilderSplitNode(dock_main, ImGuiDir_Right, 0.25f, &dock_right, &dock_main);
+			ImGuiID dock_right_bottom;
+			ImGui::DockBuilderSplitNode(dock_right, ImGuiDir_Down, 0.3f, &dock_right_bottom, &dock_right);
 
 			// Assign windows
 			ImGui::DockBuilderDockWindow("Viewport", dock_main);
 			ImGui::DockBuilderDockWindow("Tools", dock_right);
+			ImGui::DockBuilderDockWindow("Stats", dock_right_bottom);
+			ImGui::DockBuilderDockWindow("Profiler", dock_right_bottom);
 
 			ImGui::DockBuilderFinish(dockspace_id);
 		}
@@ -237,22 +548,46 @@ int main()
 		
 		ImVec2 size = ImGui::GetContentRegionAvail();
 		viewport->ResizeViewportFramebuffer(size.x, size.y);
-		viewport->Draw();
-		ImGui::Image((ImTextureID)(intptr_t)viewport->fboTexture, size,
-			ImVec2(0, 1), ImVec2(1, 0)); // Flip vertically
+		{
+			PROFILE_SCOPE("Viewport Draw");
+			viewport->Draw();
+		}
+		ImVec2 uv0, uv1;
+		viewport->GetImageUVs(uv0, uv1); // Flipped vertically
+		ImGui::Image((ImTextureID)(intptr_t)viewport->fboTexture, size, uv0, uv1);
 
 		//END MAIN WINDOW DRAW
 		ImGui::End();
 
-		DrawToolWindow();
+		{
+			PROFILE_SCOPE("Tool Window");
+			DrawToolWindow();
+		}
+		DrawStatsWindow();
+		Profiler::Get().DrawWindow();
 
-		ImGui::Render();
-		glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE("ImGui Render");
+			ImGui::Render();
+			glClearColor(0.2f, 0.2f, 0.3f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
+		{
+			PROFILE_SCOPE("Swap");
+			glfwSwapBuffers(window);
+		}
+		Profiler::Get().EndFrame();
 	}
 
+	//the meshes cancel their jobs here, while the context is still current
+	delete viewport;
+	viewport = nullptr;
+	//cancelled jobs may still be winding down, and they record into the trace and profiler
+	WaitForDetachedTasks();
+	Profiler::Get().Shutdown();
+	if (traceOnExit && !Trace::WriteChromeTrace(traceOnExit))
+		std::cout << "Failed to write trace to " << traceOnExit << std::endl;
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
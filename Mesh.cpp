@@ -2,248 +2,513 @@
 #include "Vertex.h"
 #include "HalfEdge.h"
 #include "Face.h"
+#include "MeshSimplify.h"
+#include "MeshOrient.h"
+#include "Profiler.h"
+#include "Parallel.h"
 #include "unordered_map"
 #include "unordered_set"
+#include <algorithm>
+
+
+/// <summary>
+/// Layout of the vertex buffer
+/// </summary>
+struct VertexData {
+    glm::vec3 pos;
+    glm::vec3 normal;
+};
+
+static std::vector<VertexData> InterleaveVertices(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals) {
+    std::vector<VertexData> vertexData(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        vertexData[i].pos = positions[i];
+        vertexData[i].normal = normals[i];
+    }
+    return vertexData;
+}
 
-
-void Mesh::MeshToTriangles(const Mesh& mesh,
-    std::vector<glm::vec3>& outPositions,
-    std::vector<glm::vec3>& outNormals,
-    std::vector<unsigned int>& outIndices,
-    std::vector<unsigned int>& outEdgeIndices
-)
-{
-    outPositions.clear();
-    outNormals.clear();
-    outIndices.clear();
-    outEdgeIndices.clear();
-    //Unique edge set to avoid duplicates
-    std::unordered_set<uint64_t> edgeSet;
-
-    if (!mesh.flatShading)
-    {
-        std::unordered_map<const Vertex*, unsigned int> vertexToIndex;
-
-        unsigned int index = 0;
-        //Push all vertices to the vertex buffer
-        for (auto& v : mesh.vertices) {
-            outPositions.push_back(v->position);
-            outNormals.push_back(v->normal);
-            //Add all vertices to a dictionary with an increasing key
-            vertexToIndex[v.get()] = index++;
+void Mesh::RebuildRenderData() {
+    PROFILE_SCOPE("Mesh Rebuild");
+    positionsDirty = false;
+    if (modifierStack.InstancedFrom() > 0) {
+        SnapshotModifierBase();
+        //the last result stays in the buffers until the worker has the new one, the cage is only drawn before the first
+        if (modifiersShown) {
+            gpuDirty = false;
+            return;
         }
+    }
+    if (subdivisionLevels > 0 && !faces.empty()) {
+        BuildSubdivisionSurface(*this, subdivisionLevels, subdivisionCreases, subdivisionSurface);
+        EvaluateSubdivisionSurface(subdivisionSurface, *this, surfacePositions);
+        SubdivisionSurfaceToTriangles(subdivisionSurface, surfacePositions, flatShading,
+            renderPositions, renderNormals, renderIndices, edgeIndices, &clusters);
+        //the overlay already only shows the cage edges
+        featureEdgeIndices.clear();
+        closedSurface = std::find(subdivisionSurface.neighbours.begin(), subdivisionSurface.neighbours.end(), -1)
+            == subdivisionSurface.neighbours.end();
+    }
+    else {
+        subdivisionSurface = SubdivisionSurface();
+        surfacePositions.clear();
+        // Compute normals first
+        ComputeNormals(*this);
+        MeshToTriangles(*this, renderPositions, renderNormals, renderIndices, edgeIndices, &clusters, &featureEdgeIndices);
+        closedSurface = true;
+        for (auto& he : halfEdges) {
+            if (!he->twin) {
+                closedSurface = false;
+                break;
+            }
+        }
+    }
+    RenderDataChanged();
+}
 
+//Split corners share a position, weld them so the check sees the surface through the seams
+static bool WeldedFacesOutward(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+    std::vector<unsigned int> remap;
+    WeldPositions(positions, remap);
+    return TrianglesFaceOutwards(positions, remap, indices);
+}
 
-        //Loop through all faces
-        for (auto& f : mesh.faces) {
-            std::vector<unsigned int> faceIndices;
-            const HalfEdge* start = f->edge;
-            const HalfEdge* e = start;
-
-            //Loop through each half edge on the face
-            do {
-                faceIndices.push_back(vertexToIndex.at(e->origin));
-                //calculate edge pairs
-                unsigned int i0 = vertexToIndex.at(e->origin);
-                unsigned int i1 = vertexToIndex.at(e->next->origin);
-
-                // Sort to avoid duplicate reversed edge pairs
-                unsigned int a = std::min(i0, i1);
-                unsigned int b = std::max(i0, i1);
-
-                // Unique edge hash
-                uint64_t key = (uint64_t)a << 32 | b;
-
-                if (edgeSet.insert(key).second) {
-                    outEdgeIndices.push_back(a);
-                    outEdgeIndices.push_back(b);
-                }
+void Mesh::RenderDataChanged() {
+    //ranges from the last cull refer to the old buffers
+    clusterCullValid = false;
+    gpuDirty = true;
 
-                e = e->next;
-            } while (e != start);
+    renderVersion++;
+    CancelLodJob();
+    lods.clear();
+    lodIndices.clear();
+    lodEdgeIndices.clear();
+    lodLevel = 0;
+    facesOutward = false;
+    if (renderIndices.size() / 3 >= LOD_MIN_TRIANGLES) {
+        StartLodJob();
+    }
+    else if (closedSurface) {
+        //small enough to check right here, the worker does it for bigger meshes
+        facesOutward = WeldedFacesOutward(renderPositions, renderIndices);
+    }
+}
 
-            //Triangulate the polygon with fanning
-            for (size_t i = 1; i + 1 < faceIndices.size(); ++i) {
-                outIndices.push_back(faceIndices[0]);
-                outIndices.push_back(faceIndices[i]);
-                outIndices.push_back(faceIndices[i + 1]);
-            }
+/// <summary>
+/// Runs on a worker thread. Each level halves the previous one until the simplifier stops making progress.
+/// Only the triangle edges that are polygon edges of the full data (edges) make it into the levels' edge lists,
+/// so the overlay doesn't grow the diagonals of the triangulation when the level switches.
+/// </summary>
+static LodChain BuildLodChain(std::vector<glm::vec3> positions, std::vector<unsigned int> indices,
+    std::vector<unsigned int> edges, unsigned int version, std::shared_ptr<std::atomic<bool>> cancel)
+{
+    TRACE_SCOPE("Build LOD Chain");
+    LodChain chain;
+    chain.version = version;
+
+    //Edges are keyed on welded positions so flat shaded duplicates share an edge
+    std::vector<unsigned int> remap;
+    WeldPositions(positions, remap);
+    auto edgeKey = [&](unsigned int a, unsigned int b) {
+        a = remap[a];
+        b = remap[b];
+        return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+    };
+    std::vector<uint64_t> polygonEdges(edges.size() / 2);
+    for (size_t i = 0; i < polygonEdges.size(); ++i)
+        polygonEdges[i] = edgeKey(edges[2 * i], edges[2 * i + 1]);
+    std::sort(polygonEdges.begin(), polygonEdges.end());
+    if (cancel->load())
+        return chain;
+    chain.facesOutward = TrianglesFaceOutwards(positions, remap, indices);
+    if (cancel->load())
+        return chain;
+
+    std::vector<unsigned int> previous = std::move(indices);
+    std::vector<unsigned char> previousFlags(previous.size() / 3, 0);
+    for (size_t t = 0; t < previousFlags.size(); ++t) {
+        for (int k = 0; k < 3; ++k) {
+            if (std::binary_search(polygonEdges.begin(), polygonEdges.end(), edgeKey(previous[3 * t + k], previous[3 * t + (k + 1) % 3])))
+                previousFlags[t] |= 1 << k;
         }
     }
-    else
-    {
-        //Will result in duplicate vertices, which is intended for flat shading since a vertex can only store one normal
-        for (auto& f : mesh.faces) {
-            const HalfEdge* start = f->edge;
-            const HalfEdge* e = start;
-
-            std::vector<glm::vec3> faceVerts;
-            //Push back all connected vertices into vertex buffer for each face
-            do {
-                faceVerts.push_back(e->origin->position);
-
-                e = e->next;
-            } while (e != start);
-
-            // Compute face normal once
-            if (faceVerts.size() >= 3) {
-                glm::vec3 n = glm::normalize(glm::cross(faceVerts[1] - faceVerts[0],
-                    faceVerts[2] - faceVerts[0]));
-
-                // Fan triangulate with duplicated vertices
-                for (size_t i = 1; i + 1 < faceVerts.size(); ++i) {
-                    glm::vec3 p0 = faceVerts[0];
-                    glm::vec3 p1 = faceVerts[i];
-                    glm::vec3 p2 = faceVerts[i + 1];
-
-
-                    unsigned int startIndex = outPositions.size();
-
-                    outPositions.push_back(p0);
-                    outPositions.push_back(p1);
-                    outPositions.push_back(p2);
-
-                    outNormals.push_back(n);
-                    outNormals.push_back(n);
-                    outNormals.push_back(n);
-
-                    outIndices.push_back(startIndex);
-                    outIndices.push_back(startIndex + 1);
-                    outIndices.push_back(startIndex + 2);
-
-                    //Get edge indices
-                    //TODO: use a hash map of vertex positions to prevent duplicates
-                    outEdgeIndices.push_back(startIndex + 1);
-                    outEdgeIndices.push_back(startIndex + 2);
-                    if (i == faceVerts.size() - 2) {
-                        outEdgeIndices.push_back(startIndex);
-                        outEdgeIndices.push_back(startIndex + 2);
-                    }
-                    if (i == 1) {
-                        outEdgeIndices.push_back(startIndex);
-                        outEdgeIndices.push_back(startIndex + 1);
-                    }
-                }
+    std::vector<unsigned int> simplified;
+    std::vector<unsigned char> simplifiedFlags;
+    std::vector<uint64_t> edgeKeys;
+    for (int level = 1; level <= LOD_MAX_LEVELS; ++level) {
+        size_t target = previous.size() / 6 * 3;
+        SimplifyTriangles(positions, previous, target, simplified, cancel.get(), &previousFlags, &simplifiedFlags);
+        if (cancel->load())
+            return chain;
+        if (simplified.empty() || simplified.size() > previous.size() * 4 / 5)
+            break;
+
+        MeshLod lod;
+        lod.indexOffset = (unsigned int)chain.indices.size();
+        lod.indexCount = (unsigned int)simplified.size();
+        chain.indices.insert(chain.indices.end(), simplified.begin(), simplified.end());
+
+        //an edge two collapses merged into one stays drawn if either side was a polygon edge
+        edgeKeys.clear();
+        for (size_t i = 0; i < simplified.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                if (simplifiedFlags[i / 3] >> k & 1)
+                    edgeKeys.push_back(edgeKey(simplified[i + k], simplified[i + (k + 1) % 3]));
             }
         }
+        std::sort(edgeKeys.begin(), edgeKeys.end());
+        edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+        lod.edgeOffset = (unsigned int)chain.edgeIndices.size();
+        lod.edgeCount = (unsigned int)edgeKeys.size() * 2;
+        //welded indices are real vertices at the same position, good enough for the edge overlay
+        for (uint64_t key : edgeKeys) {
+            chain.edgeIndices.push_back((unsigned int)(key >> 32));
+            chain.edgeIndices.push_back((unsigned int)(key & 0xFFFFFFFF));
+        }
+        chain.levels.push_back(lod);
+
+        previous.swap(simplified);
+        previousFlags.swap(simplifiedFlags);
     }
+    return chain;
 }
 
-void Mesh::ComputeNormals(Mesh& mesh)
-{
-    // Reset all vertex normals
-    for (auto& v : mesh.vertices)
-        v->normal = glm::vec3(0.0f);
-
-    // Compute face normals and accumulate into vertex normals
-    for (auto& f : mesh.faces)
-    {
-        HalfEdge* e0 = f->edge;
-        if (!e0 || !e0->next || !e0->next->next)
-            continue;
+void Mesh::StartLodJob() {
+    lodCancel = std::make_shared<std::atomic<bool>>(false);
+    lodJob = RunDetached(BuildLodChain, renderPositions, renderIndices, edgeIndices, renderVersion, lodCancel);
+}
 
-        glm::vec3 p0 = e0->origin->position;
-        glm::vec3 p1 = e0->next->origin->position;
-        glm::vec3 p2 = e0->next->next->origin->position;
+void Mesh::CancelLodJob() {
+    //the worker owns copies of everything it reads, it stops at its next look at the flag and nobody waits for it
+    if (lodCancel)
+        lodCancel->store(true);
+    lodJob = std::future<LodChain>();
+    lodCancel.reset();
+}
 
-        glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+void Mesh::FinishLodJob() {
+    if (lodJob.valid())
+        lodJob.wait();
+    PollLodJob();
+}
 
-        // Assign to all vertices in this face
-        HalfEdge* e = e0;
-        do {
-            e->origin->normal += normal;
-            e = e->next;
-        } while (e != e0);
+void Mesh::PollLodJob() {
+    if (!lodJob.valid() || lodJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+    LodChain chain = lodJob.get();
+    lodCancel.reset();
+    if (chain.version != renderVersion || gpuDirty)
+        return;
+    facesOutward = closedSurface && chain.facesOutward;
+    if (chain.levels.empty())
+        return;
+
+    lodIndices = std::move(chain.indices);
+    lodEdgeIndices = std::move(chain.edgeIndices);
+    lods = std::move(chain.levels);
+    //the levels live after the full data in the same buffers
+    for (auto& lod : lods) {
+        lod.indexOffset += (unsigned int)renderIndices.size();
+        lod.edgeOffset += (unsigned int)(edgeIndices.size() + featureEdgeIndices.size());
     }
 
-    // Normalize accumulated vertex normals
-    for (auto& v : mesh.vertices)
-        v->normal = glm::normalize(v->normal);
-}
+    PROFILE_SCOPE("Mesh Upload");
+    Profiler::Get().AddCounter("Upload Bytes", (double)(renderIndices.size() + lodIndices.size() + edgeIndices.size()
+        + featureEdgeIndices.size() + lodEdgeIndices.size()) * sizeof(unsigned int));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (renderIndices.size() + lodIndices.size()) * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, renderIndices.size() * sizeof(unsigned int), renderIndices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, renderIndices.size() * sizeof(unsigned int), lodIndices.size() * sizeof(unsigned int), lodIndices.data());
 
-Vertex* Mesh::addVertex(const glm::vec3& pos) {
-    vertices.push_back(std::make_unique<Vertex>());
-    Vertex* v = vertices.back().get();
-    v->position = pos;
-    return v;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboEdges);
+    size_t baseEdges = edgeIndices.size() + featureEdgeIndices.size();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (baseEdges + lodEdgeIndices.size()) * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, edgeIndices.size() * sizeof(unsigned int), edgeIndices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, edgeIndices.size() * sizeof(unsigned int), featureEdgeIndices.size() * sizeof(unsigned int), featureEdgeIndices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, baseEdges * sizeof(unsigned int), lodEdgeIndices.size() * sizeof(unsigned int), lodEdgeIndices.data());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-Face* Mesh::addFace(const std::vector<Vertex*>& verts) {
-    if (verts.size() < 3) return nullptr;
+/// <summary>
+/// Runs on a worker thread, on a snapshot of the mesh so it can be abandoned at any point
+/// </summary>
+static MeshArrays DecimateJob(MeshArrays arrays, DecimateOptions options,
+    std::shared_ptr<std::atomic<float>> progress, std::shared_ptr<std::atomic<bool>> cancel)
+{
+    DecimateArrays(arrays, options, progress.get(), cancel.get());
+    return arrays;
+}
 
-    faces.push_back(std::make_unique<Face>());
-    Face* face = faces.back().get();
+void Mesh::StartDecimateJob(const DecimateOptions& options) {
+    CancelDecimateJob();
+    if (faces.empty())
+        return;
+    decimateCancel = std::make_shared<std::atomic<bool>>(false);
+    decimateProgress = std::make_shared<std::atomic<float>>(0.0f);
+    MeshArrays arrays;
+    MeshToArrays(*this, arrays);
+    decimateJob = RunDetached(DecimateJob, std::move(arrays), options, decimateProgress, decimateCancel);
+}
 
-    std::vector<HalfEdge*> edges;
-    edges.reserve(verts.size());
+void Mesh::CancelDecimateJob() {
+    if (decimateCancel)
+        decimateCancel->store(true);
+    decimateJob = std::future<MeshArrays>();
+    decimateCancel.reset();
+    decimateProgress.reset();
+}
 
-    // Create one edge per vertex
-    for (size_t i = 0; i < verts.size(); ++i) {
-        halfEdges.push_back(std::make_unique<HalfEdge>());
-        HalfEdge* e = halfEdges.back().get();
+void Mesh::FinishDecimateJob() {
+    if (decimateJob.valid())
+        decimateJob.wait();
+    PollDecimateJob();
+}
 
-        e->origin = verts[i];
-        e->face = face;
-        edges.push_back(e);
+void Mesh::PollDecimateJob() {
+    if (!DecimateJobReady())
+        return;
+    MeshArrays arrays = decimateJob.get();
+    decimateCancel.reset();
+    decimateProgress.reset();
+    PROFILE_SCOPE("Decimate Apply");
+    ArraysToMesh(arrays, *this);
+    gpuDirty = true;
+}
 
-        if (!verts[i]->outgoing)
-            verts[i]->outgoing = e;
+/// <summary>
+/// Runs on a worker thread. Only the shared snapshots and the copied settings are read, the mesh stays editable.
+/// </summary>
+static ModifierEvaluation ModifierJob(std::shared_ptr<const MeshArrays> input, std::vector<Modifier> modifiers,
+    size_t first, unsigned int baseVersion, bool flatShading, std::shared_ptr<std::atomic<bool>> cancel)
+{
+    ModifierEvaluation evaluation;
+    evaluation.first = first;
+    evaluation.results = EvaluateModifiers(input, modifiers, first, baseVersion, cancel.get());
+    if (first + evaluation.results.size() < modifiers.size())
+        return evaluation;
+
+    //Render data is built here too, the main thread only swaps it in and uploads
+    TRACE_SCOPE("Modifier Render Data");
+    evaluation.mesh = evaluation.results.empty() ? input : evaluation.results.back().mesh;
+    HalfEdgeMesh result;
+    ArraysToMesh(*evaluation.mesh, result);
+    result.flatShading = flatShading;
+    HalfEdgeMesh::ComputeNormals(result);
+    HalfEdgeMesh::MeshToTriangles(result, evaluation.positions, evaluation.normals, evaluation.indices,
+        evaluation.edgeIndices, &evaluation.clusters, &evaluation.featureEdgeIndices);
+    evaluation.closedSurface = std::all_of(result.halfEdges.begin(), result.halfEdges.end(),
+        [](const ElementPtr<HalfEdge>& he) { return he->twin != nullptr; });
+    evaluation.bounds = result.ComputeLocalBounds();
+    if (evaluation.bounds.IsValid()) {
+        evaluation.sphere.center = evaluation.bounds.Center();
+        float radiusSquared = 0.0f;
+        for (const auto& v : result.vertices) {
+            glm::vec3 d = v->position - evaluation.sphere.center;
+            radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+        }
+        evaluation.sphere.radius = std::sqrt(radiusSquared);
     }
+    evaluation.complete = !cancel->load();
+    return evaluation;
+}
 
-    // Link edges circularly
-    for (size_t i = 0; i < edges.size(); ++i) {
-        edges[i]->next = edges[(i + 1) % edges.size()];
-    }
+Modifier& Mesh::AddModifier(ModifierType type) {
+    modifierStack.modifiers.emplace_back();
+    modifierStack.modifiers.back().type = type;
+    ModifierChanged(modifierStack.modifiers.size() - 1);
+    return modifierStack.modifiers.back();
+}
 
-    face->edge = edges[0];
+void Mesh::ModifierChanged(size_t index) {
+    modifierStack.Changed(index);
+    ModifierStackChanged();
+}
 
-    // Twin linking (works the same as before)
-    for (auto* e : edges) {
-        auto key = std::make_pair(e->next->origin, e->origin);
-        auto reverseKey = std::make_pair(e->origin, e->next->origin);
+void Mesh::SwapModifiers(size_t index) {
+    std::swap(modifierStack.modifiers[index], modifierStack.modifiers[index + 1]);
+    //versions move with their modifiers, so the cache already misses from index on
+    ModifierStackChanged();
+}
 
-        if (edgeMap.count(reverseKey)) {
-            e->twin = edgeMap[reverseKey];
-            e->twin->twin = e;
-        }
-        else {
-            edgeMap[key] = e;
-        }
+void Mesh::RemoveModifier(size_t index) {
+    modifierStack.modifiers.erase(modifierStack.modifiers.begin() + index);
+    if (modifierStack.empty()) {
+        CancelModifierJob();
+        modifierStack = ModifierStack();
+    }
+    ModifierStackChanged();
+}
+
+void Mesh::ModifierStackChanged() {
+    //copies are only transforms, changing them never waits for the worker
+    std::vector<glm::mat4> transforms;
+    modifierStack.InstanceTransforms(transforms);
+    //reflected copies go last so each winding is one instance range
+    auto mirrored = std::stable_partition(transforms.begin(), transforms.end(),
+        [](const glm::mat4& transform) { return glm::determinant(glm::mat3(transform)) >= 0.0f; });
+    mirroredFrom = mirrored - transforms.begin();
+    if (transforms != instanceTransforms) {
+        instanceTransforms = std::move(transforms);
+        instancesDirty = true;
+        boundsDirty = true;
+    }
+    //nothing left to evaluate, the half edge mesh is drawn again
+    if (modifiersShown && modifierStack.InstancedFrom() == 0) {
+        modifiersShown = false;
+        shownResult.reset();
+        gpuDirty = true;
+        boundsDirty = true;
     }
+}
 
-    return face;
+bool Mesh::ModifierJobNeeded() const {
+    size_t evaluated = modifierStack.InstancedFrom();
+    if (evaluated == 0)
+        return false;
+    if (!modifierStack.base || modifierStack.FirstDirty() < evaluated)
+        return true;
+    //everything is cached but the render data may still show an older result
+    return !modifiersShown || shownResult != modifierStack.results[evaluated - 1].mesh;
 }
 
-void Mesh::RebuildRenderData() {
-    renderPositions.clear();
-    renderIndices.clear();
-    MeshToTriangles(*this, renderPositions, renderNormals, renderIndices, edgeIndices);
+void Mesh::ApplyModifiers() {
+    PROFILE_SCOPE("Apply Modifiers");
+    CancelModifierJob();
+    if (modifierStack.empty())
+        return;
+    //edits the render data hasn't caught up with yet aren't in the snapshot
+    if (!modifierStack.base || gpuDirty || positionsDirty)
+        SnapshotModifierBase();
+    //instanced modifiers are evaluated into geometry here too, all copies in one pass
+    size_t first = modifierStack.FirstDirty();
+    modifierStack.Store(first, EvaluateModifiers(modifierStack.Input(first), modifierStack.modifiers, first,
+        modifierStack.baseVersion));
+    std::shared_ptr<const MeshArrays> result = modifierStack.results.back().mesh;
+    ArraysToMesh(*result, *this);
+    modifierStack = ModifierStack();
+    modifiersShown = false;
+    shownResult.reset();
+    ModifierStackChanged();
     gpuDirty = true;
 }
 
+void Mesh::SnapshotModifierBase() {
+    auto base = std::make_shared<MeshArrays>();
+    MeshToArrays(*this, *base);
+    modifierStack.SetBase(std::move(base));
+}
+
+void Mesh::StartModifierJob() {
+    if (!modifierStack.base)
+        SnapshotModifierBase();
+    size_t evaluated = modifierStack.InstancedFrom();
+    size_t first = std::min(modifierStack.FirstDirty(), evaluated);
+    //with everything cached the worker only builds the render data of the last result
+    std::shared_ptr<const MeshArrays> input = modifierStack.Input(first);
+    std::vector<Modifier> modifiers(modifierStack.modifiers.begin(), modifierStack.modifiers.begin() + evaluated);
+    modifierCancel = std::make_shared<std::atomic<bool>>(false);
+    modifierJob = RunDetached(ModifierJob, input, std::move(modifiers), first,
+        modifierStack.baseVersion, flatShading, modifierCancel);
+}
+
+void Mesh::CancelModifierJob() {
+    if (modifierCancel)
+        modifierCancel->store(true);
+    modifierJob = std::future<ModifierEvaluation>();
+    modifierCancel.reset();
+}
+
+void Mesh::FinishModifierJob() {
+    if (!modifierJob.valid() && ModifierJobNeeded())
+        StartModifierJob();
+    if (modifierJob.valid())
+        modifierJob.wait();
+    PollModifierJob();
+}
+
+void Mesh::PollModifierJob() {
+    if (!ModifierJobReady())
+        return;
+    ModifierEvaluation evaluation = modifierJob.get();
+    modifierCancel.reset();
+    modifierStack.Store(evaluation.first, std::move(evaluation.results));
+    //a result one edit behind is still the newest complete one, it's drawn while the next evaluation runs
+    if (!evaluation.complete || modifierStack.InstancedFrom() == 0)
+        return;
+
+    PROFILE_SCOPE("Modifier Apply");
+    renderPositions = std::move(evaluation.positions);
+    renderNormals = std::move(evaluation.normals);
+    renderIndices = std::move(evaluation.indices);
+    edgeIndices = std::move(evaluation.edgeIndices);
+    featureEdgeIndices = std::move(evaluation.featureEdgeIndices);
+    clusters = std::move(evaluation.clusters);
+    closedSurface = evaluation.closedSurface;
+    modifierBounds = evaluation.bounds;
+    modifierSphere = evaluation.sphere;
+    shownResult = std::move(evaluation.mesh);
+    modifiersShown = true;
+    boundsDirty = true;
+    //a pending edit of the base still has to reach the stack through RebuildRenderData
+    bool rebuildPending = gpuDirty;
+    RenderDataChanged();
+    UploadToGPU();
+    gpuDirty = rebuildPending;
+}
+
+size_t Mesh::LodTriangleCount(int level) const {
+    if (level <= 0 || lods.empty())
+        return renderIndices.size() / 3 * InstanceCount();
+    return lods[std::min(level, (int)lods.size()) - 1].indexCount / 3 * InstanceCount();
+}
+
+void Mesh::SelectEdgeOverlay(float projectedRadiusPixels) {
+    size_t drawnEdges = (lodLevel > 0 ? lods[lodLevel - 1].edgeCount : edgeIndices.size()) / 2 * InstanceCount();
+    float area = glm::pi<float>() * projectedRadiusPixels * projectedRadiusPixels;
+    bool hasFeatures = !featureEdgeIndices.empty();
+    if (area >= drawnEdges * EDGE_OVERLAY_PIXELS_PER_EDGE)
+        edgeOverlay = EdgeOverlay::Full;
+    else if (hasFeatures && area >= featureEdgeIndices.size() / 2 * InstanceCount() * EDGE_OVERLAY_PIXELS_PER_EDGE)
+        edgeOverlay = EdgeOverlay::Feature;
+    else
+        edgeOverlay = EdgeOverlay::Hidden;
+
+    //the overlay is how selection shows, a selected object keeps at least its outline
+    if (selected && edgeOverlay == EdgeOverlay::Hidden)
+        edgeOverlay = hasFeatures ? EdgeOverlay::Feature : EdgeOverlay::Full;
+    else if (!selected && projectedRadiusPixels < EDGE_OVERLAY_MIN_RADIUS)
+        edgeOverlay = EdgeOverlay::Hidden;
+}
+
+void Mesh::SelectLod(float projectedRadiusPixels) {
+    PollLodJob();
+    if (lods.empty() || gpuDirty) {
+        lodLevel = 0;
+        return;
+    }
+    float idealTriangles = glm::pi<float>() * projectedRadiusPixels * projectedRadiusPixels / LOD_PIXELS_PER_TRIANGLE;
+    //finer while the current level is clearly short of triangles, coarser while the next one still has plenty
+    while (lodLevel > 0 && LodTriangleCount(lodLevel) < idealTriangles * (1.0f - LOD_HYSTERESIS))
+        lodLevel--;
+    while (lodLevel < (int)lods.size() && LodTriangleCount(lodLevel + 1) >= idealTriangles * (1.0f + LOD_HYSTERESIS))
+        lodLevel++;
+}
+
 void Mesh::UploadToGPU()
 {
     if (!gpuDirty) return;
-
-    // Compute normals first
-    ComputeNormals(*this);
-    MeshToTriangles(*this, renderPositions, renderNormals, renderIndices, edgeIndices);
+    PROFILE_SCOPE("Mesh Upload");
 
     if (!vao) glGenVertexArrays(1, &vao);
     if (!vbo) glGenBuffers(1, &vbo);
     if (!ebo) glGenBuffers(1, &ebo);
     if (!eboEdges) glGenBuffers(1, &eboEdges);
 
-    struct VertexData {
-        glm::vec3 pos;
-        glm::vec3 normal;
-    };
+    std::vector<VertexData> vertexData = InterleaveVertices(renderPositions, renderNormals);
 
-    std::vector<VertexData> vertexData(renderPositions.size());
-    for (size_t i = 0; i < renderPositions.size(); ++i) {
-        vertexData[i].pos = renderPositions[i];
-        vertexData[i].normal = renderNormals[i];
-    }
+    Profiler::Get().AddCounter("Upload Bytes", (double)(vertexData.size() * sizeof(VertexData)
+        + (renderIndices.size() + edgeIndices.size() + featureEdgeIndices.size()) * sizeof(unsigned int)));
 
     glBindVertexArray(vao);
 
@@ -261,9 +526,14 @@ void Mesh::UploadToGPU()
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboEdges);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-        edgeIndices.size() * sizeof(unsigned int),
-        edgeIndices.data(),
+        (edgeIndices.size() + featureEdgeIndices.size()) * sizeof(unsigned int),
+        nullptr,
         GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, edgeIndices.size() * sizeof(unsigned int), edgeIndices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, edgeIndices.size() * sizeof(unsigned int),
+        featureEdgeIndices.size() * sizeof(unsigned int), featureEdgeIndices.data());
+    //the vao keeps the element buffer bound last, draws expect the triangle one
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 
     // Position attribute (location = 0)
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
@@ -274,49 +544,239 @@ void Mesh::UploadToGPU()
     glEnableVertexAttribArray(1);
 
     glBindVertexArray(0);
+
+    //views stay valid when the buffers are reallocated, so they only need creating once
+    if (!vertexTexture) {
+        glGenTextures(1, &vertexTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, vbo);
+    }
+    if (!edgeIndexTexture) {
+        glGenTextures(1, &edgeIndexTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, edgeIndexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, eboEdges);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
     gpuDirty = false;
 }
 
-void Mesh::Draw(Shader& shader) {
+void Mesh::UpdatePositions() {
+    positionsDirty = false;
     if (gpuDirty)
-        RebuildRenderData(), UploadToGPU();
-    if (transformDirty)
-        UpdateModelMatrix();
+        return;
+    //without a preview the render data is rebuilt from the half edges anyway, the same goes for a changed vertex count
+    //and for a modifier stack, which needs a new base snapshot
+    if (modifierStack.InstancedFrom() > 0 || subdivisionLevels <= 0 || !EvaluateSubdivisionSurface(subdivisionSurface, *this, surfacePositions)) {
+        gpuDirty = true;
+        return;
+    }
+    PROFILE_SCOPE("Mesh Update Positions");
+    UpdateSubdivisionSurfaceTriangles(subdivisionSurface, surfacePositions, flatShading, renderIndices,
+        renderPositions, renderNormals, &clusters);
+
+    //Same vertex count and layout, so the buffer is rewritten in place. Indices, edges and the
+    //level of detail chain only depend on the topology and stay, the chain just follows the moved vertices.
+    std::vector<VertexData> vertexData = InterleaveVertices(renderPositions, renderNormals);
+    Profiler::Get().AddCounter("Upload Bytes", (double)(vertexData.size() * sizeof(VertexData)));
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexData.size() * sizeof(VertexData), vertexData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    shader.use();
-    shader.setBool("lightingEnabled", true);
-    shader.setMat4("model", GetModelMatrix());
-    shader.setVec4("objectColor", ObjectColor);
+void Mesh::FlipNormals(const std::vector<Face*>* selection) {
+    PROFILE_SCOPE("Flip Normals");
+    FlipFaces(selection);
+    //Modifiers using this mesh as their operand snapshot it again when this moves, whichever path runs below. A
+    //rebuild bumps it once more, but a culled mesh isn't rebuilt until it's seen.
+    renderVersion++;
+    //A partial flip cuts edges apart and the preview's stencils follow the topology, both need the full rebuild
+    if (selection || subdivisionLevels > 0 || modifierStack.InstancedFrom() > 0 || gpuDirty || positionsDirty) {
+        gpuDirty = true;
+        return;
+    }
 
-    //Draw Faces
-    glBindVertexArray(vao);
+    //Same triangles wound the other way, facing the other way. Positions, edges and cluster ranges stay.
+    auto reverseTriangles = [](std::vector<unsigned int>& indices) {
+        ParallelFor(indices.size() / 3, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t)
+                std::swap(indices[3 * t + 1], indices[3 * t + 2]);
+        });
+    };
+    reverseTriangles(renderIndices);
+    reverseTriangles(lodIndices);
+    ParallelFor(renderNormals.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            renderNormals[i] = -renderNormals[i];
+    });
+    for (auto& cluster : clusters)
+        cluster.coneAxis = -cluster.coneAxis;
+
+    std::vector<VertexData> vertexData = InterleaveVertices(renderPositions, renderNormals);
+    Profiler::Get().AddCounter("Upload Bytes", (double)(vertexData.size() * sizeof(VertexData)
+        + (renderIndices.size() + lodIndices.size()) * sizeof(unsigned int)));
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertexData.size() * sizeof(VertexData), vertexData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glDrawElements(GL_TRIANGLES, renderIndices.size(), GL_UNSIGNED_INT, 0);
-
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, renderIndices.size() * sizeof(unsigned int), renderIndices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, renderIndices.size() * sizeof(unsigned int), lodIndices.size() * sizeof(unsigned int), lodIndices.data());
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+
+    //a chain still being simplified was started from the old winding and is dropped for the version bump above,
+    //an applied one was reversed in place with the rest
+    if (LodJobPending()) {
+        CancelLodJob();
+        facesOutward = false;
+        StartLodJob();
+    }
+    else if (closedSurface) {
+        //an outward mesh now faces in, but only the check tells which pieces of a mixed one came out right
+        facesOutward = WeldedFacesOutward(renderPositions, renderIndices);
+    }
+    //the next cull picks up the flipped cones
+    clusterCullValid = false;
 }
 
-void Mesh::DrawEdges(Shader& shader) {
+void Mesh::CullClusters(const Frustum& frustum, const glm::vec3& cameraPos) {
+    if (positionsDirty)
+        UpdatePositions();
     if (gpuDirty)
         RebuildRenderData(), UploadToGPU();
     if (transformDirty)
         UpdateModelMatrix();
+    if (instancesDirty)
+        UploadInstances();
+
+    visibleIndexCounts.clear();
+    visibleIndexOffsets.clear();
+    visibleEdgeCounts.clear();
+    visibleEdgeOffsets.clear();
+    visibleTriangleCount = 0;
+    clustersCulled = 0;
+    clusterCullValid = true;
+
+    if (lodLevel > 0) {
+        const MeshLod& lod = lods[lodLevel - 1];
+        visibleIndexCounts.push_back((GLsizei)lod.indexCount);
+        visibleIndexOffsets.push_back((const void*)(uintptr_t)(lod.indexOffset * sizeof(unsigned int)));
+        visibleEdgeCounts.push_back((GLsizei)lod.edgeCount);
+        visibleEdgeOffsets.push_back((const void*)(uintptr_t)(lod.edgeOffset * sizeof(unsigned int)));
+        visibleTriangleCount = lod.indexCount / 3 * InstanceCount();
+        return;
+    }
+
+    //clusters are culled for one copy, instanced copies are drawn whole
+    if (clusters.empty() || !instanceTransforms.empty()) {
+        visibleIndexCounts.push_back((GLsizei)renderIndices.size());
+        visibleIndexOffsets.push_back((const void*)0);
+        visibleEdgeCounts.push_back((GLsizei)edgeIndices.size());
+        visibleEdgeOffsets.push_back((const void*)0);
+        visibleTriangleCount = renderIndices.size() / 3 * InstanceCount();
+        return;
+    }
 
-    shader.use();
+    //Cull in local space so the cluster bounds never need transforming
+    Frustum localFrustum = frustum.ToLocalSpace(Model);
+    glm::vec3 localCamera = glm::vec3(glm::inverse(Model) * glm::vec4(cameraPos, 1.0f));
+    //Back facing clusters of an open surface can be seen through its holes, and the near side of an inside out one
+    //faces away from the camera, only closed surfaces known to face outwards hide them
+    bool backfaceCulling = facesOutward;
+
+    //adjacent visible clusters merge into one range so the multi draw stays short
+    auto addRange = [](std::vector<GLsizei>& counts, std::vector<const void*>& offsets, unsigned int& rangeEnd,
+        unsigned int offset, unsigned int count) {
+        if (count == 0) return;
+        if (!counts.empty() && rangeEnd == offset) {
+            counts.back() += count;
+        }
+        else {
+            counts.push_back(count);
+            offsets.push_back((const void*)(uintptr_t)(offset * sizeof(unsigned int)));
+        }
+        rangeEnd = offset + count;
+    };
+    unsigned int indexEnd = 0, edgeEnd = 0;
+    for (const auto& cluster : clusters) {
+        if (localFrustum.TestSphere(cluster.sphere.center, cluster.sphere.radius) == Containment::Outside
+            || (backfaceCulling && ClusterBackfacing(cluster, localCamera))) {
+            clustersCulled++;
+            continue;
+        }
+        addRange(visibleIndexCounts, visibleIndexOffsets, indexEnd, cluster.indexOffset, cluster.indexCount);
+        addRange(visibleEdgeCounts, visibleEdgeOffsets, edgeEnd, cluster.edgeOffset, cluster.edgeCount);
+        visibleTriangleCount += cluster.indexCount / 3;
+    }
+}
+
+int Mesh::Draw(Shader& shader) {
     shader.setMat4("model", GetModelMatrix());
-    shader.setVec4("edgeColor", selected ? glm::vec4(0.0f, 1.0f, 1.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
-    shader.setFloat("lineWidth", 2.0f);
+    shader.setVec4("objectColor", ObjectColor);
+    shader.setBool("instanced", !instanceTransforms.empty());
+
+    //Copies are drawn in two runs, the reflected ones with clockwise fronts so they don't show their back faces.
+    //Without instances the single run has one copy and no matrix.
+    auto drawCopies = [&](GLsizei count, const void* offset) {
+        int drawCalls = 0;
+        size_t copies = InstanceCount();
+        size_t plain = instanceTransforms.empty() ? copies : mirroredFrom;
+        if (plain > 0) {
+            shader.setInt("instanceBase", 0);
+            glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset, (GLsizei)plain);
+            drawCalls++;
+        }
+        if (plain < copies) {
+            shader.setInt("instanceBase", (int)plain);
+            glFrontFace(GL_CW);
+            glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, offset, (GLsizei)(copies - plain));
+            glFrontFace(GL_CCW);
+            drawCalls++;
+        }
+        return drawCalls;
+    };
 
-    glEnable(GL_POLYGON_OFFSET_FILL);
-    glPolygonOffset(-1.0f, -1.0f);  // Pull edges toward the camera
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboEdges);
-    glDrawElements(GL_LINES, edgeIndices.size(), GL_UNSIGNED_INT, 0);
-    glDisable(GL_POLYGON_OFFSET_FILL);
+    //Draw Faces, the vao holds ebo
+    if (!clusterCullValid)
+        return drawCopies((GLsizei)renderIndices.size(), 0);
+    if (visibleIndexCounts.empty())
+        return 0;
+    //one draw for every copy of the ranges, instanced meshes only ever have the one range
+    if (!instanceTransforms.empty()) {
+        int drawCalls = 0;
+        for (size_t i = 0; i < visibleIndexCounts.size(); ++i)
+            drawCalls += drawCopies(visibleIndexCounts[i], visibleIndexOffsets[i]);
+        return drawCalls;
+    }
+    glMultiDrawElements(GL_TRIANGLES, visibleIndexCounts.data(), GL_UNSIGNED_INT, visibleIndexOffsets.data(), (GLsizei)visibleIndexCounts.size());
+    return 1;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+int Mesh::DrawEdges(Shader& shader) {
+    if (edgeOverlay == EdgeOverlay::Hidden)
+        return 0;
+
+    shader.setMat4("model", GetModelMatrix());
+    shader.setVec4("edgeColor", selected ? glm::vec4(0.0f, 1.0f, 1.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    shader.setBool("instanced", !instanceTransforms.empty());
+
+    //ranges are in indices, two per edge, and each edge of each copy is one instance of a four vertex strip
+    int drawCalls = 0;
+    auto drawRange = [&](size_t firstIndex, size_t indexCount) {
+        if (indexCount < 2) return;
+        shader.setInt("edgeBase", (int)(firstIndex / 2));
+        shader.setInt("edgeCount", (int)(indexCount / 2));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(indexCount / 2 * InstanceCount()));
+        drawCalls++;
+    };
+    if (edgeOverlay == EdgeOverlay::Feature)
+        drawRange(edgeIndices.size(), featureEdgeIndices.size());
+    else if (!clusterCullValid)
+        drawRange(0, edgeIndices.size());
+    else {
+        for (size_t i = 0; i < visibleEdgeCounts.size(); ++i)
+            drawRange((uintptr_t)visibleEdgeOffsets[i] / sizeof(unsigned int), visibleEdgeCounts[i]);
+    }
+    return drawCalls;
 }
 
 void Mesh::OriginToGeometry() {
@@ -328,11 +788,87 @@ void Mesh::OriginToGeometry() {
     LocalOrigin = cumulativePosition / (float)numVertices;
 }
 
+void Mesh::UpdateLocalBounds() {
+    boundsDirty = false;
+    //culling has to fit what's drawn
+    if (modifiersShown) {
+        localBounds = modifierBounds;
+        localSphere = modifierSphere;
+    }
+    else {
+        localBounds = ComputeLocalBounds();
+        //Sphere around the box center, tighter than the box's half diagonal
+        localSphere = BoundingSphere();
+        if (localBounds.IsValid()) {
+            localSphere.center = localBounds.Center();
+            float radiusSquared = 0.0f;
+            for (auto& v : vertices) {
+                glm::vec3 d = v->position - localSphere.center;
+                radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+            }
+            localSphere.radius = std::sqrt(radiusSquared);
+        }
+    }
+    if (instanceTransforms.empty() || !localBounds.IsValid())
+        return;
+    //The bounds of every copy, and a sphere around the copies' spheres
+    AABB single = localBounds;
+    BoundingSphere singleSphere = localSphere;
+    localBounds = AABB();
+    for (const glm::mat4& transform : instanceTransforms)
+        localBounds.Expand(single.Transformed(transform));
+    localSphere.center = localBounds.Center();
+    localSphere.radius = 0.0f;
+    for (const glm::mat4& transform : instanceTransforms) {
+        BoundingSphere copy = singleSphere.Transformed(transform);
+        localSphere.radius = std::max(localSphere.radius, glm::distance(copy.center, localSphere.center) + copy.radius);
+    }
+}
+
+void Mesh::UpdateBounds() {
+    //a finished decimation or modifier evaluation changes the bounds, so they're applied here where every mesh passes each frame
+    PollDecimateJob();
+    PollModifierJob();
+    //one evaluation at a time, edits made while it runs are picked up by the next one
+    if (!modifierJob.valid() && ModifierJobNeeded())
+        StartModifierJob();
+    if (boundsDirty) {
+        UpdateLocalBounds();
+        UpdateWorldBounds();
+    }
+    if (transformDirty)
+        UpdateModelMatrix();
+}
+
+void Mesh::UploadInstances() {
+    instancesDirty = false;
+    if (instanceTransforms.empty())
+        return;
+    PROFILE_SCOPE("Instance Upload");
+    Profiler::Get().AddCounter("Upload Bytes", (double)(instanceTransforms.size() * sizeof(glm::mat4)));
+    if (!instanceBuffer)
+        glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, instanceTransforms.size() * sizeof(glm::mat4), instanceTransforms.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    //a matrix is four texels, one per column
+    if (!instanceTexture) {
+        glGenTextures(1, &instanceTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
 void Mesh::ClearGPU() {
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
     glDeleteBuffers(1, &ebo);
     glDeleteBuffers(1, &eboEdges);
+    glDeleteTextures(1, &vertexTexture);
+    glDeleteTextures(1, &edgeIndexTexture);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteTextures(1, &instanceTexture);
 }
 
 glm::vec3 Mesh::GetGlobalOrigin() {
@@ -8,27 +8,110 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
-#include "Vertex.h"
-#include "HalfEdge.h"
-#include "Face.h"
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include "HalfEdgeMesh.h"
+#include "Subdivision.h"
+#include "MeshDecimate.h"
+#include "ModifierStack.h"
 
 /// <summary>
-/// Used for hashing a pair of vertices when inserting a half edge into a lookup table
+/// Meshes with fewer render triangles than this don't get a level of detail chain
 /// </summary>
-struct PairHash {
-    size_t operator()(const std::pair<Vertex*, Vertex*>& p) const noexcept {
-        return std::hash<Vertex*>()(p.first) ^ (std::hash<Vertex*>()(p.second) << 1);
-    }
+const size_t LOD_MIN_TRIANGLES = 4096;
+const int LOD_MAX_LEVELS = 4;
+/// <summary>
+/// Screen area (in pixels, of the projected bounding sphere) each drawn triangle should cover
+/// </summary>
+const float LOD_PIXELS_PER_TRIANGLE = 12.0f;
+/// <summary>
+/// Fraction the triangle budget has to move past a level before switching, keeps levels from flickering
+/// </summary>
+const float LOD_HYSTERESIS = 0.25f;
+
+/// <summary>
+/// Objects with a smaller on screen radius (pixels) don't get an edge overlay at all
+/// </summary>
+const float EDGE_OVERLAY_MIN_RADIUS = 6.0f;
+/// <summary>
+/// Screen area (pixels) each drawn edge should have to itself, denser overlays fall back to the feature edges
+/// </summary>
+const float EDGE_OVERLAY_PIXELS_PER_EDGE = 48.0f;
+
+/// <summary>
+/// Which edges DrawEdges draws
+/// </summary>
+enum class EdgeOverlay {
+    Hidden = 0,
+    /// <summary>
+    /// Only boundary and sharp edges
+    /// </summary>
+    Feature = 1,
+    Full = 2
 };
 
-class Mesh {
+/// <summary>
+/// A reduced level of detail, offsets are into the GPU index buffers which hold the full render data first
+/// </summary>
+struct MeshLod {
+    unsigned int indexOffset = 0, indexCount = 0;
+    unsigned int edgeOffset = 0, edgeCount = 0;
+};
+
+/// <summary>
+/// Output of the background simplification job
+/// </summary>
+struct LodChain {
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> edgeIndices;
+    /// <summary>
+    /// Offsets relative to indices/edgeIndices
+    /// </summary>
+    std::vector<MeshLod> levels;
+    /// <summary>
+    /// renderVersion of the data it was built from
+    /// </summary>
+    unsigned int version = 0;
+    /// <summary>
+    /// The data it was built from is closed and faces outwards, see TrianglesFaceOutwards
+    /// </summary>
+    bool facesOutward = false;
+};
+
+/// <summary>
+/// Output of the background modifier evaluation: the new cache entries and, when the stack ran to the end,
+/// the render data of its result
+/// </summary>
+struct ModifierEvaluation {
+    /// <summary>
+    /// Index of the modifier results[0] belongs to
+    /// </summary>
+    size_t first = 0;
+    std::vector<ModifierResult> results;
+    bool complete = false;
+    /// <summary>
+    /// The result the render data was built from
+    /// </summary>
+    std::shared_ptr<const MeshArrays> mesh;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> edgeIndices;
+    std::vector<unsigned int> featureEdgeIndices;
+    std::vector<MeshCluster> clusters;
+    bool closedSurface = false;
+    AABB bounds;
+    BoundingSphere sphere;
+};
+
+/// <summary>
+/// A scene object: half edge geometry plus its transform, render data and GPU buffers.
+/// </summary>
+class Mesh : public HalfEdgeMesh {
 public:
     //TODO: Object only has one stored vec3 per transformation
     //transformations along axis are affected by objects rotation, only affects the single model matrix.
-    //Mesh Data
-    std::vector<std::unique_ptr<Vertex>> vertices;
-    std::vector<std::unique_ptr<HalfEdge>> halfEdges;
-    std::vector<std::unique_ptr<Face>> faces;
     std::string name;
 
     //Transformations
@@ -38,18 +121,117 @@ public:
 
     //Drawing
     GLuint vao = 0, vbo = 0, ebo = 0, eboEdges = 0;
+    /// <summary>
+    /// Texture buffer views of vbo and eboEdges, the edge shader fetches line endpoints through them
+    /// </summary>
+    GLuint vertexTexture = 0, edgeIndexTexture = 0;
     bool gpuDirty = true; // needs to re-upload?
+    /// <summary>
+    /// Only vertex positions moved since the last rebuild, set through MarkPositionsDirty
+    /// </summary>
+    bool positionsDirty = false;
     bool transformDirty = false;
     std::vector<glm::vec3> renderPositions;
     std::vector<unsigned int> renderIndices;
     std::vector<glm::vec3> renderNormals;
     std::vector<unsigned int> edgeIndices;
     /// <summary>
-    /// Used to store an edge as a pair of vertices for quick lookup when finding the adjacent halfedge (twin)
+    /// Boundary and sharp edges, uploaded to eboEdges right after edgeIndices
     /// </summary>
-    std::unordered_map<std::pair<Vertex*, Vertex*>, HalfEdge*, PairHash> edgeMap;
+    std::vector<unsigned int> featureEdgeIndices;
+    EdgeOverlay edgeOverlay = EdgeOverlay::Full;
+    /// <summary>
+    /// Spatially coherent triangle/edge ranges of the render data, empty for small meshes
+    /// </summary>
+    std::vector<MeshCluster> clusters;
+    /// <summary>
+    /// Every half edge has a twin
+    /// </summary>
+    bool closedSurface = false;
+    /// <summary>
+    /// The render data is closed and every piece of it is wound outwards, so back facing clusters are always hidden
+    /// behind front facing ones. Checked with the level of detail chain, false until that is done.
+    /// </summary>
+    bool facesOutward = false;
+    //Ranges that survived the last CullClusters, counts in indices and offsets in bytes like glMultiDrawElements takes.
+    //The edge ranges are drawn as instanced quads, one instance per index pair.
+    std::vector<GLsizei> visibleIndexCounts;
+    std::vector<const void*> visibleIndexOffsets;
+    std::vector<GLsizei> visibleEdgeCounts;
+    std::vector<const void*> visibleEdgeOffsets;
+    //Level of detail
+    std::vector<MeshLod> lods;
+    std::vector<unsigned int> lodIndices;
+    std::vector<unsigned int> lodEdgeIndices;
+    /// <summary>
+    /// 0 draws the full render data, n draws lods[n - 1]
+    /// </summary>
+    int lodLevel = 0;
+    /// <summary>
+    /// Incremented on every render data rebuild so stale simplification results are thrown away
+    /// </summary>
+    unsigned int renderVersion = 0;
+    std::future<LodChain> lodJob;
+    std::shared_ptr<std::atomic<bool>> lodCancel;
+    //Decimation, the worker reduces a snapshot in index form and hands it back
+    std::future<MeshArrays> decimateJob;
+    std::shared_ptr<std::atomic<bool>> decimateCancel;
+    std::shared_ptr<std::atomic<float>> decimateProgress;
+    //Subdivision preview
+    /// <summary>
+    /// 0 renders the mesh itself, above that the render data is its Catmull-Clark surface refined this many times.
+    /// The half edge mesh stays the control cage, the preview never touches it.
+    /// </summary>
+    int subdivisionLevels = 0;
+    bool subdivisionCreases = false;
+    SubdivisionSurface subdivisionSurface;
+    /// <summary>
+    /// Refined positions from the last stencil evaluation
+    /// </summary>
+    std::vector<glm::vec3> surfacePositions;
+    //Modifier stack, the half edge mesh is its base and stays editable while the worker evaluates on a snapshot
+    ModifierStack modifierStack;
+    std::future<ModifierEvaluation> modifierJob;
+    std::shared_ptr<std::atomic<bool>> modifierCancel;
+    /// <summary>
+    /// The render data is the stack's last complete result rather than the half edge mesh
+    /// </summary>
+    bool modifiersShown = false;
+    /// <summary>
+    /// The stack result the render data was built from
+    /// </summary>
+    std::shared_ptr<const MeshArrays> shownResult;
+    /// <summary>
+    /// Local transforms of the copies the trailing instanced modifiers draw, empty for one plain draw
+    /// </summary>
+    std::vector<glm::mat4> instanceTransforms;
+    /// <summary>
+    /// Copies from here on are reflected and wind the other way round, they're drawn with the front face flipped
+    /// </summary>
+    size_t mirroredFrom = 0;
+    /// <summary>
+    /// instanceTransforms on the GPU, the shaders fetch each instance's matrix through the texture buffer view
+    /// </summary>
+    GLuint instanceBuffer = 0, instanceTexture = 0;
+    bool instancesDirty = false;
+    /// <summary>
+    /// Bounds of the shown result, what culling uses while modifiersShown
+    /// </summary>
+    AABB modifierBounds;
+    BoundingSphere modifierSphere;
+    size_t visibleTriangleCount = 0;
+    int clustersCulled = 0;
+    bool clusterCullValid = false;
+    //Bounds
+    AABB localBounds;
+    BoundingSphere localSphere;
+    /// <summary>
+    /// localBounds transformed by the model matrix, refreshed with the model matrix
+    /// </summary>
+    AABB worldBounds;
+    BoundingSphere worldSphere;
+
     glm::vec4 ObjectColor = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
-    bool flatShading = true;
     bool selected = false;
 
     Mesh Clone() const
@@ -60,65 +242,30 @@ public:
         copy.Rotation = Rotation;
         copy.Translation = Translation;
         copy.ObjectColor = ObjectColor;
-        copy.flatShading = flatShading;
-        copy.selected = selected;
+        //selection goes through the viewport's list, the copy joins it when it is selected there
+        copy.selected = false;
         copy.renderPositions = renderPositions;
         copy.renderIndices = renderIndices;
         copy.renderNormals = renderNormals;
         copy.edgeIndices = edgeIndices;
+        copy.featureEdgeIndices = featureEdgeIndices;
+        copy.clusters = clusters;
+        copy.closedSurface = closedSurface;
+        copy.facesOutward = facesOutward;
+        copy.subdivisionLevels = subdivisionLevels;
+        copy.subdivisionCreases = subdivisionCreases;
+        //only the settings, the copy evaluates its own stack from its own base
+        copy.modifierStack.modifiers = modifierStack.modifiers;
+        copy.instanceTransforms = instanceTransforms;
+        copy.mirroredFrom = mirroredFrom;
+        copy.instancesDirty = !instanceTransforms.empty();
         copy.gpuDirty = true; // force rebuild on GPU
         copy.Model = Model;
-
-        // --- Step 1: Duplicate all objects ---
-        std::unordered_map<const Vertex*, Vertex*> vertexMap;
-        std::unordered_map<const HalfEdge*, HalfEdge*> halfEdgeMap;
-        std::unordered_map<const Face*, Face*> faceMap;
-
-        // Duplicate vertices
-        for (const auto& v : vertices) {
-            copy.vertices.push_back(std::make_unique<Vertex>(*v));
-            vertexMap[v.get()] = copy.vertices.back().get();
-        }
-
-        // Duplicate faces
-        for (const auto& f : faces) {
-            copy.faces.push_back(std::make_unique<Face>(*f));
-            faceMap[f.get()] = copy.faces.back().get();
-        }
-
-        // Duplicate half-edges
-        for (const auto& he : halfEdges) {
-            copy.halfEdges.push_back(std::make_unique<HalfEdge>(*he));
-            halfEdgeMap[he.get()] = copy.halfEdges.back().get();
-        }
-
-        // --- Step 2: Fix up internal pointers ---
-        for (const auto& he : halfEdges) {
-            HalfEdge* newHe = halfEdgeMap[he.get()];
-
-            if (he->next) newHe->next = halfEdgeMap[he->next];
-            if (he->twin) newHe->twin = halfEdgeMap[he->twin];
-            if (he->origin) newHe->origin = vertexMap[he->origin];
-            if (he->face) newHe->face = faceMap[he->face];
-        }
-
-        for (const auto& f : faces) {
-            Face* newF = faceMap[f.get()];
-            if (f->edge) newF->edge = halfEdgeMap[f->edge];
-        }
-
-        for (const auto& v : vertices) {
-            Vertex* newV = vertexMap[v.get()];
-            if (v->outgoing) newV->outgoing = halfEdgeMap[v->outgoing];
-        }
-
-        // --- Step 3: Rebuild edge map ---
-        for (const auto& [edgePair, he] : edgeMap) {
-            Vertex* newV1 = vertexMap[edgePair.first];
-            Vertex* newV2 = vertexMap[edgePair.second];
-            HalfEdge* newHe = halfEdgeMap[he];
-            copy.edgeMap[{newV1, newV2}] = newHe;
-        }
+        copy.localBounds = localBounds;
+        copy.localSphere = localSphere;
+        copy.worldBounds = worldBounds;
+        copy.worldSphere = worldSphere;
+        CloneInto(copy);
 
         return copy;
     }
@@ -127,33 +274,178 @@ public:
         return Model;
     }
 
-    static void MeshToTriangles(const Mesh& mesh,
-        std::vector<glm::vec3>& outPositions,
-        std::vector<glm::vec3>& outNormals,
-        std::vector<unsigned int>& outIndices,
-        std::vector<unsigned int>& outEdgeIndices);
+    void RebuildRenderData();
 
-    static void ComputeNormals(Mesh& mesh);
+    void UploadToGPU();
 
-    Vertex* addVertex(const glm::vec3& pos);
+    /// <summary>
+    /// Call after moving vertices without changing the topology. With a subdivision preview only the stencils are
+    /// re-evaluated and the vertex buffer rewritten, otherwise it falls back to a full rebuild.
+    /// </summary>
+    void MarkPositionsDirty() {
+        positionsDirty = true;
+        boundsDirty = true;
+    }
 
-    Face* addFace(const std::vector<Vertex*>& verts);
+    /// <summary>
+    /// Positions only refresh of the render data and vertex buffer, see MarkPositionsDirty
+    /// </summary>
+    void UpdatePositions();
 
-    void RebuildRenderData();
+    /// <summary>
+    /// Turns the given faces, or all of them with null, inside out (see FlipFaces). A whole mesh flip reverses the
+    /// triangles and negates the normals of the existing render data in place instead of rebuilding it.
+    /// </summary>
+    void FlipNormals(const std::vector<Face*>* selection = nullptr);
 
-    void UploadToGPU();
+    /// <summary>
+    /// Picks the clusters to draw this frame against the world space frustum and camera position.
+    /// Draw and DrawEdges draw everything if this wasn't called since the last rebuild.
+    /// </summary>
+    void CullClusters(const Frustum& frustum, const glm::vec3& cameraPos);
 
-    void Draw(Shader& shader);
+    /// <summary>
+    /// Picks the level of detail from the on screen radius of the bounding sphere, in pixels
+    /// </summary>
+    void SelectLod(float projectedRadiusPixels);
 
-    void DrawEdges(Shader& shader);
+    /// <summary>
+    /// Triangles drawn at a level, over every instanced copy
+    /// </summary>
+    size_t LodTriangleCount(int level) const;
+
+    size_t InstanceCount() const {
+        return std::max<size_t>(1, instanceTransforms.size());
+    }
+
+    /// <summary>
+    /// True while a level of detail chain is being built in the background
+    /// </summary>
+    bool LodJobPending() const {
+        return lodJob.valid();
+    }
+
+    /// <summary>
+    /// True once the background chain is done and the next SelectLod will pick it up
+    /// </summary>
+    bool LodJobReady() const {
+        return lodJob.valid() && lodJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// <summary>
+    /// Blocks until the background chain is built and uploads it, for runs that need the scene settled up front
+    /// </summary>
+    void FinishLodJob();
+
+    /// <summary>
+    /// Starts decimating the half edge mesh on a worker thread (see DecimateMesh). The worker reduces a snapshot and
+    /// the reduced mesh replaces this one on the first UpdateBounds after it's done, so edits made while
+    /// DecimateJobPending would be lost.
+    /// </summary>
+    void StartDecimateJob(const DecimateOptions& options);
+
+    /// <summary>
+    /// Tells the worker to stop and throws its result away without waiting for it, the mesh stays as it was
+    /// </summary>
+    void CancelDecimateJob();
+
+    bool DecimateJobPending() const {
+        return decimateJob.valid();
+    }
+
+    bool DecimateJobReady() const {
+        return decimateJob.valid() && decimateJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// <summary>
+    /// Blocks until the worker is done and applies its result, for runs that need the scene settled up front
+    /// </summary>
+    void FinishDecimateJob();
+
+    /// <summary>
+    /// 0 to 1 while DecimateJobPending
+    /// </summary>
+    float DecimateJobProgress() const {
+        return decimateProgress ? decimateProgress->load(std::memory_order_relaxed) : 0.0f;
+    }
+
+    /// <summary>
+    /// Appends a modifier to the stack, the last result stays drawn until the worker has evaluated the new one
+    /// </summary>
+    Modifier& AddModifier(ModifierType type);
+
+    /// <summary>
+    /// Call after changing the settings of modifierStack.modifiers[index], it and the modifiers after it are re-evaluated
+    /// </summary>
+    void ModifierChanged(size_t index);
+
+    /// <summary>
+    /// Swaps modifiers index and index + 1
+    /// </summary>
+    void SwapModifiers(size_t index);
+
+    /// <summary>
+    /// Removing the last one draws the half edge mesh again
+    /// </summary>
+    void RemoveModifier(size_t index);
+
+    /// <summary>
+    /// Evaluates whatever the cache is missing on this thread and makes the result the half edge mesh, the stack is cleared
+    /// </summary>
+    void ApplyModifiers();
+
+    /// <summary>
+    /// The evaluated part of the stack has changed since the result being drawn, true until a job picks it up
+    /// </summary>
+    bool ModifierJobNeeded() const;
+
+    bool ModifierJobPending() const {
+        return modifierJob.valid();
+    }
+
+    bool ModifierJobReady() const {
+        return modifierJob.valid() && modifierJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// <summary>
+    /// Blocks until the stack is evaluated and shows the result, for runs that need the scene settled up front
+    /// </summary>
+    void FinishModifierJob();
+
+    /// <summary>
+    /// Picks how much of the edge overlay to draw from the on screen radius, so its cost follows screen coverage.
+    /// Call after SelectLod, the density is measured on the level being drawn.
+    /// </summary>
+    void SelectEdgeOverlay(float projectedRadiusPixels);
+
+    /// <summary>
+    /// Sets the per object uniforms and draws the faces. Expects the object shader in use and vao bound (see RenderQueue).
+    /// Returns the number of draw calls made.
+    /// </summary>
+    int Draw(Shader& shader);
+
+    /// <summary>
+    /// Sets the per object uniforms and draws the edge quads. Expects the edge shader in use, an attributeless vao bound
+    /// and vertexTexture/edgeIndexTexture bound to units 0 and 1. Returns the number of draw calls made.
+    /// </summary>
+    int DrawEdges(Shader& shader);
 
     void OriginToGeometry();
 
     glm::vec3 GetGlobalOrigin();
 
+    /// <summary>
+    /// Applies a finished decimation or modifier evaluation, starts the next evaluation the stack needs and brings
+    /// the model matrix, local and world bounds up to date. Called once per frame before culling.
+    /// </summary>
+    void UpdateBounds();
+
     Mesh() = default;
 
     ~Mesh() {
+        CancelDecimateJob();
+        CancelModifierJob();
+        CancelLodJob();
         ClearGPU();
     }
 
@@ -174,6 +466,44 @@ private:
 
     void ClearGPU();
 
+    void UploadInstances();
+
+    void StartLodJob();
+
+    void CancelLodJob();
+
+    void PollLodJob();
+
+    void PollDecimateJob();
+
+    /// <summary>
+    /// Copies the half edge mesh into the stack as its new base
+    /// </summary>
+    void SnapshotModifierBase();
+
+    void StartModifierJob();
+
+    void CancelModifierJob();
+
+    void PollModifierJob();
+
+    /// <summary>
+    /// Refreshes the instance transforms and falls back to drawing the half edge mesh when nothing is evaluated
+    /// </summary>
+    void ModifierStackChanged();
+
+    /// <summary>
+    /// What the render data changing means for the buffers and the level of detail chain, shared by every rebuild
+    /// </summary>
+    void RenderDataChanged();
+
+    void UpdateLocalBounds();
+
+    void UpdateWorldBounds() {
+        worldBounds = localBounds.Transformed(Model);
+        worldSphere = localSphere.Transformed(Model);
+    }
+
     void UpdateModelMatrix() {
         glm::mat4 model(1.0f);
 
@@ -186,5 +516,7 @@ private:
         model = glm::scale(model, Scale);
 
         Model = model;
+        transformDirty = false;
+        UpdateWorldBounds();
     }
 };
\ No newline at end of file
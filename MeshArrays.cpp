@@ -0,0 +1,239 @@
+#include "MeshArrays.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+void MeshToArrays(const HalfEdgeMesh& mesh, MeshArrays& arrays) {
+    TRACE_SCOPE("Mesh To Arrays");
+    std::unordered_map<const Vertex*, int> vertexIndex;
+    std::unordered_map<const HalfEdge*, int> edgeIndex;
+    vertexIndex.reserve(mesh.vertices.size());
+    edgeIndex.reserve(mesh.halfEdges.size());
+
+    arrays.positions.resize(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+        arrays.positions[v] = mesh.vertices[v]->position;
+        vertexIndex[mesh.vertices[v].get()] = (int)v;
+    }
+
+    arrays.faceEdge.resize(mesh.faces.size());
+    arrays.next.resize(mesh.halfEdges.size());
+    arrays.origin.resize(mesh.halfEdges.size());
+    arrays.face.resize(mesh.halfEdges.size());
+    int count = 0;
+    for (size_t f = 0; f < mesh.faces.size(); ++f) {
+        int first = count;
+        arrays.faceEdge[f] = first;
+        const HalfEdge* start = mesh.faces[f]->edge;
+        const HalfEdge* e = start;
+        do {
+            edgeIndex[e] = count;
+            arrays.origin[count] = vertexIndex[e->origin];
+            arrays.face[count] = (int)f;
+            arrays.next[count] = count + 1;
+            count++;
+            e = e->next;
+        } while (e != start);
+        arrays.next[count - 1] = first;
+    }
+    arrays.next.resize(count);
+    arrays.origin.resize(count);
+    arrays.face.resize(count);
+
+    arrays.twin.resize(count);
+    for (const auto& f : mesh.faces) {
+        const HalfEdge* start = f->edge;
+        const HalfEdge* e = start;
+        do {
+            auto twin = e->twin ? edgeIndex.find(e->twin) : edgeIndex.end();
+            arrays.twin[edgeIndex[e]] = twin != edgeIndex.end() ? twin->second : -1;
+            e = e->next;
+        } while (e != start);
+    }
+
+    arrays.vertexEdge.resize(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+        const HalfEdge* outgoing = mesh.vertices[v]->outgoing;
+        auto it = outgoing ? edgeIndex.find(outgoing) : edgeIndex.end();
+        arrays.vertexEdge[v] = it != edgeIndex.end() ? it->second : -1;
+    }
+}
+
+void ArraysToMesh(const MeshArrays& arrays, HalfEdgeMesh& mesh) {
+    TRACE_SCOPE("Arrays To Mesh");
+    //One block per kind of element, a million faces would otherwise be millions of allocations
+    ElementPool<Vertex> vertexPool;
+    ElementPool<HalfEdge> halfEdgePool;
+    ElementPool<Face> facePool;
+    Vertex* vertexBlock = vertexPool.Allocate(arrays.positions.size());
+    HalfEdge* halfEdgeBlock = halfEdgePool.Allocate(arrays.next.size());
+    Face* faceBlock = facePool.Allocate(arrays.faceEdge.size());
+    std::vector<ElementPtr<Vertex>> vertices(arrays.positions.size());
+    std::vector<ElementPtr<HalfEdge>> halfEdges(arrays.next.size());
+    std::vector<ElementPtr<Face>> faces(arrays.faceEdge.size());
+    //links go straight to the blocks, element i of every kind is block + i
+    ParallelFor(vertices.size(), [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            Vertex* vertex = vertexBlock + v;
+            vertex->position = arrays.positions[v];
+            int e = arrays.vertexEdge[v];
+            vertex->outgoing = e < 0 ? nullptr : halfEdgeBlock + e;
+            vertices[v].reset(vertex);
+        }
+    });
+    ParallelFor(halfEdges.size(), [&](size_t begin, size_t end) {
+        for (size_t h = begin; h < end; ++h) {
+            HalfEdge* e = halfEdgeBlock + h;
+            e->origin = vertexBlock + arrays.origin[h];
+            e->next = halfEdgeBlock + arrays.next[h];
+            e->twin = arrays.twin[h] < 0 ? nullptr : halfEdgeBlock + arrays.twin[h];
+            e->face = faceBlock + arrays.face[h];
+            halfEdges[h].reset(e);
+        }
+    });
+    ParallelFor(faces.size(), [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            faceBlock[f].edge = halfEdgeBlock + arrays.faceEdge[f];
+            faces[f].reset(faceBlock + f);
+        }
+    });
+
+    //Filling the edge map costs more than the rest of the write, it waits until addFace needs it
+    mesh.edgeMap = {};
+    mesh.edgeMapDirty = true;
+    mesh.vertices = std::move(vertices);
+    mesh.halfEdges = std::move(halfEdges);
+    mesh.faces = std::move(faces);
+    mesh.vertexPool = std::move(vertexPool);
+    mesh.halfEdgePool = std::move(halfEdgePool);
+    mesh.facePool = std::move(facePool);
+    mesh.boundsDirty = true;
+}
+
+void PolygonsToArrays(std::vector<glm::vec3> positions, const std::vector<uint32_t>& faceStart,
+    const std::vector<uint32_t>& corners, MeshArrays& arrays) {
+    TRACE_SCOPE("Polygons To Arrays");
+    size_t vertexCount = positions.size();
+    size_t faceCount = faceStart.empty() ? 0 : faceStart.size() - 1;
+    size_t cornerCount = corners.size();
+    arrays.positions = std::move(positions);
+    arrays.faceEdge.resize(faceCount);
+    arrays.next.resize(cornerCount);
+    arrays.origin.resize(cornerCount);
+    arrays.face.resize(cornerCount);
+    ParallelFor(faceCount, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            uint32_t first = faceStart[f], last = faceStart[f + 1];
+            arrays.faceEdge[f] = (int)first;
+            for (uint32_t c = first; c < last; ++c) {
+                arrays.next[c] = (int)(c + 1 < last ? c + 1 : first);
+                arrays.origin[c] = (int)corners[c];
+                arrays.face[c] = (int)f;
+            }
+        }
+    });
+
+    //Edges are bucketed by their lower vertex, which only holds a handful of them, and matched inside the bucket
+    auto lower = [&](size_t c) {
+        return std::min(corners[c], corners[arrays.next[c]]);
+    };
+    auto upper = [&](size_t c) {
+        return std::max(corners[c], corners[arrays.next[c]]);
+    };
+    std::unique_ptr<std::atomic<uint32_t>[]> cursor(new std::atomic<uint32_t>[vertexCount]);
+    ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v)
+            cursor[v].store(0, std::memory_order_relaxed);
+    });
+    ParallelFor(cornerCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+            cursor[lower(c)].fetch_add(1, std::memory_order_relaxed);
+    });
+    std::vector<uint32_t> bucketStart(vertexCount + 1);
+    bucketStart[0] = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        bucketStart[v + 1] = bucketStart[v] + cursor[v].load(std::memory_order_relaxed);
+        cursor[v].store(bucketStart[v], std::memory_order_relaxed);
+    }
+    std::vector<uint32_t> buckets(cornerCount);
+    ParallelFor(cornerCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+            buckets[cursor[lower(c)].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)c;
+    });
+    arrays.twin.resize(cornerCount);
+    ParallelFor(cornerCount, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            uint32_t low = lower(c), high = upper(c);
+            int match = -1, uses = 0;
+            for (uint32_t i = bucketStart[low]; i < bucketStart[low + 1]; ++i) {
+                uint32_t other = buckets[i];
+                if (upper(other) != high)
+                    continue;
+                uses++;
+                if (other != c)
+                    match = (int)other;
+            }
+            arrays.twin[c] = uses == 2 && corners[match] != corners[c] ? match : -1;
+        }
+    });
+
+    arrays.vertexEdge.assign(vertexCount, -1);
+    for (size_t c = 0; c < cornerCount; ++c) {
+        if (arrays.vertexEdge[corners[c]] < 0)
+            arrays.vertexEdge[corners[c]] = (int)c;
+    }
+}
+
+void RepeatArrays(const MeshArrays& source, const std::vector<glm::mat4>& transforms, MeshArrays& result) {
+    TRACE_SCOPE("Repeat Arrays");
+    size_t copies = transforms.size();
+    size_t vertexCount = source.positions.size();
+    size_t faceCount = source.faceEdge.size();
+    size_t edgeCount = source.next.size();
+    result.positions.resize(vertexCount * copies);
+    result.vertexEdge.resize(vertexCount * copies);
+    result.faceEdge.resize(faceCount * copies);
+    result.next.resize(edgeCount * copies);
+    result.twin.resize(edgeCount * copies);
+    result.origin.resize(edgeCount * copies);
+    result.face.resize(edgeCount * copies);
+
+    //Reversing a loop in place: h runs from the end of its old self to its start, so it takes its successor's
+    //origin and its predecessor as next. Twins keep pairing up since both halves turn around.
+    std::vector<int> prev;
+    std::vector<char> mirrored(copies);
+    for (size_t c = 0; c < copies; ++c)
+        mirrored[c] = glm::determinant(glm::mat3(transforms[c])) < 0.0f;
+    if (std::find(mirrored.begin(), mirrored.end(), 1) != mirrored.end()) {
+        prev.resize(edgeCount);
+        for (size_t h = 0; h < edgeCount; ++h)
+            prev[source.next[h]] = (int)h;
+    }
+
+    //Every copy is a block of the same size, so each element is written from its source element alone
+    ParallelFor(copies * vertexCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t c = i / vertexCount, v = i % vertexCount;
+            int edgeBase = (int)(c * edgeCount);
+            result.positions[i] = glm::vec3(transforms[c] * glm::vec4(source.positions[v], 1.0f));
+            int e = source.vertexEdge[v];
+            result.vertexEdge[i] = e < 0 ? -1 : edgeBase + (mirrored[c] ? prev[e] : e);
+        }
+    });
+    ParallelFor(copies * faceCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            result.faceEdge[i] = (int)((i / faceCount) * edgeCount) + source.faceEdge[i % faceCount];
+    });
+    ParallelFor(copies * edgeCount, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t c = i / edgeCount, h = i % edgeCount;
+            int edgeBase = (int)(c * edgeCount), vertexBase = (int)(c * vertexCount), faceBase = (int)(c * faceCount);
+            result.next[i] = edgeBase + (mirrored[c] ? prev[h] : source.next[h]);
+            result.origin[i] = vertexBase + source.origin[mirrored[c] ? source.next[h] : h];
+            result.twin[i] = source.twin[h] < 0 ? -1 : edgeBase + source.twin[h];
+            result.face[i] = faceBase + source.face[h];
+        }
+    });
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+
+/// <summary>
+/// Index based copy of the half edge topology, -1 stands for a missing element. Passes that rebuild the whole mesh
+/// work on this form so they can size and fill plain arrays in parallel instead of going through addFace.
+/// Faces are stored by one of their edges, the edges of a face don't have to be contiguous.
+/// </summary>
+struct MeshArrays {
+    std::vector<glm::vec3> positions;
+    /// <summary>
+    /// An outgoing half edge of every vertex, -1 for vertices without faces
+    /// </summary>
+    std::vector<int> vertexEdge;
+    std::vector<int> faceEdge;
+    std::vector<int> next, twin, origin, face;
+};
+
+/// <summary>
+/// Copies the mesh into index form, elements keep their order. Half edges are numbered face by face, in loop order.
+/// </summary>
+void MeshToArrays(const HalfEdgeMesh& mesh, MeshArrays& arrays);
+
+/// <summary>
+/// Replaces the mesh's elements with the arrays, elements are allocated and linked in parallel.
+/// The edge map is left to be rebuilt by the next addFace, any pointers into the mesh are invalidated.
+/// </summary>
+void ArraysToMesh(const MeshArrays& arrays, HalfEdgeMesh& mesh);
+
+/// <summary>
+/// Builds the arrays from faces given as corner lists, face f has the corners faceStart[f] to faceStart[f + 1]
+/// and half edge c leaves corner c. Twins are linked where exactly two faces use an edge in opposite directions.
+/// </summary>
+void PolygonsToArrays(std::vector<glm::vec3> positions, const std::vector<uint32_t>& faceStart,
+    const std::vector<uint32_t>& corners, MeshArrays& arrays);
+
+/// <summary>
+/// Fills result with one copy of source per transform, in order and all in one pass. Copies whose transform mirrors
+/// (negative determinant) have their winding reversed so they still face outwards. The copies share no vertices.
+/// </summary>
+void RepeatArrays(const MeshArrays& source, const std::vector<glm::mat4>& transforms, MeshArrays& result);
\ No newline at end of file
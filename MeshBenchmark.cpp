@@ -0,0 +1,474 @@
+#include "HalfEdgeMesh.h"
+#include "Primitives.h"
+#include "Subdivision.h"
+#include "MeshOrient.h"
+#include "MeshDecimate.h"
+#include "MeshWeld.h"
+#include "MeshBoolean.h"
+#include "ModifierStack.h"
+#include "BVH.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+
+/*
+ * Times the GL-free mesh kernel on flat quad grids of increasing size.
+ * Usage: MeshBenchmark [--min-faces N] [--max-faces N] [--rays N] [--min-time seconds]
+ * Every case reports the time per run, its throughput and the peak heap it allocated on top of what was live before it.
+ */
+
+namespace {
+    // Heap accounting through the global allocation functions. Every block carries its size in front of it.
+    const size_t HEADER_SIZE = alignof(std::max_align_t);
+    std::atomic<size_t> liveBytes{ 0 };
+    std::atomic<size_t> peakBytes{ 0 };
+
+    void* CountedAlloc(size_t size) {
+        void* block = std::malloc(size + HEADER_SIZE);
+        if (!block)
+            return nullptr;
+        *static_cast<size_t*>(block) = size;
+        size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        return static_cast<char*>(block) + HEADER_SIZE;
+    }
+
+    void CountedFree(void* p) {
+        if (!p)
+            return;
+        void* block = static_cast<char*>(p) - HEADER_SIZE;
+        liveBytes.fetch_sub(*static_cast<size_t*>(block), std::memory_order_relaxed);
+        std::free(block);
+    }
+}
+
+void* operator new(size_t size) {
+    if (void* p = CountedAlloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchmarkOptions {
+        size_t minFaces = 1000;
+        /// <summary>
+        /// 10M faces needs several gigabytes for the half edges and edge map, so it has to be asked for
+        /// </summary>
+        size_t maxFaces = 1000000;
+        int rays = 32;
+        /// <summary>
+        /// Cases are repeated until they've run this long, big meshes only run once
+        /// </summary>
+        double minTime = 0.25;
+    };
+
+    struct CaseResult {
+        double secondsPerRun = 0.0;
+        int runs = 0;
+        size_t peakHeap = 0;
+    };
+
+    /// <summary>
+    /// Runs setup then body until minTime has passed. Only body is timed,
+    /// the peak heap is measured from what was live after setup.
+    /// </summary>
+    CaseResult RunCase(double minTime, const std::function<void()>& setup, const std::function<void()>& body) {
+        CaseResult result;
+        double total = 0.0;
+        do {
+            setup();
+            size_t before = liveBytes.load(std::memory_order_relaxed);
+            peakBytes.store(before, std::memory_order_relaxed);
+            auto start = Clock::now();
+            body();
+            total += std::chrono::duration<double>(Clock::now() - start).count();
+            result.peakHeap = std::max(result.peakHeap, peakBytes.load(std::memory_order_relaxed) - before);
+            result.runs++;
+        } while (total < minTime);
+        result.secondsPerRun = total / result.runs;
+        return result;
+    }
+
+    void PrintResult(const char* name, size_t faces, const CaseResult& result, double items, const char* unit) {
+        std::printf("%-22s %10zu %12.3f %8d %14.2f %-12s %10.1f\n",
+            name, faces, result.secondsPerRun * 1000.0, result.runs,
+            items / result.secondsPerRun / 1e6, unit, result.peakHeap / (1024.0 * 1024.0));
+    }
+
+    bool ParseSize(const char* text, size_t& out) {
+        char* end = nullptr;
+        double value = std::strtod(text, &end);
+        if (end == text || value < 1.0)
+            return false;
+        out = (size_t)value;
+        return true;
+    }
+
+    bool ParseOptions(int argc, char** argv, BenchmarkOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--min-faces" && hasValue) {
+                if (!ParseSize(argv[++i], options.minFaces)) return false;
+            }
+            else if (arg == "--max-faces" && hasValue) {
+                if (!ParseSize(argv[++i], options.maxFaces)) return false;
+            }
+            else if (arg == "--rays" && hasValue) {
+                options.rays = std::atoi(argv[++i]);
+                if (options.rays < 1) return false;
+            }
+            else if (arg == "--min-time" && hasValue) {
+                options.minTime = std::atof(argv[++i]);
+            }
+            else {
+                return false;
+            }
+        }
+        return options.minFaces <= options.maxFaces;
+    }
+
+    /// <summary>
+    /// Copies every face of source with its own vertices, the way triangle soup files come in
+    /// </summary>
+    void BuildSoup(const HalfEdgeMesh& source, HalfEdgeMesh& soup) {
+        std::vector<Vertex*> corners;
+        for (const auto& face : source.faces) {
+            corners.clear();
+            const HalfEdge* e = face->edge;
+            do {
+                corners.push_back(soup.addVertex(e->origin->position));
+                e = e->next;
+            } while (e != face->edge);
+            soup.addFace(corners);
+        }
+    }
+
+    /// <summary>
+    /// Volume enclosed by a closed mesh, negative when it is wound inside out
+    /// </summary>
+    double SignedVolume(const HalfEdgeMesh& mesh) {
+        double volume = 0.0;
+        for (const auto& face : mesh.faces) {
+            const HalfEdge* first = face->edge;
+            for (const HalfEdge* e = first->next; e->next != first; e = e->next)
+                volume += glm::dot(first->origin->position, glm::cross(e->origin->position, e->next->origin->position)) / 6.0;
+        }
+        return volume;
+    }
+
+    void BenchmarkGrid(int segments, const BenchmarkOptions& options) {
+        size_t faceCount = (size_t)segments * segments;
+        const float size = 10.0f;
+
+        std::unique_ptr<HalfEdgeMesh> built;
+        CaseResult build = RunCase(options.minTime,
+            [&] { built.reset(); },
+            [&] {
+                built = std::make_unique<HalfEdgeMesh>();
+                BuildGrid(*built, segments, segments, size);
+            });
+        PrintResult("addFace build", faceCount, build, (double)faceCount, "Mfaces/s");
+        HalfEdgeMesh& mesh = *built;
+
+        std::unique_ptr<HalfEdgeMesh> copy;
+        CaseResult clone = RunCase(options.minTime,
+            [&] { copy.reset(); },
+            [&] {
+                copy = std::make_unique<HalfEdgeMesh>();
+                mesh.CloneInto(*copy);
+            });
+        PrintResult("Clone", faceCount, clone, (double)faceCount, "Mfaces/s");
+        copy.reset();
+
+        std::vector<glm::vec3> positions, normals;
+        std::vector<unsigned int> indices, edgeIndices;
+        auto clearBuffers = [&] {
+            positions = {};
+            normals = {};
+            indices = {};
+            edgeIndices = {};
+        };
+        for (bool flat : { true, false }) {
+            mesh.flatShading = flat;
+            CaseResult triangulate = RunCase(options.minTime, clearBuffers,
+                [&] { HalfEdgeMesh::MeshToTriangles(mesh, positions, normals, indices, edgeIndices); });
+            PrintResult(flat ? "MeshToTriangles flat" : "MeshToTriangles smooth", faceCount, triangulate, (double)faceCount, "Mfaces/s");
+        }
+
+        CaseResult computeNormals = RunCase(options.minTime, [] {},
+            [&] { HalfEdgeMesh::ComputeNormals(mesh); });
+        PrintResult("ComputeNormals", faceCount, computeNormals, (double)faceCount, "Mfaces/s");
+
+        CaseResult subdivide = RunCase(options.minTime,
+            [&] {
+                copy = std::make_unique<HalfEdgeMesh>();
+                mesh.CloneInto(*copy);
+            },
+            [&] { SubdivideCatmullClark(*copy, 1, false); });
+        PrintResult("Subdivide", faceCount, subdivide, (double)faceCount, "Mfaces/s");
+        //Two levels write sixteen faces per quad, the second level does most of the work
+        CaseResult subdivideTwice = RunCase(options.minTime,
+            [&] {
+                copy = std::make_unique<HalfEdgeMesh>();
+                mesh.CloneInto(*copy);
+            },
+            [&] { SubdivideCatmullClark(*copy, 2, false); });
+        PrintResult("Subdivide x2", faceCount, subdivideTwice, (double)copy->faces.size(), "Mfaces/s");
+        copy.reset();
+
+        //Down to a tenth of the triangles, the flat grid makes every collapse free so this is the bookkeeping alone
+        DecimateOptions decimateOptions;
+        decimateOptions.ratio = 0.1f;
+        CaseResult decimate = RunCase(options.minTime,
+            [&] {
+                copy = std::make_unique<HalfEdgeMesh>();
+                mesh.CloneInto(*copy);
+            },
+            [&] { DecimateMesh(*copy, decimateOptions); });
+        PrintResult("Decimate 10%", faceCount, decimate, (double)faceCount, "Mfaces/s");
+        copy.reset();
+
+        //Four vertices per face welded back into the grid, throughput counts the soup's vertices
+        CaseResult weld = RunCase(options.minTime,
+            [&] {
+                copy = std::make_unique<HalfEdgeMesh>();
+                BuildSoup(mesh, *copy);
+            },
+            [&] { MergeByDistance(*copy, 1e-4f); });
+        PrintResult("Merge by distance", faceCount, weld, 4.0 * faceCount, "Mverts/s");
+        copy.reset();
+
+        //Booleans need closed operands, so a creased cube subdivided to about the grid's face count and flattened into
+        //a panel stands in for it, with a cylinder drilled through. Past a million faces the panel alone dominates
+        if (faceCount <= 1000000) {
+            HalfEdgeMesh panel, cutter;
+            BuildCube(panel, size);
+            int levels = std::max(1, (int)std::lround(std::log((double)faceCount / 6.0) / std::log(4.0)));
+            SubdivideCatmullClark(panel, levels, true);
+            for (auto& vertex : panel.vertices)
+                vertex->position *= glm::vec3(1.0f, 0.05f, 1.0f);
+            BuildCylinder(cutter, 64, size * 0.1f, size);
+            MeshArrays result;
+            CaseResult boolean = RunCase(options.minTime, [&] { result = MeshArrays(); },
+                [&] { MeshBoolean(panel, cutter, glm::mat4(1.0f), BooleanOperation::Difference, result); });
+            PrintResult("Boolean difference", panel.faces.size(), boolean, (double)panel.faces.size(), "Mfaces/s");
+        }
+
+        //Weld, subdivide and solidify on top of the grid, then only the last one again the way an edit to it reevaluates
+        ModifierStack stack;
+        for (ModifierType type : { ModifierType::Weld, ModifierType::Subdivision, ModifierType::Solidify }) {
+            stack.modifiers.emplace_back();
+            stack.modifiers.back().type = type;
+            stack.Changed(stack.modifiers.size() - 1);
+        }
+        auto base = std::make_shared<MeshArrays>();
+        MeshToArrays(mesh, *base);
+        stack.SetBase(base);
+        CaseResult stackFull = RunCase(options.minTime, [&] { stack.results.clear(); },
+            [&] { stack.Store(0, EvaluateModifiers(stack.base, stack.modifiers, 0, stack.baseVersion)); });
+        PrintResult("Modifier stack", faceCount, stackFull, (double)faceCount, "Mfaces/s");
+        size_t last = stack.modifiers.size() - 1;
+        CaseResult stackLast = RunCase(options.minTime, [&] { stack.Changed(last); },
+            [&] { stack.Store(last, EvaluateModifiers(stack.Input(last), stack.modifiers, last, stack.baseVersion)); });
+        PrintResult("Modifier stack last", faceCount, stackLast, (double)faceCount, "Mfaces/s");
+        stack = ModifierStack();
+
+        //What applying an array costs, drawing it as instances copies nothing
+        Modifier array;
+        array.type = ModifierType::Array;
+        array.count = 8;
+        array.offset = glm::vec3(size, 0.0f, 0.0f);
+        std::shared_ptr<const MeshArrays> repeated;
+        CaseResult arrayApply = RunCase(options.minTime, [&] { repeated.reset(); },
+            [&] { repeated = ApplyModifier(array, base); });
+        PrintResult("Array apply", faceCount, arrayApply, (double)faceCount * array.count, "Mfaces/s");
+
+        //Mirrored across the grid's edge, so one row of vertices is welded along the seam
+        Modifier mirror;
+        mirror.type = ModifierType::Mirror;
+        mirror.mirrorCenter = glm::vec3(size * 0.5f, 0.0f, 0.0f);
+        CaseResult mirrorApply = RunCase(options.minTime, [&] { repeated.reset(); },
+            [&] { repeated = ApplyModifier(mirror, base); });
+        PrintResult("Mirror apply", faceCount, mirrorApply, (double)faceCount * 2, "Mfaces/s");
+
+        //Flipping twice leaves the grid as it was, so every run starts from the same winding
+        CaseResult flip = RunCase(options.minTime, [] {}, [&] { mesh.FlipFaces(); });
+        PrintResult("FlipFaces", faceCount, flip, (double)faceCount, "Mfaces/s");
+
+        //Already consistent, so this is the full search with nothing to flip at the end
+        CaseResult orient = RunCase(options.minTime, [] {}, [&] { RecalculateNormalsOutside(mesh); });
+        PrintResult("RecalculateOutside", faceCount, orient, (double)faceCount, "Mfaces/s");
+
+        //A subdivided cone bends its quads, every run turns it inside out first and it has to come back outwards.
+        //It grows by levels, 128 faces after the first and four times as many per level after that.
+        HalfEdgeMesh closed;
+        int levels = 1;
+        while ((size_t)128 << (2 * levels) <= faceCount)
+            levels++;
+        BuildCone(closed, 32, size * 0.5f, size);
+        SubdivideCatmullClark(closed, levels, false);
+        CaseResult orientClosed = RunCase(options.minTime, [&] { closed.FlipFaces(); },
+            [&] { RecalculateNormalsOutside(closed); });
+        PrintResult("Outside subdivided", closed.faces.size(), orientClosed, (double)closed.faces.size(), "Mfaces/s");
+        if (SignedVolume(closed) <= 0.0)
+            std::printf("  warning: RecalculateOutside left the subdivided cone inside out\n");
+
+        //The preview path: stencils once per topology, then only evaluation per edit
+        SubdivisionSurface surface;
+        CaseResult surfaceBuild = RunCase(options.minTime, [&] { surface = SubdivisionSurface(); },
+            [&] { BuildSubdivisionSurface(mesh, 1, false, surface); });
+        PrintResult("Surface build", faceCount, surfaceBuild, (double)faceCount, "Mfaces/s");
+        std::vector<glm::vec3> refined;
+        CaseResult surfaceEvaluate = RunCase(options.minTime, [] {},
+            [&] { EvaluateSubdivisionSurface(surface, mesh, refined); });
+        PrintResult("Surface evaluate", faceCount, surfaceEvaluate, (double)faceCount, "Mfaces/s");
+
+        //Straight down onto the grid, spread over it so every ray hits
+        std::vector<glm::vec3> origins(options.rays);
+        for (int i = 0; i < options.rays; ++i) {
+            float u = (i + 0.5f) / options.rays;
+            origins[i] = glm::vec3((u - 0.5f) * size * 0.9f, (std::fmod(u * 7.0f, 1.0f) - 0.5f) * size * 0.9f, 5.0f);
+        }
+        const glm::vec3 down(0.0f, 0.0f, -1.0f);
+        int hits = 0;
+        CaseResult raycast = RunCase(options.minTime, [&] { hits = 0; },
+            [&] {
+                for (const auto& origin : origins) {
+                    float t;
+                    Face* face;
+                    hits += mesh.Raycast(origin, down, t, face);
+                }
+            });
+        //every ray tests every face
+        PrintResult("Raycast", faceCount, raycast, (double)options.rays * faceCount, "Mfaces/s");
+        if (hits != options.rays)
+            std::printf("  warning: %d of %d rays hit\n", hits, options.rays);
+
+        //Bare intersection test over the triangle soup, no half edge walking
+        size_t triangleCount = indices.size() / 3;
+        float sink = 0.0f;
+        CaseResult rayTriangle = RunCase(options.minTime, [] {},
+            [&] {
+                const glm::vec3& origin = origins[0];
+                for (size_t t = 0; t < triangleCount; ++t) {
+                    float hitT;
+                    if (HalfEdgeMesh::RayTriangle(origin, down, positions[indices[3 * t]], positions[indices[3 * t + 1]], positions[indices[3 * t + 2]], hitT))
+                        sink += hitT;
+                }
+            });
+        PrintResult("RayTriangle", faceCount, rayTriangle, (double)triangleCount, "Mtris/s");
+        if (sink <= 0.0f)
+            std::printf("  warning: RayTriangle missed the grid\n");
+    }
+    /// <summary>
+    /// Box select over a scene of objects the way the viewport does it: the scene BVH is brought up to date, then
+    /// objects inside the box are taken whole and the ones straddling its edge are tested triangle by triangle
+    /// </summary>
+    void BenchmarkBoxSelect(int objectCount, const BenchmarkOptions& options) {
+        //One cube shared by every object, 3 apart on a grid twice as wide as it is deep
+        HalfEdgeMesh cube;
+        BuildCube(cube, 1.0f);
+        AABB localBounds = cube.ComputeLocalBounds();
+        int columns = (int)std::ceil(std::sqrt(objectCount * 2.0));
+        std::vector<glm::mat4> models(objectCount);
+        std::vector<AABB> worldBounds(objectCount);
+        for (int i = 0; i < objectCount; ++i) {
+            glm::vec3 position(((i % columns) - columns * 0.5f) * 3.0f, 0.0f, ((i / columns) - objectCount / columns * 0.5f) * 3.0f);
+            models[i] = glm::translate(glm::mat4(1.0f), position);
+            worldBounds[i] = { localBounds.min + position, localBounds.max + position };
+        }
+
+        //Looking down at the middle of the grid, the box covers the middle quarter of the screen
+        float extent = columns * 3.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent * 4.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, extent * 0.4f, extent * 0.2f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum box = Frustum::FromMatrix(projection * view, glm::vec2(-0.5f), glm::vec2(0.5f));
+
+        BVH bvh;
+        std::vector<AABB> bounds;
+        CaseResult build = RunCase(options.minTime, [&] { bvh.Clear(); }, [&] { bvh.Build(worldBounds); });
+        PrintResult("Scene BVH build", objectCount, build, (double)objectCount, "Mobjects/s");
+        CaseResult refit = RunCase(options.minTime, [] {}, [&] { bvh.Refit(worldBounds); });
+        PrintResult("Scene BVH refit", objectCount, refit, (double)objectCount, "Mobjects/s");
+
+        bounds = worldBounds;
+        size_t selected = 0;
+        CaseResult select = RunCase(options.minTime, [&] { selected = 0; },
+            [&] {
+                //nothing moved, the bounds are only compared
+                size_t moved = 0;
+                for (int i = 0; i < objectCount; ++i)
+                    moved += !(worldBounds[i].min == bounds[i].min && worldBounds[i].max == bounds[i].max);
+                if (moved > 0)
+                    bvh.Refit(bounds);
+                bvh.QueryFrustum(box, bounds, [&](uint32_t index, Containment containment) {
+                    if (containment == Containment::Inside) {
+                        selected++;
+                        return;
+                    }
+                    Frustum local = box.ToLocalSpace(models[index]);
+                    for (const auto& f : cube.faces) {
+                        const HalfEdge* start = f->edge;
+                        for (const HalfEdge* e = start->next; e->next != start; e = e->next) {
+                            if (local.IntersectsTriangle(start->origin->position, e->origin->position, e->next->origin->position)) {
+                                selected++;
+                                return;
+                            }
+                        }
+                    }
+                });
+            });
+        PrintResult("Box select", objectCount, select, (double)objectCount, "Mobjects/s");
+        if (selected == 0)
+            std::printf("  warning: the box selected nothing\n");
+        if (select.secondsPerRun > 1.0 / 60.0)
+            std::printf("  warning: box select took longer than a 60 Hz frame\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--min-faces N] [--max-faces N] [--rays N] [--min-time seconds]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-22s %10s %12s %8s %14s %-12s %10s\n", "case", "faces", "ms/run", "runs", "throughput", "", "peak MiB");
+    //Decades of quads from minFaces up, 1k 10k 100k 1M 10M by default limits
+    for (double target = 1000.0; target <= options.maxFaces * 1.01; target *= 10.0) {
+        if (target < options.minFaces * 0.99)
+            continue;
+        int segments = (int)std::ceil(std::sqrt(target));
+        BenchmarkGrid(segments, options);
+    }
+    BenchmarkBoxSelect(20000, options);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,1277 @@
+#include "MeshBoolean.h"
+#include "BVH.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <glm/gtc/type_precision.hpp>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    using Int3 = glm::i64vec3;
+
+    /// <summary>
+    /// Grid units added around every triangle box, so float traversal never misses a triangle the exact tests would hit
+    /// </summary>
+    const float BOX_PADDING = 2.0f;
+    /// <summary>
+    /// Far end of the winding rays relative to the vertex tested. It leaves the grid along x and the uneven components
+    /// keep the ray from running parallel to grid aligned edges.
+    /// </summary>
+    const Int3 RAY_OFFSET(((int64_t)1 << (BOOLEAN_GRID_BITS + 1)) + 17, ((int64_t)1 << BOOLEAN_GRID_BITS) + 7,
+        ((int64_t)1 << (BOOLEAN_GRID_BITS - 1)) + 3);
+
+    Int3 Cross(const Int3& a, const Int3& b) {
+        return Int3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    /// <summary>
+    /// Sign of a . b without overflowing, for components of a below 2^23 and of b below 2^47. b is split into 24 bit
+    /// halves so every product fits and the carry of the low sum is moved up before the sign is read.
+    /// </summary>
+    int DotSign(const Int3& a, const Int3& b) {
+        const int SHIFT = 24;
+        const int64_t MASK = ((int64_t)1 << SHIFT) - 1;
+        int64_t high = 0, low = 0;
+        for (int i = 0; i < 3; ++i) {
+            int64_t bLow = b[i] & MASK;
+            high += a[i] * ((b[i] - bLow) >> SHIFT);
+            low += a[i] * bLow;
+        }
+        int64_t lowLow = low & MASK;
+        high += (low - lowLow) >> SHIFT;
+        if (high != 0)
+            return high > 0 ? 1 : -1;
+        return lowLow > 0 ? 1 : 0;
+    }
+
+    /// <summary>
+    /// A snapped position, moved marks the points of b which count as shifted by (e, e^2, e^3) for an infinitely small e
+    /// </summary>
+    struct GridPoint {
+        Int3 p;
+        bool moved;
+    };
+
+    /// <summary>
+    /// Sign of the volume of a, b, c, d: positive when d is in front of the counter clockwise triangle a, b, c.
+    /// Exact, and only 0 when the points are degenerate on their own: moving b's points by (e, e^2, e^3) adds
+    /// e . g to the volume, g being the sum of the volume's gradients at the moved points, so a zero volume takes
+    /// the sign of the first non zero component of g.
+    /// </summary>
+    int Orient(const GridPoint& a, const GridPoint& b, const GridPoint& c, const GridPoint& d) {
+        Int3 u = b.p - a.p, v = c.p - a.p, w = d.p - a.p;
+        int sign = DotSign(w, Cross(u, v));
+        if (sign != 0 || (a.moved == b.moved && b.moved == c.moved && c.moved == d.moved))
+            return sign;
+        Int3 vw = Cross(v, w), wu = Cross(w, u), uv = Cross(u, v);
+        Int3 gradient(0);
+        if (a.moved) gradient -= vw + wu + uv;
+        if (b.moved) gradient += vw;
+        if (c.moved) gradient += wu;
+        if (d.moved) gradient += uv;
+        for (int i = 0; i < 3; ++i) {
+            if (gradient[i] != 0)
+                return gradient[i] > 0 ? 1 : -1;
+        }
+        return 0;
+    }
+
+    /// <summary>
+    /// Whether the segment p, q passes through the triangle, for p and q on opposite sides of its plane
+    /// </summary>
+    bool SegmentCrossesTriangle(const GridPoint& p, const GridPoint& q, const GridPoint& t0, const GridPoint& t1, const GridPoint& t2) {
+        int s0 = Orient(p, q, t0, t1);
+        return s0 != 0 && Orient(p, q, t1, t2) == s0 && Orient(p, q, t2, t0) == s0;
+    }
+
+    //Exact 2D orientation on doubles with expansion arithmetic (Shewchuk), used to shape the retriangulated faces
+
+    void TwoSum(double a, double b, double& sum, double& error) {
+        sum = a + b;
+        double bVirtual = sum - a;
+        double aVirtual = sum - bVirtual;
+        error = (a - aVirtual) + (b - bVirtual);
+    }
+
+    /// <summary>
+    /// Adds b to the non overlapping expansion e of length count in place, returns the new length
+    /// </summary>
+    int GrowExpansion(double* e, int count, double b) {
+        double q = b;
+        for (int i = 0; i < count; ++i) {
+            double sum, error;
+            TwoSum(q, e[i], sum, error);
+            e[i] = error;
+            q = sum;
+        }
+        e[count] = q;
+        return count + 1;
+    }
+
+    /// <summary>
+    /// Sign of the signed area of a, b, c, positive when counter clockwise. Exact for any doubles.
+    /// </summary>
+    int Orient2D(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c) {
+        double left = (a.x - c.x) * (b.y - c.y);
+        double right = (a.y - c.y) * (b.x - c.x);
+        double det = left - right;
+        const double epsilon = std::numeric_limits<double>::epsilon() * 0.5;
+        double bound = (3.0 + 16.0 * epsilon) * epsilon * (std::abs(left) + std::abs(right));
+        if (det > bound) return 1;
+        if (-det > bound) return -1;
+
+        //ax*by - ax*cy - cx*by - ay*bx + ay*cx + cy*bx, every product split exactly into two doubles
+        const double terms[6][2] = {
+            { a.x, b.y }, { -a.x, c.y }, { -c.x, b.y }, { -a.y, b.x }, { a.y, c.x }, { c.y, b.x } };
+        double expansion[13];
+        int count = 0;
+        for (const auto& term : terms) {
+            double product = term[0] * term[1];
+            count = GrowExpansion(expansion, count, std::fma(term[0], term[1], -product));
+            count = GrowExpansion(expansion, count, product);
+        }
+        for (int i = count - 1; i >= 0; --i) {
+            if (expansion[i] != 0.0)
+                return expansion[i] > 0.0 ? 1 : -1;
+        }
+        return 0;
+    }
+
+    /// <summary>
+    /// One side of the operation, fan triangulated over snapped positions
+    /// </summary>
+    struct Operand {
+        /// <summary>
+        /// Positions written to the result, in a's local space
+        /// </summary>
+        std::vector<glm::vec3> positions;
+        std::vector<Int3> grid;
+        /// <summary>
+        /// Face f has the corners faceStart[f] to faceStart[f + 1], fan triangle j of face f is faceStart[f] - 2f + j
+        /// </summary>
+        std::vector<uint32_t> faceStart, corners;
+        std::vector<std::array<uint32_t, 3>> triangles;
+        std::vector<uint32_t> triangleFace;
+        std::vector<AABB> boxes;
+        BVH bvh;
+        bool moved = false;
+        /// <summary>
+        /// Faces turned inwards all over, its inside is in front of them
+        /// </summary>
+        bool inverted = false;
+        /// <summary>
+        /// Where this operand's vertices start in the numbering shared by both operands and the intersection points
+        /// </summary>
+        uint32_t firstVertex = 0;
+
+        GridPoint Point(uint32_t v) const {
+            return { grid[v], moved };
+        }
+
+        glm::dvec3 Normal(uint32_t t) const {
+            glm::dvec3 p0(grid[triangles[t][0]]);
+            return glm::cross(glm::dvec3(grid[triangles[t][1]]) - p0, glm::dvec3(grid[triangles[t][2]]) - p0);
+        }
+    };
+
+    void LoadOperand(const HalfEdgeMesh& mesh, const glm::mat4& transform, Operand& operand) {
+        std::unordered_map<const Vertex*, uint32_t> vertexIndex;
+        vertexIndex.reserve(mesh.vertices.size());
+        operand.positions.resize(mesh.vertices.size());
+        for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+            vertexIndex.emplace(mesh.vertices[v].get(), (uint32_t)v);
+            operand.positions[v] = glm::vec3(transform * glm::vec4(mesh.vertices[v]->position, 1.0f));
+        }
+
+        size_t faceCount = mesh.faces.size();
+        operand.faceStart.assign(faceCount + 1, 0);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                uint32_t count = 0;
+                const HalfEdge* start = mesh.faces[f]->edge;
+                const HalfEdge* e = start;
+                do {
+                    count++;
+                    e = e->next;
+                } while (e != start);
+                operand.faceStart[f + 1] = count;
+            }
+        });
+        for (size_t f = 0; f < faceCount; ++f)
+            operand.faceStart[f + 1] += operand.faceStart[f];
+
+        operand.corners.resize(operand.faceStart[faceCount]);
+        operand.triangles.resize(operand.corners.size() - 2 * faceCount);
+        operand.triangleFace.resize(operand.triangles.size());
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                uint32_t first = operand.faceStart[f], last = operand.faceStart[f + 1];
+                const HalfEdge* e = mesh.faces[f]->edge;
+                for (uint32_t c = first; c < last; ++c, e = e->next)
+                    operand.corners[c] = vertexIndex.find(e->origin)->second;
+                size_t t = first - 2 * f;
+                for (uint32_t c = first + 1; c + 1 < last; ++c, ++t) {
+                    operand.triangles[t] = { operand.corners[first], operand.corners[c], operand.corners[c + 1] };
+                    operand.triangleFace[t] = (uint32_t)f;
+                }
+            }
+        });
+
+        //a mirroring transform turns the faces inwards just like flipped normals do
+        double volume = 0.0;
+        for (const auto& tri : operand.triangles) {
+            glm::dvec3 p0(operand.positions[tri[0]]), p1(operand.positions[tri[1]]), p2(operand.positions[tri[2]]);
+            volume += glm::dot(p0, glm::cross(p1, p2));
+        }
+        operand.inverted = volume < 0.0;
+    }
+
+    /// <summary>
+    /// Snaps both operands onto the shared integer grid and builds their triangle hierarchies
+    /// </summary>
+    void SnapOperands(Operand* operands, glm::dvec3& outCenter, double& outScale) {
+        TRACE_SCOPE("Boolean Snap");
+        AABB bounds;
+        for (int m = 0; m < 2; ++m) {
+            for (const glm::vec3& p : operands[m].positions)
+                bounds.Expand(p);
+        }
+        glm::dvec3 center = glm::dvec3(bounds.Center());
+        glm::dvec3 extents = glm::dvec3(bounds.max) - center;
+        double half = std::max(extents.x, std::max(extents.y, extents.z));
+        double scale = half > 0.0 ? (double)((int64_t)1 << BOOLEAN_GRID_BITS) / half : 1.0;
+        const double limit = (double)((int64_t)1 << BOOLEAN_GRID_BITS);
+        for (int m = 0; m < 2; ++m) {
+            Operand& operand = operands[m];
+            operand.grid.resize(operand.positions.size());
+            ParallelFor(operand.positions.size(), [&](size_t begin, size_t end) {
+                for (size_t v = begin; v < end; ++v) {
+                    glm::dvec3 p = glm::clamp(glm::round((glm::dvec3(operand.positions[v]) - center) * scale), -limit, limit);
+                    operand.grid[v] = Int3(p);
+                }
+            });
+            operand.boxes.resize(operand.triangles.size());
+            ParallelFor(operand.triangles.size(), [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; ++t) {
+                    AABB box;
+                    for (uint32_t v : operand.triangles[t])
+                        box.Expand(glm::vec3(operand.grid[v]));
+                    box.min -= glm::vec3(BOX_PADDING);
+                    box.max += glm::vec3(BOX_PADDING);
+                    operand.boxes[t] = box;
+                }
+            });
+        }
+        //the two hierarchies are independent, build them side by side
+        ParallelFor(2, [&](size_t begin, size_t end) {
+            for (size_t m = begin; m < end; ++m)
+                operands[m].bvh.Build(operands[m].boxes);
+        }, 1);
+        outCenter = center;
+        outScale = scale;
+    }
+
+    /// <summary>
+    /// An intersection point: edge lo, hi of operand mesh crossing triangle of the other operand
+    /// </summary>
+    struct PointKey {
+        uint32_t mesh, lo, hi, triangle;
+
+        bool operator<(const PointKey& o) const {
+            if (mesh != o.mesh) return mesh < o.mesh;
+            if (lo != o.lo) return lo < o.lo;
+            if (hi != o.hi) return hi < o.hi;
+            return triangle < o.triangle;
+        }
+
+        bool operator==(const PointKey& o) const {
+            return mesh == o.mesh && lo == o.lo && hi == o.hi && triangle == o.triangle;
+        }
+    };
+
+    /// <summary>
+    /// Where two triangles cross, triangles[m] is the triangle of operand m
+    /// </summary>
+    struct Segment {
+        PointKey ends[2];
+        uint32_t points[2];
+        uint32_t triangles[2];
+    };
+
+    /// <summary>
+    /// 256 bit two's complement integer, just enough arithmetic to order points along an edge exactly
+    /// </summary>
+    struct Wide {
+        uint32_t limbs[8];
+
+        explicit Wide(int64_t value = 0) {
+            limbs[0] = (uint32_t)(uint64_t)value;
+            limbs[1] = (uint32_t)((uint64_t)value >> 32);
+            for (int i = 2; i < 8; ++i)
+                limbs[i] = value < 0 ? 0xFFFFFFFFu : 0u;
+        }
+
+        Wide operator+(const Wide& o) const {
+            Wide r;
+            uint64_t carry = 0;
+            for (int i = 0; i < 8; ++i) {
+                uint64_t sum = (uint64_t)limbs[i] + o.limbs[i] + carry;
+                r.limbs[i] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+            return r;
+        }
+
+        Wide operator-(const Wide& o) const {
+            Wide negated;
+            for (int i = 0; i < 8; ++i)
+                negated.limbs[i] = ~o.limbs[i];
+            return *this + negated + Wide(1);
+        }
+
+        Wide operator*(const Wide& o) const {
+            Wide r;
+            for (int i = 0; i < 8; ++i) {
+                uint64_t carry = 0;
+                for (int j = 0; i + j < 8; ++j) {
+                    uint64_t product = (uint64_t)limbs[i] * o.limbs[j] + r.limbs[i + j] + carry;
+                    r.limbs[i + j] = (uint32_t)product;
+                    carry = product >> 32;
+                }
+            }
+            return r;
+        }
+
+        int Sign() const {
+            if (limbs[7] & 0x80000000u)
+                return -1;
+            for (uint32_t limb : limbs) {
+                if (limb != 0)
+                    return 1;
+            }
+            return 0;
+        }
+    };
+
+    Wide Dot(const Int3& a, const Int3& b) {
+        return Wide(a.x) * Wide(b.x) + Wide(a.y) * Wide(b.y) + Wide(a.z) * Wide(b.z);
+    }
+
+    /// <summary>
+    /// Whether point a comes before point b going from the lower to the higher vertex of the edge both are on.
+    /// With d(x) the perturbed distance of x to a crossed triangle's plane, a point is at t = d(p) / (d(p) - d(q))
+    /// along p, q and t1 - t2 has the sign of d2(p) d1(q) - d1(p) d2(q) times both denominators, which have the
+    /// signs of p's sides. Both planes move against the edge, so the perturbation's quadratic terms cancel and the
+    /// linear ones settle ties exactly like Orient does.
+    /// </summary>
+    bool PointBefore(const Operand* operands, const PointKey& a, const PointKey& b) {
+        const Operand& edge = operands[a.mesh];
+        const Operand& other = operands[1 - a.mesh];
+        Int3 n[2];
+        Wide dp[2], dq[2];
+        int side = 1;
+        for (int i = 0; i < 2; ++i) {
+            const auto& tri = other.triangles[i ? b.triangle : a.triangle];
+            Int3 t0 = other.grid[tri[0]];
+            n[i] = Cross(other.grid[tri[1]] - t0, other.grid[tri[2]] - t0);
+            dp[i] = Dot(edge.grid[a.lo] - t0, n[i]);
+            dq[i] = Dot(edge.grid[a.hi] - t0, n[i]);
+            side *= Orient(other.Point(tri[0]), other.Point(tri[1]), other.Point(tri[2]), edge.Point(a.lo));
+        }
+        int sign = (dp[0] * dq[1] - dp[1] * dq[0]).Sign();
+        int moved = edge.moved ? 1 : -1;
+        for (int k = 0; k < 3 && sign == 0; ++k)
+            sign = ((dp[0] - dq[0]) * Wide(n[1][k]) + (dq[1] - dp[1]) * Wide(n[0][k])).Sign() * moved;
+        if (sign == 0)
+            return a.triangle < b.triangle;
+        return sign * side > 0;
+    }
+
+    /// <summary>
+    /// Intersection segment of two triangles. With nothing coplanar the segment ends where an edge of one triangle
+    /// passes through the other, so of the (up to) four edges crossing the other triangle's plane either none or
+    /// exactly two pass through the other triangle.
+    /// </summary>
+    bool IntersectTriangles(const Operand* operands, uint32_t t0, uint32_t t1, Segment& out) {
+        const uint32_t tri[2] = { t0, t1 };
+        int side[2][3];
+        for (int m = 0; m < 2; ++m) {
+            const Operand& other = operands[1 - m];
+            const auto& o = other.triangles[tri[1 - m]];
+            GridPoint p0 = other.Point(o[0]), p1 = other.Point(o[1]), p2 = other.Point(o[2]);
+            for (int k = 0; k < 3; ++k) {
+                side[m][k] = Orient(p0, p1, p2, operands[m].Point(operands[m].triangles[tri[m]][k]));
+                if (side[m][k] == 0)
+                    return false;
+            }
+            if (side[m][0] == side[m][1] && side[m][1] == side[m][2])
+                return false;
+        }
+
+        int found = 0;
+        for (int m = 0; m < 2; ++m) {
+            const Operand& operand = operands[m];
+            const Operand& other = operands[1 - m];
+            const auto& corners = operand.triangles[tri[m]];
+            const auto& o = other.triangles[tri[1 - m]];
+            for (int k = 0; k < 3; ++k) {
+                if (side[m][k] == side[m][(k + 1) % 3])
+                    continue;
+                uint32_t lo = std::min(corners[k], corners[(k + 1) % 3]), hi = std::max(corners[k], corners[(k + 1) % 3]);
+                if (!SegmentCrossesTriangle(operand.Point(lo), operand.Point(hi), other.Point(o[0]), other.Point(o[1]), other.Point(o[2])))
+                    continue;
+                if (found == 2)
+                    return false;
+                out.ends[found++] = { (uint32_t)m, lo, hi, tri[1 - m] };
+            }
+        }
+        if (found != 2)
+            return false;
+        out.triangles[0] = t0;
+        out.triangles[1] = t1;
+        return true;
+    }
+
+    /// <summary>
+    /// Whether the inside of the other operand lies left of the segment run from its first end to its second, seen
+    /// from the front of its triangle in operand m. The first end is on an edge, u to v in the counter clockwise order
+    /// of that edge's triangle, and the segment leaves it into that triangle. Working the cross products through,
+    /// inside is on the left when v is in front of the plane the edge crosses, with the sign flipped for an edge of
+    /// the other operand.
+    /// </summary>
+    bool InsideOnLeft(const Operand* operands, const Segment& s, uint32_t m) {
+        const PointKey& end = s.ends[0];
+        const Operand& owner = operands[end.mesh];
+        const Operand& other = operands[1 - end.mesh];
+        const auto& tri = owner.triangles[s.triangles[end.mesh]];
+        uint32_t to = tri[0];
+        for (int k = 0; k < 3; ++k) {
+            if (std::min(tri[k], tri[(k + 1) % 3]) == end.lo && std::max(tri[k], tri[(k + 1) % 3]) == end.hi)
+                to = tri[(k + 1) % 3];
+        }
+        const auto& crossed = other.triangles[end.triangle];
+        int side = Orient(other.Point(crossed[0]), other.Point(crossed[1]), other.Point(crossed[2]), owner.Point(to));
+        return ((side > 0) == (end.mesh == m)) != operands[1 - m].inverted;
+    }
+
+    uint64_t EdgeKey(uint32_t a, uint32_t b) {
+        return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+    }
+
+    /// <summary>
+    /// Cuts one crossed triangle along its intersection segments. The segments form chains between points on the
+    /// triangle's edges and closed loops inside it. Chains split the boundary cycle into polygons purely by
+    /// connectivity, loops become holes of the polygon around them and every polygon (and loop interior) is ear
+    /// clipped. Geometry only shapes the triangles, so neighbouring triangles always agree on their shared edges
+    /// and the result stays a valid surface even where numbers degenerate. No edge is added twice, where clipping
+    /// can't avoid that a polygon is fanned around a new center vertex instead.
+    /// </summary>
+    class TriangleSplitter {
+    public:
+        /// <summary>
+        /// Center vertices get the ids STEINER_ID + their index in steiner
+        /// </summary>
+        static const uint32_t STEINER_ID = 0x80000000u;
+
+        std::vector<uint32_t> boundary;
+        std::vector<std::pair<uint32_t, uint32_t>> segments;
+        /// <summary>
+        /// Every segment as a directed key (from << 32 | to) running with the other operand's inside on its left
+        /// </summary>
+        std::unordered_set<uint64_t> insideOnLeft;
+        /// <summary>
+        /// Whether corner k of the triangle is inside the other operand, only asked when there are loops
+        /// </summary>
+        std::function<bool(int)> cornerInside;
+        std::unordered_map<uint32_t, glm::dvec2> positions;
+        std::vector<glm::dvec2> steiner;
+
+        /// <summary>
+        /// Appends the triangles as vertex triples to out
+        /// </summary>
+        void Split(std::vector<uint32_t>& out) {
+            size_t n = boundary.size();
+            std::unordered_map<uint32_t, std::array<uint32_t, 2>> links;
+            std::unordered_map<uint32_t, int> degree;
+            for (const auto& s : segments) {
+                for (int k = 0; k < 2; ++k) {
+                    uint32_t a = k ? s.second : s.first, b = k ? s.first : s.second;
+                    int& d = degree[a];
+                    if (d < 2)
+                        links[a][d] = b;
+                    d++;
+                }
+            }
+            std::unordered_map<uint32_t, int> boundaryIndex;
+            for (size_t i = 0; i < n; ++i)
+                boundaryIndex[boundary[i]] = (int)i;
+
+            //Chords between edge points, through the interior points of their chain
+            std::vector<int> partner(n, -1);
+            std::vector<std::vector<uint32_t>> chains(n);
+            std::unordered_set<uint32_t> visited;
+            bool regular = true;
+            for (const auto& d : degree) {
+                bool onBoundary = boundaryIndex.count(d.first) > 0;
+                if (d.second != (onBoundary ? 1 : 2))
+                    regular = false;
+            }
+            for (size_t i = 0; i < n && regular; ++i) {
+                auto it = degree.find(boundary[i]);
+                if (it == degree.end() || partner[i] >= 0)
+                    continue;
+                uint32_t previous = boundary[i], current = links[boundary[i]][0];
+                std::vector<uint32_t> chain;
+                while (!boundaryIndex.count(current) && chain.size() <= degree.size()) {
+                    chain.push_back(current);
+                    visited.insert(current);
+                    const auto& l = links[current];
+                    uint32_t next = l[0] == previous ? l[1] : l[0];
+                    previous = current;
+                    current = next;
+                }
+                auto end = boundaryIndex.find(current);
+                if (end == boundaryIndex.end() || end->second == (int)i || partner[end->second] >= 0) {
+                    regular = false;
+                    break;
+                }
+                int j = end->second;
+                partner[i] = j;
+                partner[j] = (int)i;
+                chains[j].assign(chain.rbegin(), chain.rend());
+                chains[i] = std::move(chain);
+            }
+            if (!regular) {
+                //Not a clean arrangement (the other mesh isn't a manifold here), keep the edges but ignore the segments
+                std::fill(partner.begin(), partner.end(), -1);
+                visited.clear();
+            }
+
+            //Walking the boundary counter clockwise, every chord endpoint turns into its chord
+            std::vector<std::vector<uint32_t>> faces;
+            std::vector<std::array<int, 2>> chordFaces(n, { -1, -1 });
+            std::vector<char> arcDone(n, 0);
+            for (size_t k = 0; k < n; ++k) {
+                if (arcDone[k])
+                    continue;
+                std::vector<uint32_t> face;
+                size_t arc = k;
+                do {
+                    arcDone[arc] = 1;
+                    face.push_back(boundary[arc]);
+                    size_t p = (arc + 1) % n;
+                    if (partner[p] >= 0) {
+                        chordFaces[std::min(p, (size_t)partner[p])][p < (size_t)partner[p] ? 0 : 1] = (int)faces.size();
+                        face.push_back(boundary[p]);
+                        face.insert(face.end(), chains[p].begin(), chains[p].end());
+                        arc = (size_t)partner[p];
+                    }
+                    else {
+                        arc = p;
+                    }
+                } while (arc != k && face.size() <= 2 * n + visited.size());
+                faces.push_back(std::move(face));
+            }
+
+            //Whatever interior points no chain reached form closed loops
+            std::vector<std::vector<uint32_t>> loops;
+            if (regular) {
+                for (const auto& d : degree) {
+                    if (visited.count(d.first) || boundaryIndex.count(d.first))
+                        continue;
+                    std::vector<uint32_t> loop;
+                    uint32_t previous = links[d.first][1], current = d.first;
+                    while (!visited.count(current)) {
+                        visited.insert(current);
+                        loop.push_back(current);
+                        const auto& l = links[current];
+                        uint32_t next = l[0] == previous ? l[1] : l[0];
+                        previous = current;
+                        current = next;
+                    }
+                    if (loop.size() >= 3)
+                        loops.push_back(std::move(loop));
+                }
+            }
+
+            //Each loop is a hole of the innermost polygon or loop around it and the outline of the region inside it
+            size_t faceCount = faces.size();
+            std::vector<std::vector<uint32_t>> outlines = faces;
+            outlines.insert(outlines.end(), loops.begin(), loops.end());
+            std::vector<size_t> parents(loops.size(), 0);
+            std::vector<std::vector<size_t>> holes(outlines.size());
+            for (size_t l = 0; l < loops.size(); ++l) {
+                const glm::dvec2& p = positions[loops[l][0]];
+                double parentArea = -1.0;
+                for (size_t o = 0; o < outlines.size(); ++o) {
+                    if (o == faceCount + l || !Contains(outlines[o], p))
+                        continue;
+                    double area = std::abs(SignedArea(outlines[o]));
+                    if (parentArea < 0.0 || area < parentArea) {
+                        parents[l] = o;
+                        parentArea = area;
+                    }
+                }
+                holes[parents[l]].push_back(faceCount + l);
+            }
+
+            //A loop can shrink to a point, so it isn't oriented by its area: inside the other operand on the left
+            //makes it counter clockwise exactly when it holds the inside, the opposite of the region around it.
+            //Regions flip across every chord and loop starting from the exact state of the first corner.
+            if (!loops.empty()) {
+                std::vector<int> status(outlines.size(), -1);
+                status[0] = cornerInside(0);
+                std::vector<size_t> queue{ 0 };
+                for (size_t q = 0; q < queue.size(); ++q) {
+                    for (const auto& chord : chordFaces) {
+                        for (int side = 0; side < 2; ++side) {
+                            if (chord[side] == (int)queue[q] && chord[1 - side] >= 0 && status[chord[1 - side]] < 0) {
+                                status[chord[1 - side]] = !status[queue[q]];
+                                queue.push_back(chord[1 - side]);
+                            }
+                        }
+                    }
+                }
+                for (bool changed = true; changed;) {
+                    changed = false;
+                    for (size_t l = 0; l < loops.size(); ++l) {
+                        if (status[faceCount + l] < 0 && status[parents[l]] >= 0) {
+                            status[faceCount + l] = !status[parents[l]];
+                            changed = true;
+                        }
+                    }
+                }
+                for (size_t l = 0; l < loops.size(); ++l) {
+                    std::vector<uint32_t>& loop = outlines[faceCount + l];
+                    bool forward = insideOnLeft.count((uint64_t)loop[0] << 32 | loop[1]) > 0;
+                    if (forward != (status[faceCount + l] == 1))
+                        std::reverse(loop.begin(), loop.end());
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i)
+                edges.insert(EdgeKey(boundary[i], boundary[(i + 1) % n]));
+            for (const auto& s : segments)
+                edges.insert(EdgeKey(s.first, s.second));
+            for (size_t o = 0; o < outlines.size(); ++o) {
+                std::vector<uint32_t> polygon = outlines[o];
+                for (size_t h : holes[o]) {
+                    std::vector<uint32_t> hole = outlines[h];
+                    std::reverse(hole.begin(), hole.end());
+                    Bridge(polygon, hole);
+                }
+                EarClip(polygon, out);
+            }
+        }
+
+    private:
+        std::unordered_set<uint64_t> edges;
+
+        double SignedArea(const std::vector<uint32_t>& polygon) {
+            double area = 0.0;
+            for (size_t i = 0; i < polygon.size(); ++i) {
+                const glm::dvec2& a = positions[polygon[i]];
+                const glm::dvec2& b = positions[polygon[(i + 1) % polygon.size()]];
+                area += a.x * b.y - a.y * b.x;
+            }
+            return area * 0.5;
+        }
+
+        bool Contains(const std::vector<uint32_t>& polygon, const glm::dvec2& p) {
+            bool inside = false;
+            for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+                const glm::dvec2& a = positions[polygon[i]];
+                const glm::dvec2& b = positions[polygon[j]];
+                if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+                    inside = !inside;
+            }
+            return inside;
+        }
+
+        bool SegmentsCross(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& d) {
+            return Orient2D(a, b, c) * Orient2D(a, b, d) < 0 && Orient2D(c, d, a) * Orient2D(c, d, b) < 0;
+        }
+
+        /// <summary>
+        /// Joins the hole (clockwise) into the polygon through a bridge edge that is walked once each way. The bridge
+        /// runs from the hole's rightmost vertex to the closest polygon vertex it doesn't cross an edge on the way to.
+        /// </summary>
+        void Bridge(std::vector<uint32_t>& polygon, const std::vector<uint32_t>& hole) {
+            size_t from = 0;
+            for (size_t i = 1; i < hole.size(); ++i) {
+                if (positions[hole[i]].x > positions[hole[from]].x)
+                    from = i;
+            }
+            const glm::dvec2 m = positions[hole[from]];
+            std::vector<std::pair<double, size_t>> candidates;
+            for (size_t i = 0; i < polygon.size(); ++i) {
+                glm::dvec2 d = positions[polygon[i]] - m;
+                candidates.push_back({ glm::dot(d, d), i });
+            }
+            std::sort(candidates.begin(), candidates.end());
+            size_t to = candidates.front().second;
+            for (const auto& candidate : candidates) {
+                const glm::dvec2& v = positions[polygon[candidate.second]];
+                bool blocked = edges.count(EdgeKey(polygon[candidate.second], hole[from])) > 0;
+                for (const std::vector<uint32_t>* ring : { (const std::vector<uint32_t>*)&polygon, &hole }) {
+                    for (size_t i = 0; i < ring->size() && !blocked; ++i) {
+                        uint32_t a = (*ring)[i], b = (*ring)[(i + 1) % ring->size()];
+                        if (a == polygon[candidate.second] || b == polygon[candidate.second] || a == hole[from] || b == hole[from])
+                            continue;
+                        blocked = SegmentsCross(m, v, positions[a], positions[b]);
+                    }
+                }
+                if (!blocked) {
+                    to = candidate.second;
+                    break;
+                }
+            }
+            edges.insert(EdgeKey(polygon[to], hole[from]));
+            std::vector<uint32_t> merged(polygon.begin(), polygon.begin() + to + 1);
+            for (size_t i = 0; i <= hole.size(); ++i)
+                merged.push_back(hole[(from + i) % hole.size()]);
+            merged.insert(merged.end(), polygon.begin() + to, polygon.end());
+            polygon = std::move(merged);
+        }
+
+        /// <summary>
+        /// Ear clipping that always finishes: if rounding leaves no clean ear the flattest corner goes next, and once
+        /// every corner would repeat an edge the rest is fanned around its center
+        /// </summary>
+        void EarClip(std::vector<uint32_t> polygon, std::vector<uint32_t>& out) {
+            size_t n = polygon.size();
+            if (n < 3)
+                return;
+            std::vector<size_t> prev(n), next(n);
+            for (size_t i = 0; i < n; ++i) {
+                prev[i] = (i + n - 1) % n;
+                next[i] = (i + 1) % n;
+            }
+            auto at = [&](size_t i) -> const glm::dvec2& { return positions[polygon[i]]; };
+            auto isNewDiagonal = [&](size_t i) {
+                return polygon[prev[i]] != polygon[next[i]] && !edges.count(EdgeKey(polygon[prev[i]], polygon[next[i]]));
+            };
+            auto isEar = [&](size_t i) {
+                const glm::dvec2& a = at(prev[i]);
+                const glm::dvec2& b = at(i);
+                const glm::dvec2& c = at(next[i]);
+                if (Orient2D(a, b, c) <= 0 || !isNewDiagonal(i))
+                    return false;
+                for (size_t j = next[next[i]]; j != prev[i]; j = next[j]) {
+                    const glm::dvec2& p = at(j);
+                    if (p == a || p == b || p == c)
+                        continue;
+                    if (Orient2D(at(prev[j]), p, at(next[j])) > 0)
+                        continue;
+                    if (Orient2D(a, b, p) >= 0 && Orient2D(b, c, p) >= 0 && Orient2D(c, a, p) >= 0)
+                        return false;
+                }
+                return true;
+            };
+            size_t current = 0;
+            for (size_t remaining = n; remaining > 3; --remaining) {
+                size_t ear = n;
+                size_t i = current;
+                for (size_t tries = 0; tries < remaining; ++tries, i = next[i]) {
+                    if (isEar(i)) {
+                        ear = i;
+                        break;
+                    }
+                }
+                if (ear == n) {
+                    //no proper ear, take the corner that folds the least
+                    double best = -DBL_MAX;
+                    i = current;
+                    for (size_t tries = 0; tries < remaining; ++tries, i = next[i]) {
+                        glm::dvec2 u = at(i) - at(prev[i]), v = at(next[i]) - at(i);
+                        double cross = u.x * v.y - u.y * v.x;
+                        if (cross > best && isNewDiagonal(i)) {
+                            best = cross;
+                            ear = i;
+                        }
+                    }
+                }
+                if (ear == n) {
+                    glm::dvec2 center(0.0);
+                    i = current;
+                    for (size_t k = 0; k < remaining; ++k, i = next[i])
+                        center += at(i) / (double)remaining;
+                    uint32_t id = STEINER_ID + (uint32_t)steiner.size();
+                    steiner.push_back(center);
+                    positions[id] = center;
+                    for (size_t k = 0; k < remaining; ++k, i = next[i])
+                        out.insert(out.end(), { polygon[i], polygon[next[i]], id });
+                    return;
+                }
+                edges.insert(EdgeKey(polygon[prev[ear]], polygon[next[ear]]));
+                out.insert(out.end(), { polygon[prev[ear]], polygon[ear], polygon[next[ear]] });
+                next[prev[ear]] = next[ear];
+                prev[next[ear]] = prev[ear];
+                current = prev[ear];
+            }
+            out.insert(out.end(), { polygon[prev[current]], polygon[current], polygon[next[current]] });
+        }
+    };
+
+    /// <summary>
+    /// Union find with path halving, only used single threaded
+    /// </summary>
+    uint32_t FindSet(std::vector<uint32_t>& parent, uint32_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void UniteSets(std::vector<uint32_t>& parent, uint32_t a, uint32_t b) {
+        a = FindSet(parent, a);
+        b = FindSet(parent, b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+
+    /// <summary>
+    /// Faces of one operand after the cut, in the shared vertex numbering
+    /// </summary>
+    struct CutFaces {
+        std::vector<uint32_t> faceStart{ 0 };
+        std::vector<uint32_t> corners;
+        std::vector<char> inside;
+    };
+
+    /// <summary>
+    /// Winding number of the other operand around a vertex, exits minus entries along a ray from it.
+    /// The ray is a segment to a grid point outside everything, so every crossing is decided exactly.
+    /// </summary>
+    int WindingNumber(const Operand& other, const GridPoint& origin) {
+        GridPoint far = { origin.p + RAY_OFFSET, origin.moved };
+        glm::vec3 from(origin.p);
+        glm::vec3 dir = glm::vec3(RAY_OFFSET);
+        int winding = 0;
+        other.bvh.QueryRay(from, dir, other.boxes, [&](uint32_t t) {
+            const auto& tri = other.triangles[t];
+            GridPoint p0 = other.Point(tri[0]), p1 = other.Point(tri[1]), p2 = other.Point(tri[2]);
+            int start = Orient(p0, p1, p2, origin);
+            if (start == 0 || Orient(p0, p1, p2, far) != -start)
+                return;
+            if (SegmentCrossesTriangle(origin, far, p0, p1, p2))
+                winding += start < 0 ? 1 : -1;
+        });
+        return winding;
+    }
+
+    /// <summary>
+    /// Splits the faces of one operand into regions that no intersection curve crosses and decides which of them
+    /// lie inside the other operand. Regions with an original vertex ask the winding number at it, the rest are
+    /// bounded by curves only and take the opposite of a neighbour across one of them.
+    /// </summary>
+    void ClassifyRegions(CutFaces& cut, const Operand& other, const Operand* operands, uint32_t vertexCount,
+        uint32_t originalCount, const std::unordered_set<uint64_t>& curveEdges)
+    {
+        size_t faceCount = cut.faceStart.size() - 1;
+        std::vector<uint32_t> parent(faceCount);
+        for (size_t f = 0; f < faceCount; ++f)
+            parent[f] = (uint32_t)f;
+
+        //sides bucketed by their lower vertex, faces sharing a side off the curves are in the same region
+        std::vector<uint32_t> sideFace(cut.corners.size());
+        for (size_t f = 0; f < faceCount; ++f) {
+            for (uint32_t c = cut.faceStart[f]; c < cut.faceStart[f + 1]; ++c)
+                sideFace[c] = (uint32_t)f;
+        }
+        auto nextCorner = [&](uint32_t c) {
+            uint32_t f = sideFace[c];
+            return c + 1 < cut.faceStart[f + 1] ? c + 1 : cut.faceStart[f];
+        };
+        std::vector<uint32_t> bucketStart(vertexCount + 1, 0);
+        for (uint32_t c = 0; c < cut.corners.size(); ++c)
+            bucketStart[std::min(cut.corners[c], cut.corners[nextCorner(c)]) + 1]++;
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            bucketStart[v + 1] += bucketStart[v];
+        std::vector<uint32_t> cursor(bucketStart.begin(), bucketStart.end() - 1);
+        std::vector<uint32_t> buckets(cut.corners.size());
+        for (uint32_t c = 0; c < cut.corners.size(); ++c)
+            buckets[cursor[std::min(cut.corners[c], cut.corners[nextCorner(c)])]++] = c;
+
+        std::vector<std::pair<uint32_t, uint32_t>> acrossCurves;
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            for (uint32_t i = bucketStart[v]; i < bucketStart[v + 1]; ++i) {
+                uint32_t c = buckets[i];
+                uint32_t high = std::max(cut.corners[c], cut.corners[nextCorner(c)]);
+                bool curve = curveEdges.count(EdgeKey(v, high)) > 0;
+                for (uint32_t j = i + 1; j < bucketStart[v + 1]; ++j) {
+                    uint32_t d = buckets[j];
+                    if (std::max(cut.corners[d], cut.corners[nextCorner(d)]) != high)
+                        continue;
+                    if (curve)
+                        acrossCurves.push_back({ sideFace[c], sideFace[d] });
+                    else
+                        UniteSets(parent, sideFace[c], sideFace[d]);
+                }
+            }
+        }
+
+        std::vector<int> status(faceCount, -1);
+        std::vector<uint32_t> representative(faceCount, UINT32_MAX);
+        for (size_t f = 0; f < faceCount; ++f) {
+            uint32_t region = FindSet(parent, (uint32_t)f);
+            for (uint32_t c = cut.faceStart[f]; c < cut.faceStart[f + 1] && representative[region] == UINT32_MAX; ++c) {
+                if (cut.corners[c] < originalCount)
+                    representative[region] = cut.corners[c];
+            }
+        }
+        std::vector<uint32_t> known;
+        std::vector<uint32_t> regions;
+        for (size_t f = 0; f < faceCount; ++f) {
+            if (parent[f] == f && representative[f] != UINT32_MAX)
+                regions.push_back((uint32_t)f);
+        }
+        ParallelFor(regions.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t region = regions[i];
+                uint32_t v = representative[region];
+                const Operand& owner = v < operands[1].firstVertex ? operands[0] : operands[1];
+                status[region] = WindingNumber(other, owner.Point(v - owner.firstVertex)) != 0;
+            }
+        }, 16);
+        known = regions;
+
+        //regions bounded by curves alone flip across every curve
+        std::unordered_map<uint32_t, std::vector<uint32_t>> neighbours;
+        for (const auto& pair : acrossCurves) {
+            uint32_t r0 = FindSet(parent, pair.first), r1 = FindSet(parent, pair.second);
+            if (r0 == r1)
+                continue;
+            neighbours[r0].push_back(r1);
+            neighbours[r1].push_back(r0);
+        }
+        for (size_t i = 0; i < known.size(); ++i) {
+            auto it = neighbours.find(known[i]);
+            if (it == neighbours.end())
+                continue;
+            for (uint32_t r : it->second) {
+                if (status[r] < 0) {
+                    status[r] = !status[known[i]];
+                    known.push_back(r);
+                }
+            }
+        }
+
+        cut.inside.resize(faceCount);
+        for (size_t f = 0; f < faceCount; ++f)
+            cut.inside[f] = status[FindSet(parent, (uint32_t)f)] == 1;
+    }
+}
+
+size_t MeshBoolean(const HalfEdgeMesh& a, const HalfEdgeMesh& b, const glm::mat4& bToA, BooleanOperation operation,
+    MeshArrays& result)
+{
+    TRACE_SCOPE("Mesh Boolean");
+    Operand operands[2];
+    LoadOperand(a, glm::mat4(1.0f), operands[0]);
+    LoadOperand(b, bToA, operands[1]);
+    operands[1].moved = true;
+    operands[1].firstVertex = (uint32_t)operands[0].positions.size();
+    uint32_t originalCount = operands[1].firstVertex + (uint32_t)operands[1].positions.size();
+    glm::dvec3 center;
+    double scale;
+    SnapOperands(operands, center, scale);
+
+    //Triangle pairs whose boxes overlap, the larger operand's triangles query the smaller one's hierarchy
+    std::vector<std::array<uint32_t, 2>> pairs;
+    {
+        TRACE_SCOPE("Boolean Pairs");
+        int large = operands[0].triangles.size() >= operands[1].triangles.size() ? 0 : 1;
+        const Operand& querying = operands[large];
+        const Operand& queried = operands[1 - large];
+        AABB queriedBounds = queried.bvh.Empty() ? AABB() : queried.bvh.nodes[0].bounds;
+        std::mutex pairMutex;
+        ParallelFor(querying.triangles.size(), [&](size_t begin, size_t end) {
+            std::vector<std::array<uint32_t, 2>> found;
+            for (size_t t = begin; t < end; ++t) {
+                if (!queriedBounds.Intersects(querying.boxes[t]))
+                    continue;
+                queried.bvh.QueryBox(querying.boxes[t], queried.boxes, [&](uint32_t other) {
+                    std::array<uint32_t, 2> pair;
+                    pair[large] = (uint32_t)t;
+                    pair[1 - large] = other;
+                    found.push_back(pair);
+                });
+            }
+            std::lock_guard<std::mutex> lock(pairMutex);
+            pairs.insert(pairs.end(), found.begin(), found.end());
+        }, 1024);
+    }
+
+    std::vector<Segment> segments;
+    {
+        TRACE_SCOPE("Boolean Segments");
+        std::mutex segmentMutex;
+        ParallelFor(pairs.size(), [&](size_t begin, size_t end) {
+            std::vector<Segment> found;
+            Segment segment;
+            for (size_t i = begin; i < end; ++i) {
+                if (IntersectTriangles(operands, pairs[i][0], pairs[i][1], segment))
+                    found.push_back(segment);
+            }
+            std::lock_guard<std::mutex> lock(segmentMutex);
+            segments.insert(segments.end(), found.begin(), found.end());
+        }, 256);
+        std::sort(segments.begin(), segments.end(), [](const Segment& s, const Segment& t) {
+            return s.triangles[0] != t.triangles[0] ? s.triangles[0] < t.triangles[0] : s.triangles[1] < t.triangles[1];
+        });
+    }
+
+    //Intersection points, shared by every segment ending there. Points on one edge end up next to each other.
+    std::vector<PointKey> points;
+    points.reserve(segments.size() * 2);
+    for (const Segment& s : segments)
+        points.insert(points.end(), { s.ends[0], s.ends[1] });
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    for (Segment& s : segments) {
+        for (int k = 0; k < 2; ++k)
+            s.points[k] = (uint32_t)(std::lower_bound(points.begin(), points.end(), s.ends[k]) - points.begin());
+    }
+    std::vector<glm::dvec3> pointPositions(points.size());
+    ParallelFor(points.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const PointKey& key = points[i];
+            const Operand& operand = operands[key.mesh];
+            const Operand& other = operands[1 - key.mesh];
+            glm::dvec3 p(operand.grid[key.lo]), q(operand.grid[key.hi]);
+            glm::dvec3 t0(other.grid[other.triangles[key.triangle][0]]);
+            glm::dvec3 n = other.Normal(key.triangle);
+            double dp = glm::dot(n, p - t0), dq = glm::dot(n, q - t0);
+            double t = dp != dq ? glm::clamp(dp / (dp - dq), 0.0, 1.0) : 0.5;
+            pointPositions[i] = p + (q - p) * t;
+        }
+    });
+    uint32_t pointBase = originalCount;
+
+    //Points on one edge in their exact order from the lower vertex, rounding often puts several on the same spot
+    std::vector<uint32_t> edgeOrder(points.size());
+    for (uint32_t i = 0; i < points.size(); ++i)
+        edgeOrder[i] = i;
+    for (size_t first = 0, last; first < points.size(); first = last) {
+        for (last = first + 1; last < points.size() && points[last].mesh == points[first].mesh &&
+            points[last].lo == points[first].lo && points[last].hi == points[first].hi; ++last);
+        if (last - first > 1) {
+            std::sort(edgeOrder.begin() + first, edgeOrder.begin() + last, [&](uint32_t i, uint32_t j) {
+                return PointBefore(operands, points[i], points[j]);
+            });
+        }
+    }
+    auto edgePoints = [&](uint32_t mesh, uint32_t u, uint32_t v, std::vector<uint32_t>& out) {
+        uint32_t lo = std::min(u, v), hi = std::max(u, v);
+        auto first = std::lower_bound(points.begin(), points.end(), PointKey{ mesh, lo, hi, 0 });
+        auto last = std::lower_bound(first, points.end(), PointKey{ mesh, lo, hi + 1, 0 });
+        size_t start = out.size();
+        out.insert(out.end(), edgeOrder.begin() + (first - points.begin()), edgeOrder.begin() + (last - points.begin()));
+        if (u > v)
+            std::reverse(out.begin() + start, out.end());
+    };
+
+    //Triangles to split: crossed ones and ones with points on an edge (a degenerate triangle never crosses anything
+    //but its neighbours may put points on the edge they share)
+    std::vector<std::pair<uint32_t, uint32_t>> split;
+    std::vector<std::vector<int>> splitIndex(2);
+    std::vector<std::pair<uint64_t, uint32_t>> triangleSegments;
+    for (uint32_t s = 0; s < segments.size(); ++s) {
+        for (uint32_t m = 0; m < 2; ++m)
+            triangleSegments.push_back({ (uint64_t)m << 32 | segments[s].triangles[m], s });
+    }
+    std::sort(triangleSegments.begin(), triangleSegments.end());
+    for (uint32_t m = 0; m < 2; ++m) {
+        const Operand& operand = operands[m];
+        splitIndex[m].assign(operand.triangles.size(), -1);
+        if (points.empty())
+            continue;
+        std::vector<char> touched(operand.triangles.size(), 0);
+        ParallelFor(operand.triangles.size(), [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                const auto& tri = operand.triangles[t];
+                for (int k = 0; k < 3 && !touched[t]; ++k) {
+                    uint32_t lo = std::min(tri[k], tri[(k + 1) % 3]), hi = std::max(tri[k], tri[(k + 1) % 3]);
+                    auto it = std::lower_bound(points.begin(), points.end(), PointKey{ m, lo, hi, 0 });
+                    touched[t] = it != points.end() && it->mesh == m && it->lo == lo && it->hi == hi;
+                }
+            }
+        });
+        for (const auto& entry : triangleSegments) {
+            if (entry.first >> 32 == m)
+                touched[(uint32_t)entry.first] = 1;
+        }
+        for (uint32_t t = 0; t < operand.triangles.size(); ++t) {
+            if (touched[t]) {
+                splitIndex[m][t] = (int)split.size();
+                split.push_back({ m, t });
+            }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> splitTriangles(split.size());
+    std::vector<std::vector<glm::dvec3>> splitCenters(split.size());
+    {
+        TRACE_SCOPE("Boolean Retriangulate");
+        ParallelFor(split.size(), [&](size_t begin, size_t end) {
+            std::vector<uint32_t> sidePoints;
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t m = split[i].first, t = split[i].second;
+                const Operand& operand = operands[m];
+                const auto& tri = operand.triangles[t];
+                TriangleSplitter splitter;
+                //project along the largest normal component, keeping the winding counter clockwise
+                glm::dvec3 n = operand.Normal(t);
+                glm::dvec3 absN = glm::abs(n);
+                int axis = absN.x >= absN.y && absN.x >= absN.z ? 0 : (absN.y >= absN.z ? 1 : 2);
+                int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                if (n[axis] < 0.0)
+                    std::swap(u, v);
+                auto project = [&](const glm::dvec3& p) { return glm::dvec2(p[u], p[v]); };
+
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t corner = operand.firstVertex + tri[k];
+                    splitter.boundary.push_back(corner);
+                    splitter.positions[corner] = project(glm::dvec3(operand.grid[tri[k]]));
+                    sidePoints.clear();
+                    edgePoints(m, tri[k], tri[(k + 1) % 3], sidePoints);
+                    for (uint32_t p : sidePoints) {
+                        splitter.boundary.push_back(pointBase + p);
+                        splitter.positions[pointBase + p] = project(pointPositions[p]);
+                    }
+                }
+                auto range = std::equal_range(triangleSegments.begin(), triangleSegments.end(),
+                    std::pair<uint64_t, uint32_t>((uint64_t)m << 32 | t, 0),
+                    [](const std::pair<uint64_t, uint32_t>& x, const std::pair<uint64_t, uint32_t>& y) { return x.first < y.first; });
+                for (auto it = range.first; it != range.second; ++it) {
+                    const Segment& s = segments[it->second];
+                    for (uint32_t p : s.points)
+                        splitter.positions.emplace(pointBase + p, project(pointPositions[p]));
+                    uint32_t from = pointBase + s.points[0], to = pointBase + s.points[1];
+                    splitter.segments.push_back({ from, to });
+                    if (InsideOnLeft(operands, s, m))
+                        splitter.insideOnLeft.insert((uint64_t)from << 32 | to);
+                    else
+                        splitter.insideOnLeft.insert((uint64_t)to << 32 | from);
+                }
+                splitter.cornerInside = [&](int k) {
+                    return WindingNumber(operands[1 - m], operand.Point(tri[k])) != 0;
+                };
+                splitter.Split(splitTriangles[i]);
+
+                //center vertices back from the projection to the triangle's plane
+                glm::dvec2 q0 = splitter.positions[splitter.boundary[0]];
+                glm::dvec2 e1 = splitter.positions[operand.firstVertex + tri[1]] - q0;
+                glm::dvec2 e2 = splitter.positions[operand.firstVertex + tri[2]] - q0;
+                glm::dvec3 p0(operand.grid[tri[0]]), p1(operand.grid[tri[1]]), p2(operand.grid[tri[2]]);
+                double area = e1.x * e2.y - e1.y * e2.x;
+                for (const glm::dvec2& c : splitter.steiner) {
+                    glm::dvec2 d = c - q0;
+                    double l1 = area != 0.0 ? (d.x * e2.y - d.y * e2.x) / area : 1.0 / 3.0;
+                    double l2 = area != 0.0 ? (e1.x * d.y - e1.y * d.x) / area : 1.0 / 3.0;
+                    splitCenters[i].push_back(p0 + (p1 - p0) * l1 + (p2 - p0) * l2);
+                }
+            }
+        }, 16);
+        for (size_t i = 0; i < split.size(); ++i) {
+            if (splitCenters[i].empty())
+                continue;
+            uint32_t first = pointBase + (uint32_t)pointPositions.size();
+            for (uint32_t& v : splitTriangles[i]) {
+                if (v >= TriangleSplitter::STEINER_ID)
+                    v = first + (v - TriangleSplitter::STEINER_ID);
+            }
+            pointPositions.insert(pointPositions.end(), splitCenters[i].begin(), splitCenters[i].end());
+        }
+    }
+    uint32_t vertexCount = pointBase + (uint32_t)pointPositions.size();
+
+    //Faces of both operands after the cut: untouched faces keep their polygons, split faces become triangles
+    CutFaces cut[2];
+    for (int m = 0; m < 2; ++m) {
+        const Operand& operand = operands[m];
+        CutFaces& faces = cut[m];
+        size_t faceCount = operand.faceStart.size() - 1;
+        for (size_t f = 0; f < faceCount; ++f) {
+            uint32_t first = operand.faceStart[f], last = operand.faceStart[f + 1];
+            size_t firstTriangle = first - 2 * f, lastTriangle = last - 2 * (f + 1);
+            bool touched = false;
+            for (size_t t = firstTriangle; t < lastTriangle; ++t)
+                touched |= splitIndex[m][t] >= 0;
+            if (!touched) {
+                for (uint32_t c = first; c < last; ++c)
+                    faces.corners.push_back(operand.firstVertex + operand.corners[c]);
+                faces.faceStart.push_back((uint32_t)faces.corners.size());
+                continue;
+            }
+            for (size_t t = firstTriangle; t < lastTriangle; ++t) {
+                if (splitIndex[m][t] < 0) {
+                    for (uint32_t v : operand.triangles[t])
+                        faces.corners.push_back(operand.firstVertex + v);
+                    faces.faceStart.push_back((uint32_t)faces.corners.size());
+                    continue;
+                }
+                const std::vector<uint32_t>& pieces = splitTriangles[splitIndex[m][t]];
+                for (size_t c = 0; c + 2 < pieces.size(); c += 3) {
+                    faces.corners.insert(faces.corners.end(), pieces.begin() + c, pieces.begin() + c + 3);
+                    faces.faceStart.push_back((uint32_t)faces.corners.size());
+                }
+            }
+        }
+    }
+
+    {
+        TRACE_SCOPE("Boolean Classify");
+        std::unordered_set<uint64_t> curveEdges;
+        curveEdges.reserve(segments.size());
+        for (const Segment& s : segments)
+            curveEdges.insert(EdgeKey(pointBase + s.points[0], pointBase + s.points[1]));
+        for (int m = 0; m < 2; ++m)
+            ClassifyRegions(cut[m], operands[1 - m], operands, vertexCount, originalCount, curveEdges);
+    }
+
+    //Keep the faces the operation asks for, the part of b kept by a difference is turned inside out and inverted
+    //operands are turned back out
+    std::vector<uint32_t> faceStart{ 0 };
+    std::vector<uint32_t> corners;
+    for (int m = 0; m < 2; ++m) {
+        const CutFaces& faces = cut[m];
+        bool keepInside = operation == BooleanOperation::Intersection || (operation == BooleanOperation::Difference && m == 1);
+        bool flip = (operation == BooleanOperation::Difference && m == 1) != operands[m].inverted;
+        for (size_t f = 0; f + 1 < faces.faceStart.size(); ++f) {
+            if ((bool)faces.inside[f] != keepInside)
+                continue;
+            size_t start = corners.size();
+            corners.insert(corners.end(), faces.corners.begin() + faces.faceStart[f], faces.corners.begin() + faces.faceStart[f + 1]);
+            if (flip)
+                std::reverse(corners.begin() + start, corners.end());
+            faceStart.push_back((uint32_t)corners.size());
+        }
+    }
+
+    std::vector<int> remap(vertexCount, -1);
+    std::vector<glm::vec3> positions;
+    for (uint32_t& c : corners) {
+        if (remap[c] < 0) {
+            remap[c] = (int)positions.size();
+            if (c < operands[1].firstVertex)
+                positions.push_back(operands[0].positions[c]);
+            else if (c < pointBase)
+                positions.push_back(operands[1].positions[c - operands[1].firstVertex]);
+            else
+                positions.push_back(glm::vec3(center + pointPositions[c - pointBase] / scale));
+        }
+        c = (uint32_t)remap[c];
+    }
+    PolygonsToArrays(std::move(positions), faceStart, corners, result);
+    return segments.size();
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "MeshArrays.h"
+
+/// <summary>
+/// Positions are snapped to a grid of this many steps either side of the center of both meshes before any test,
+/// small enough that orientation determinants are computed exactly in 64 bit integers
+/// </summary>
+const int BOOLEAN_GRID_BITS = 20;
+
+enum class BooleanOperation {
+    Union = 0,
+    /// <summary>
+    /// a with b cut away
+    /// </summary>
+    Difference = 1,
+    Intersection = 2
+};
+
+/// <summary>
+/// Combines the closed surfaces a and b, b is placed in a's local space by bToA and the result is in a's local space.
+/// Faces are fan triangulated and a BVH over the smaller mesh finds the overlapping triangle pairs in parallel.
+/// Every decision about which triangles cross and where their intersection segments end is made with exact
+/// orientation tests on the snapped positions, b counts as moved by an infinitesimal offset so nothing is ever
+/// exactly coplanar. Crossed triangles are cut along their segments by connectivity alone, so the pieces always
+/// stitch. Regions between the intersection curves are classified by the winding number of the other surface at one
+/// of their original vertices, counted exactly along a ray, and the kept faces are joined into one mesh. Faces the
+/// other mesh doesn't cross keep their polygons, and an operand that is inside out is treated as facing outwards.
+/// Returns the number of intersecting triangle pairs.
+/// </summary>
+size_t MeshBoolean(const HalfEdgeMesh& a, const HalfEdgeMesh& b, const glm::mat4& bToA, BooleanOperation operation,
+    MeshArrays& result);
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "MeshCluster.h"
+#include <algorithm>
+#include <cmath>
+
+void ComputeClusterBounds(MeshCluster& cluster,
+    const std::vector<glm::vec3>& positions,
+    const std::vector<unsigned int>& indices)
+{
+    AABB box;
+    for (unsigned int i = cluster.indexOffset; i < cluster.indexOffset + cluster.indexCount; ++i) {
+        box.Expand(positions[indices[i]]);
+    }
+    cluster.sphere = BoundingSphere();
+    if (!box.IsValid())
+        return;
+
+    cluster.sphere.center = box.Center();
+    float radiusSquared = 0.0f;
+    for (unsigned int i = cluster.indexOffset; i < cluster.indexOffset + cluster.indexCount; ++i) {
+        glm::vec3 d = positions[indices[i]] - cluster.sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+    cluster.sphere.radius = std::sqrt(radiusSquared);
+
+    //Normal cone, axis is the average triangle normal and the spread is the widest normal from it
+    glm::vec3 axis(0.0f);
+    for (unsigned int i = cluster.indexOffset; i + 2 < cluster.indexOffset + cluster.indexCount; i += 3) {
+        glm::vec3 n = glm::cross(positions[indices[i + 1]] - positions[indices[i]], positions[indices[i + 2]] - positions[indices[i]]);
+        float length = glm::length(n);
+        if (length > 0.0f)
+            axis += n / length;
+    }
+    float axisLength = glm::length(axis);
+    cluster.coneCutoff = 1.0f;
+    if (axisLength <= 0.0f)
+        return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (unsigned int i = cluster.indexOffset; i + 2 < cluster.indexOffset + cluster.indexCount; i += 3) {
+        glm::vec3 n = glm::cross(positions[indices[i + 1]] - positions[indices[i]], positions[indices[i + 2]] - positions[indices[i]]);
+        float length = glm::length(n);
+        if (length > 0.0f)
+            minDot = std::min(minDot, glm::dot(axis, n / length));
+    }
+    cluster.coneAxis = axis;
+    // The cone of view directions that sees every triangle from behind is the normal cone widened by 90 degrees,
+    // cos(spread + 90) = -sin(spread). Spreads past 90 degrees leave no such direction.
+    cluster.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "Bounds.h"
+
+/// <summary>
+/// Target triangle count per cluster, a cluster is closed after the face that reaches it
+/// </summary>
+const unsigned int CLUSTER_TRIANGLES = 128;
+/// <summary>
+/// Meshes with fewer faces than this are drawn whole, culling would cost more than it saves
+/// </summary>
+const size_t CLUSTER_MIN_FACES = 512;
+
+/// <summary>
+/// A contiguous run of render triangles, and the edges emitted with them, that is culled as a unit.
+/// </summary>
+struct MeshCluster {
+    /// <summary>
+    /// Range in renderIndices
+    /// </summary>
+    unsigned int indexOffset = 0, indexCount = 0;
+    /// <summary>
+    /// Range in edgeIndices
+    /// </summary>
+    unsigned int edgeOffset = 0, edgeCount = 0;
+    BoundingSphere sphere;
+    /// <summary>
+    /// Average facing of the triangles, with cutoff the cosine of the cone the camera has to be inside of
+    /// for every triangle to face away. A cutoff of 1 means the cluster is never backface culled.
+    /// </summary>
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 1.0f;
+};
+
+/// <summary>
+/// Fills in the bounding sphere and normal cone of a cluster whose ranges are already set
+/// </summary>
+void ComputeClusterBounds(MeshCluster& cluster,
+    const std::vector<glm::vec3>& positions,
+    const std::vector<unsigned int>& indices);
+
+/// <summary>
+/// True when every triangle of the cluster faces away from cameraPos. Everything is in the mesh's local space.
+/// </summary>
+inline bool ClusterBackfacing(const MeshCluster& cluster, const glm::vec3& cameraPos) {
+    glm::vec3 toCenter = cluster.sphere.center - cameraPos;
+    return glm::dot(toCenter, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCenter) + cluster.sphere.radius;
+}
@@ -0,0 +1,647 @@
+#include "MeshDecimate.h"
+#include "MeshSimplify.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    /// <summary>
+    /// Collapses that would turn a triangle's normal by more than this (as a cosine) are rejected, same as SimplifyTriangles
+    /// </summary>
+    const double FLIP_COSINE = 0.2;
+    /// <summary>
+    /// Weight of the planes standing on boundary and feature edges, every face plane weighs one
+    /// </summary>
+    const double CONSTRAINT_WEIGHT = 100.0;
+    /// <summary>
+    /// Added cost per squared length of the collapsed edge. On flat areas every quadric is zero and without it
+    /// the collapses would pile onto a few vertices in queue order, with it the shortest edges go first.
+    /// </summary>
+    const double LENGTH_WEIGHT = 1e-6;
+    /// <summary>
+    /// Collapses between looking at cancel and publishing progress
+    /// </summary>
+    const int CANCEL_INTERVAL = 1024;
+    const int HEAP_ARITY = 4;
+
+    inline int NextEdge(int h) {
+        return h % 3 == 2 ? h - 2 : h + 1;
+    }
+
+    inline int PrevEdge(int h) {
+        return h % 3 == 0 ? h + 2 : h - 1;
+    }
+
+    /// <summary>
+    /// The arrays split into triangles, half edge 3t + k is side k of triangle t so next and face never change.
+    /// A collapse only rewrites origins, twins and outgoing edges, dead half edges have origin -1.
+    /// Everything a collapse reads about a vertex or a half edge sits together, the collapse order jumps all over the mesh.
+    /// </summary>
+    class Decimator {
+    public:
+        struct VertexSlot {
+            Quadric quadric;
+            glm::vec3 position;
+            /// <summary>
+            /// An outgoing half edge, -1 without faces
+            /// </summary>
+            int edge = -1;
+            char boundary = 0;
+            char removed = 0;
+            /// <summary>
+            /// Without faces in the input, kept through WriteArrays even though nothing references it
+            /// </summary>
+            char isolated = 0;
+        };
+
+        /// <summary>
+        /// A half edge, the heap fields are only used on the key half of each edge
+        /// </summary>
+        struct EdgeSlot {
+            int origin = -1;
+            int twin = -1;
+            int heapIndex = -1;
+            /// <summary>
+            /// Set when the cheaper direction removes the key's origin rather than its destination
+            /// </summary>
+            char removesOrigin = 0;
+            /// <summary>
+            /// Set when the cheaper direction folded a triangle over and the stored one is the only one left to try
+            /// </summary>
+            char pinned = 0;
+        };
+
+        std::vector<VertexSlot> vertices;
+        std::vector<EdgeSlot> edges;
+
+        void Triangulate(const MeshArrays& in);
+        void ComputeQuadrics(bool preserveFeatures);
+        size_t Run(size_t targetTriangles, double maxCost, std::atomic<float>* progress, const std::atomic<bool>* cancel);
+        void WriteArrays(MeshArrays& out) const;
+
+    private:
+        size_t liveTriangles = 0;
+
+        //Indexed min heap of edges, an edge is keyed by its lower half edge (or its only one on a boundary).
+        //Entries carry their cost so sifting only touches the heap itself, HEAP_ARITY children share a cache line.
+        struct HeapEntry {
+            float cost;
+            int key;
+        };
+        std::vector<HeapEntry> heap;
+
+        std::vector<int> ringScratch, neighboursA, neighboursB;
+
+        int Key(int h) const {
+            int t = edges[h].twin;
+            return t >= 0 && t < h ? t : h;
+        }
+
+        template<class Fn>
+        void ForEachOutgoing(int v, Fn fn) const;
+        void GatherNeighbours(int v, std::vector<int>& out) const;
+
+        bool CanRemove(int h, int removedVertex) const;
+        double CollapseCost(int removedVertex, int keptVertex) const;
+        bool LinkCondition(int h);
+        bool FoldsOver(int removedVertex, int keptVertex) const;
+        void Collapse(int h, int removedVertex, int keptVertex);
+
+        double EdgeCost(int key);
+        void UpdateEdge(int key);
+        void HeapRemove(int key);
+        void SiftUp(int i);
+        void SiftDown(int i);
+        void HeapPush(int key, float cost);
+        void Place(int i, const HeapEntry& entry) {
+            heap[i] = entry;
+            edges[entry.key].heapIndex = i;
+        }
+    };
+
+    void Decimator::Triangulate(const MeshArrays& in) {
+        TRACE_SCOPE("Decimate Triangulate");
+        size_t faceCount = in.faceEdge.size();
+        std::vector<size_t> firstTriangle(faceCount + 1, 0);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                size_t corners = 0;
+                int e = in.faceEdge[f];
+                do {
+                    corners++;
+                    e = in.next[e];
+                } while (e != in.faceEdge[f]);
+                firstTriangle[f + 1] = corners > 2 ? corners - 2 : 0;
+            }
+        });
+        for (size_t f = 0; f < faceCount; ++f)
+            firstTriangle[f + 1] += firstTriangle[f];
+
+        //Fans from each face's first corner, the diagonals are twinned to the neighbouring triangle of the same fan
+        size_t triangleCount = firstTriangle[faceCount];
+        edges.assign(triangleCount * 3, EdgeSlot());
+        std::vector<int> newEdge(in.next.size(), -1);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            std::vector<int> loop;
+            for (size_t f = begin; f < end; ++f) {
+                loop.clear();
+                int e = in.faceEdge[f];
+                do {
+                    loop.push_back(e);
+                    e = in.next[e];
+                } while (e != in.faceEdge[f]);
+                if (loop.size() < 3)
+                    continue;
+                int k = (int)loop.size();
+                int t0 = (int)firstTriangle[f];
+                for (int j = 0; j < k - 2; ++j) {
+                    int t = t0 + j;
+                    edges[3 * t].origin = in.origin[loop[0]];
+                    edges[3 * t + 1].origin = in.origin[loop[j + 1]];
+                    edges[3 * t + 2].origin = in.origin[loop[j + 2]];
+                    newEdge[loop[j + 1]] = 3 * t + 1;
+                    if (j == 0)
+                        newEdge[loop[0]] = 3 * t;
+                    else
+                        edges[3 * t].twin = 3 * t - 1;
+                    if (j == k - 3)
+                        newEdge[loop[k - 1]] = 3 * t + 2;
+                    else
+                        edges[3 * t + 2].twin = 3 * t + 3;
+                }
+            }
+        });
+        ParallelFor(in.next.size(), [&](size_t begin, size_t end) {
+            for (size_t h = begin; h < end; ++h) {
+                if (newEdge[h] >= 0 && in.twin[h] >= 0)
+                    edges[newEdge[h]].twin = newEdge[in.twin[h]];
+            }
+        });
+
+        vertices.resize(in.positions.size());
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            vertices[v].position = in.positions[v];
+            vertices[v].edge = in.vertexEdge[v] < 0 ? -1 : newEdge[in.vertexEdge[v]];
+            vertices[v].isolated = vertices[v].edge < 0;
+        }
+        liveTriangles = triangleCount;
+    }
+
+    void Decimator::ComputeQuadrics(bool preserveFeatures) {
+        TRACE_SCOPE("Decimate Quadrics");
+        size_t triangleCount = edges.size() / 3;
+        std::vector<glm::dvec3> normals(triangleCount);
+        ParallelFor(triangleCount, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                glm::dvec3 p0 = vertices[edges[3 * t].origin].position;
+                glm::dvec3 n = glm::cross(glm::dvec3(vertices[edges[3 * t + 1].origin].position) - p0, glm::dvec3(vertices[edges[3 * t + 2].origin].position) - p0);
+                double length = glm::length(n);
+                normals[t] = length > 0.0 ? n / length : glm::dvec3(0.0);
+            }
+        });
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const glm::dvec3& n = normals[t];
+            if (n == glm::dvec3(0.0))
+                continue;
+            double d = -glm::dot(n, glm::dvec3(vertices[edges[3 * t].origin].position));
+            for (int k = 0; k < 3; ++k)
+                vertices[edges[3 * t + k].origin].quadric.AddPlane(n, d, 1.0);
+        }
+
+        //A plane through each held edge, upright on its face, lets vertices slide along the edge but not off it
+        for (size_t h = 0; h < edges.size(); ++h) {
+            int t = edges[h].twin;
+            bool held = t < 0;
+            if (t >= 0 && preserveFeatures)
+                held = glm::dot(normals[h / 3], normals[t / 3]) < FEATURE_EDGE_COSINE;
+            if (!held)
+                continue;
+            int a = edges[h].origin, b = edges[NextEdge((int)h)].origin;
+            if (t < 0)
+                vertices[a].boundary = vertices[b].boundary = 1;
+            glm::dvec3 pa = vertices[a].position;
+            glm::dvec3 m = glm::cross(glm::dvec3(vertices[b].position) - pa, normals[h / 3]);
+            double length = glm::length(m);
+            if (length <= 0.0)
+                continue;
+            m /= length;
+            double d = -glm::dot(m, pa);
+            vertices[a].quadric.AddPlane(m, d, CONSTRAINT_WEIGHT);
+            vertices[b].quadric.AddPlane(m, d, CONSTRAINT_WEIGHT);
+        }
+    }
+
+    /// <summary>
+    /// Calls fn with every outgoing half edge of v. Walks one way round until it gets back or hits a boundary,
+    /// then the other way from the start.
+    /// </summary>
+    template<class Fn>
+    void Decimator::ForEachOutgoing(int v, Fn fn) const {
+        int start = vertices[v].edge;
+        if (start < 0)
+            return;
+        size_t guard = edges.size();
+        int e = start;
+        do {
+            fn(e);
+            e = edges[PrevEdge(e)].twin;
+        } while (e >= 0 && e != start && --guard);
+        if (e >= 0)
+            return;
+        e = start;
+        while (edges[e].twin >= 0 && --guard) {
+            e = NextEdge(edges[e].twin);
+            if (e == start)
+                break;
+            fn(e);
+        }
+    }
+
+    void Decimator::GatherNeighbours(int v, std::vector<int>& out) const {
+        out.clear();
+        ForEachOutgoing(v, [&](int e) {
+            out.push_back(edges[NextEdge(e)].origin);
+            out.push_back(edges[PrevEdge(e)].origin);
+        });
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    /// <summary>
+    /// Boundary vertices may only be removed along a boundary edge, anything else pulls the boundary in or pinches it
+    /// </summary>
+    bool Decimator::CanRemove(int h, int removedVertex) const {
+        return edges[h].twin < 0 || !vertices[removedVertex].boundary;
+    }
+
+    double Decimator::CollapseCost(int removedVertex, int keptVertex) const {
+        //quadrics are linear, evaluating both is the same as evaluating their sum
+        glm::dvec3 target = vertices[keptVertex].position;
+        glm::dvec3 offset = glm::dvec3(vertices[removedVertex].position) - target;
+        return vertices[removedVertex].quadric.Evaluate(target) + vertices[keptVertex].quadric.Evaluate(target)
+            + LENGTH_WEIGHT * glm::dot(offset, offset);
+    }
+
+    /// <summary>
+    /// The ends of an edge may only share the neighbours opposite it, any other shared neighbour
+    /// would leave two edges between the same vertices
+    /// </summary>
+    bool Decimator::LinkCondition(int h) {
+        int u = edges[h].origin, v = edges[NextEdge(h)].origin;
+        int w = edges[PrevEdge(h)].origin;
+        int x = edges[h].twin >= 0 ? edges[PrevEdge(edges[h].twin)].origin : -1;
+        if (w == x)
+            return false;
+        //interior vertices need three neighbours to stay closed, anything less is a tetrahedron folding flat
+        for (int corner : { w, x }) {
+            if (corner < 0 || vertices[corner].boundary)
+                continue;
+            int valence = 0;
+            ForEachOutgoing(corner, [&](int) { valence++; });
+            if (valence <= 3)
+                return false;
+        }
+        std::vector<int>& a = neighboursA;
+        std::vector<int>& b = neighboursB;
+        GatherNeighbours(u, a);
+        GatherNeighbours(v, b);
+        if (edges[h].twin >= 0 && !vertices[u].boundary && !vertices[v].boundary && a.size() + b.size() < 7)
+            return false;
+        for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+            if (a[i] < b[j]) i++;
+            else if (a[i] > b[j]) j++;
+            else {
+                if (a[i] != w && a[i] != x)
+                    return false;
+                i++;
+                j++;
+            }
+        }
+        return true;
+    }
+
+    bool Decimator::FoldsOver(int removedVertex, int keptVertex) const {
+        glm::dvec3 target = vertices[keptVertex].position;
+        bool folds = false;
+        ForEachOutgoing(removedVertex, [&](int e) {
+            int b = edges[NextEdge(e)].origin, c = edges[PrevEdge(e)].origin;
+            if (folds || b == keptVertex || c == keptVertex)
+                return;
+            glm::dvec3 pa = vertices[removedVertex].position, pb = vertices[b].position, pc = vertices[c].position;
+            glm::dvec3 before = glm::cross(pb - pa, pc - pa);
+            glm::dvec3 after = glm::cross(pb - target, pc - target);
+            double beforeLength = glm::length(before), afterLength = glm::length(after);
+            folds = afterLength <= 0.0 || glm::dot(before, after) < FLIP_COSINE * beforeLength * afterLength;
+        });
+        return folds;
+    }
+
+    /// <summary>
+    /// Removes the one or two triangles on edge h and merges removedVertex (one of its ends) into keptVertex.
+    /// The outer edges of each removed triangle become twins of each other.
+    /// </summary>
+    void Decimator::Collapse(int h, int removedVertex, int keptVertex) {
+        ringScratch.clear();
+        ForEachOutgoing(removedVertex, [&](int e) { ringScratch.push_back(e); });
+
+        int dead[6];
+        int deadCount = 0;
+        int outer[4] = { -1, -1, -1, -1 };
+        int faceVertex[2] = { -1, -1 };
+        int sides[2] = { h, edges[h].twin };
+        for (int s = 0; s < 2; ++s) {
+            int e = sides[s];
+            if (e < 0)
+                continue;
+            int e1 = NextEdge(e), e2 = PrevEdge(e);
+            faceVertex[s] = edges[e2].origin;
+            outer[2 * s] = edges[e1].twin;
+            outer[2 * s + 1] = edges[e2].twin;
+            dead[deadCount++] = e;
+            dead[deadCount++] = e1;
+            dead[deadCount++] = e2;
+        }
+        for (int i = 0; i < deadCount; ++i)
+            HeapRemove(Key(dead[i]));
+        for (int s = 0; s < 2; ++s) {
+            int a = outer[2 * s], b = outer[2 * s + 1];
+            if (a >= 0) HeapRemove(Key(a));
+            if (b >= 0) HeapRemove(Key(b));
+            if (a >= 0) edges[a].twin = b;
+            if (b >= 0) edges[b].twin = a;
+        }
+        for (int i = 0; i < deadCount; ++i) {
+            edges[dead[i]].origin = -1;
+            edges[dead[i]].twin = -1;
+        }
+        liveTriangles -= deadCount / 3;
+
+        for (int e : ringScratch) {
+            if (edges[e].origin >= 0)
+                edges[e].origin = keptVertex;
+        }
+        vertices[removedVertex].removed = 1;
+        vertices[removedVertex].edge = -1;
+        vertices[keptVertex].quadric += vertices[removedVertex].quadric;
+
+        //Every outer edge and the edge after it leave a vertex that may have lost its outgoing edge
+        auto repair = [&](int v, int a, int b) {
+            if (v < 0 || (vertices[v].edge >= 0 && edges[vertices[v].edge].origin >= 0))
+                return;
+            vertices[v].edge = -1;
+            if (a >= 0)
+                vertices[v].edge = edges[a].origin == v ? a : NextEdge(a);
+            else if (b >= 0)
+                vertices[v].edge = edges[b].origin == v ? b : NextEdge(b);
+        };
+        for (int s = 0; s < 2; ++s) {
+            //outer[2s] runs from the face vertex to one end of h, outer[2s + 1] from the other end to the face vertex
+            repair(faceVertex[s], outer[2 * s], outer[2 * s + 1]);
+            repair(keptVertex, outer[2 * s + 1], outer[2 * s]);
+        }
+        if (vertices[keptVertex].edge < 0 || edges[vertices[keptVertex].edge].origin < 0) {
+            vertices[keptVertex].edge = -1;
+            for (int e : ringScratch) {
+                if (edges[e].origin >= 0) {
+                    vertices[keptVertex].edge = e;
+                    break;
+                }
+            }
+        }
+
+        //the incoming edge only needs its own update where there's no outgoing half on the other side
+        ForEachOutgoing(keptVertex, [&](int e) {
+            UpdateEdge(Key(e));
+            if (edges[PrevEdge(e)].twin < 0)
+                UpdateEdge(PrevEdge(e));
+        });
+    }
+
+    /// <summary>
+    /// Cost of collapsing the edge in its cheaper allowed direction, which is stored in removesOrigin.
+    /// Pinned edges keep the direction they have. Negative when neither end may be removed.
+    /// </summary>
+    double Decimator::EdgeCost(int key) {
+        int u = edges[key].origin, v = edges[NextEdge(key)].origin;
+        if (edges[key].pinned)
+            return edges[key].removesOrigin ? CollapseCost(u, v) : CollapseCost(v, u);
+        bool removeU = CanRemove(key, u), removeV = CanRemove(key, v);
+        if (!removeU && !removeV)
+            return -1.0;
+        double costU = removeU ? CollapseCost(u, v) : 0.0;
+        double costV = removeV ? CollapseCost(v, u) : 0.0;
+        bool originGoes = removeU && (!removeV || costU <= costV);
+        edges[key].removesOrigin = originGoes;
+        return originGoes ? costU : costV;
+    }
+
+    /// <summary>
+    /// Queues the edge or moves it to its new cost after its neighbourhood changed, or takes it out when neither end may go
+    /// </summary>
+    void Decimator::UpdateEdge(int key) {
+        edges[key].pinned = 0;
+        double edgeCost = EdgeCost(key);
+        if (edgeCost < 0.0) {
+            HeapRemove(key);
+            return;
+        }
+        int i = edges[key].heapIndex;
+        if (i < 0) {
+            HeapPush(key, (float)edgeCost);
+            return;
+        }
+        float oldCost = heap[i].cost;
+        heap[i].cost = (float)edgeCost;
+        if (heap[i].cost < oldCost)
+            SiftUp(i);
+        else
+            SiftDown(i);
+    }
+
+    void Decimator::HeapPush(int key, float cost) {
+        heap.push_back({ cost, key });
+        edges[key].heapIndex = (int)heap.size() - 1;
+        SiftUp((int)heap.size() - 1);
+    }
+
+    void Decimator::HeapRemove(int key) {
+        int i = edges[key].heapIndex;
+        if (i < 0)
+            return;
+        edges[key].heapIndex = -1;
+        HeapEntry last = heap.back();
+        heap.pop_back();
+        if (i == (int)heap.size())
+            return;
+        Place(i, last);
+        SiftDown(i);
+        SiftUp(edges[last.key].heapIndex);
+    }
+
+    void Decimator::SiftUp(int i) {
+        HeapEntry entry = heap[i];
+        while (i > 0) {
+            int parent = (i - 1) / HEAP_ARITY;
+            if (heap[parent].cost <= entry.cost)
+                break;
+            Place(i, heap[parent]);
+            i = parent;
+        }
+        Place(i, entry);
+    }
+
+    void Decimator::SiftDown(int i) {
+        HeapEntry entry = heap[i];
+        int count = (int)heap.size();
+        for (;;) {
+            int first = HEAP_ARITY * i + 1;
+            if (first >= count)
+                break;
+            int last = std::min(first + HEAP_ARITY, count);
+            int child = first;
+            for (int c = first + 1; c < last; ++c) {
+                if (heap[c].cost < heap[child].cost)
+                    child = c;
+            }
+            if (entry.cost <= heap[child].cost)
+                break;
+            Place(i, heap[child]);
+            i = child;
+        }
+        Place(i, entry);
+    }
+
+    size_t Decimator::Run(size_t targetTriangles, double maxCost, std::atomic<float>* progress, const std::atomic<bool>* cancel) {
+        TRACE_SCOPE("Decimate Collapse");
+        size_t halfEdgeCount = edges.size();
+        heap.clear();
+        heap.reserve(halfEdgeCount / 2);
+        for (size_t h = 0; h < halfEdgeCount; ++h) {
+            if (edges[h].origin >= 0 && Key((int)h) == (int)h)
+                UpdateEdge((int)h);
+        }
+
+        size_t startTriangles = liveTriangles;
+        size_t toRemove = startTriangles > targetTriangles ? startTriangles - targetTriangles : 0;
+        size_t steps = 0;
+        while (liveTriangles > targetTriangles && !heap.empty()) {
+            if (++steps % CANCEL_INTERVAL == 0) {
+                if (cancel && cancel->load(std::memory_order_relaxed))
+                    break;
+                if (progress)
+                    progress->store((float)(startTriangles - liveTriangles) / toRemove, std::memory_order_relaxed);
+            }
+            int key = heap[0].key;
+            if (maxCost > 0.0 && heap[0].cost > maxCost)
+                break;
+            HeapRemove(key);
+            if (!LinkCondition(key))
+                continue;
+
+            int u = edges[key].origin, v = edges[NextEdge(key)].origin;
+            int removedVertex = edges[key].removesOrigin ? u : v;
+            int keptVertex = edges[key].removesOrigin ? v : u;
+            if (FoldsOver(removedVertex, keptVertex)) {
+                //the dearer direction goes back in the queue at its own cost when it doesn't fold anything
+                if (edges[key].pinned || !CanRemove(key, keptVertex) || FoldsOver(keptVertex, removedVertex))
+                    continue;
+                edges[key].removesOrigin = !edges[key].removesOrigin;
+                edges[key].pinned = 1;
+                HeapPush(key, (float)EdgeCost(key));
+                continue;
+            }
+            Collapse(key, removedVertex, keptVertex);
+        }
+        if (progress)
+            progress->store(1.0f, std::memory_order_relaxed);
+        return liveTriangles;
+    }
+
+    /// <summary>
+    /// Compacts the live triangles and vertices into MeshArrays, keeping their order
+    /// </summary>
+    void Decimator::WriteArrays(MeshArrays& out) const {
+        TRACE_SCOPE("Decimate Compact");
+        size_t triangleCount = edges.size() / 3;
+        std::vector<int> faceIndex(triangleCount, -1);
+        int faceCount = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (edges[3 * t].origin >= 0)
+                faceIndex[t] = faceCount++;
+        }
+
+        std::vector<char> used(vertices.size(), 0);
+        for (size_t h = 0; h < edges.size(); ++h) {
+            if (edges[h].origin >= 0)
+                used[edges[h].origin] = 1;
+        }
+        std::vector<int> vertexIndex(vertices.size(), -1);
+        int vertexCount = 0;
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if (!vertices[v].removed && (used[v] || vertices[v].isolated))
+                vertexIndex[v] = vertexCount++;
+        }
+
+        out.positions.resize(vertexCount);
+        out.vertexEdge.assign(vertexCount, -1);
+        out.faceEdge.resize(faceCount);
+        out.next.resize(3 * (size_t)faceCount);
+        out.twin.resize(3 * (size_t)faceCount);
+        out.origin.resize(3 * (size_t)faceCount);
+        out.face.resize(3 * (size_t)faceCount);
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if (vertexIndex[v] >= 0)
+                out.positions[vertexIndex[v]] = vertices[v].position;
+        }
+        ParallelFor(triangleCount, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                int f = faceIndex[t];
+                if (f < 0)
+                    continue;
+                out.faceEdge[f] = 3 * f;
+                for (int k = 0; k < 3; ++k) {
+                    int h = 3 * f + k;
+                    int old = edges[3 * t + k].twin;
+                    out.origin[h] = vertexIndex[edges[3 * t + k].origin];
+                    out.next[h] = 3 * f + (k + 1) % 3;
+                    out.face[h] = f;
+                    out.twin[h] = old < 0 ? -1 : 3 * faceIndex[old / 3] + old % 3;
+                }
+            }
+        });
+        for (size_t h = 0; h < out.origin.size(); ++h)
+            out.vertexEdge[out.origin[h]] = (int)h;
+    }
+}
+
+size_t DecimateArrays(MeshArrays& arrays, const DecimateOptions& options,
+    std::atomic<float>* progress, const std::atomic<bool>* cancel)
+{
+    TRACE_SCOPE("Decimate");
+    if (progress)
+        progress->store(0.0f, std::memory_order_relaxed);
+    Decimator decimator;
+    decimator.Triangulate(arrays);
+    size_t triangleCount = decimator.edges.size() / 3;
+    float ratio = std::min(std::max(options.ratio, 0.0f), 1.0f);
+    size_t target = (size_t)std::ceil(triangleCount * (double)ratio);
+    decimator.ComputeQuadrics(options.preserveFeatures);
+    double maxCost = (double)options.maxError * options.maxError;
+    size_t faceCount = decimator.Run(target, maxCost, progress, cancel);
+    decimator.WriteArrays(arrays);
+    return faceCount;
+}
+
+size_t DecimateMesh(HalfEdgeMesh& mesh, const DecimateOptions& options,
+    std::atomic<float>* progress, const std::atomic<bool>* cancel)
+{
+    if (mesh.faces.empty())
+        return 0;
+    MeshArrays arrays;
+    MeshToArrays(mesh, arrays);
+    size_t faceCount = DecimateArrays(arrays, options, progress, cancel);
+    ArraysToMesh(arrays, mesh);
+    return faceCount;
+}
\ No newline at end of file
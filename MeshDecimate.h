@@ -0,0 +1,39 @@
+#pragma once
+
+#include "MeshArrays.h"
+#include <atomic>
+
+/// <summary>
+/// Where DecimateArrays stops and what it has to keep
+/// </summary>
+struct DecimateOptions {
+    /// <summary>
+    /// Fraction of the triangles to keep, faces with more corners count as the triangles of their fan
+    /// </summary>
+    float ratio = 0.5f;
+    /// <summary>
+    /// Stops before the cheapest collapse costs more than this, 0 for no bound. Compared against the root of the
+    /// quadric error, roughly how far the surface would move away from the planes of the original faces.
+    /// </summary>
+    float maxError = 0.0f;
+    /// <summary>
+    /// Holds edges sharper than FEATURE_EDGE_COSINE the way boundaries are held: collapses may slide along them but pay heavily to leave them
+    /// </summary>
+    bool preserveFeatures = true;
+};
+
+/// <summary>
+/// Reduces the arrays with quadric error edge collapses (Garland-Heckbert). Faces are split into fan triangles first,
+/// then every collapse relinks the handful of half edges around it in place and a mutable heap keeps each edge's
+/// cheaper direction up to date. Vertices only ever move onto a neighbour, boundary vertices only along the boundary,
+/// and collapses that break the link condition or fold a triangle over are skipped.
+/// progress goes from 0 to 1, setting cancel stops early with a valid, partly decimated mesh. Returns the face count.
+/// </summary>
+size_t DecimateArrays(MeshArrays& arrays, const DecimateOptions& options,
+    std::atomic<float>* progress = nullptr, const std::atomic<bool>* cancel = nullptr);
+
+/// <summary>
+/// DecimateArrays on an index copy of the mesh, the result replaces the mesh's elements without going through addFace
+/// </summary>
+size_t DecimateMesh(HalfEdgeMesh& mesh, const DecimateOptions& options,
+    std::atomic<float>* progress = nullptr, const std::atomic<bool>* cancel = nullptr);
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "MeshMirror.h"
+#include "MeshWeld.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+
+namespace {
+    /// <summary>
+    /// The set axes in order, outAxes[b] is the axis bit b of a copy index reflects across. Returns how many there are.
+    /// </summary>
+    int MirroredAxes(glm::bvec3 axes, int outAxes[3]) {
+        int count = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (axes[axis])
+                outAxes[count++] = axis;
+        }
+        return count;
+    }
+}
+
+void MirrorTransforms(glm::bvec3 axes, const glm::vec3& center, std::vector<glm::mat4>& outTransforms) {
+    int mirrored[3];
+    int count = MirroredAxes(axes, mirrored);
+    outTransforms.assign((size_t)1 << count, glm::mat4(1.0f));
+    for (size_t i = 1; i < outTransforms.size(); ++i) {
+        glm::vec3 scale(1.0f);
+        for (int b = 0; b < count; ++b) {
+            if (i >> b & 1)
+                scale[mirrored[b]] = -1.0f;
+        }
+        outTransforms[i] = glm::translate(glm::mat4(1.0f), center) * glm::scale(glm::mat4(1.0f), scale)
+            * glm::translate(glm::mat4(1.0f), -center);
+    }
+}
+
+size_t MirrorArrays(const MeshArrays& source, glm::bvec3 axes, const glm::vec3& center, float distance, MeshArrays& result) {
+    TRACE_SCOPE("Mirror");
+    std::vector<glm::mat4> transforms;
+    MirrorTransforms(axes, center, transforms);
+    RepeatArrays(source, transforms, result);
+    size_t vertexCount = source.positions.size();
+    size_t copies = transforms.size();
+    if (copies == 1 || vertexCount == 0 || !(distance >= 0.0f))
+        return 0;
+
+    //seam[v] holds the index bits of the planes v lies on, its copies across those planes are all the same vertex
+    int mirrored[3];
+    int count = MirroredAxes(axes, mirrored);
+    std::vector<unsigned char> seam(vertexCount, 0);
+    std::atomic<bool> onSeam{ false };
+    ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+        bool any = false;
+        for (size_t v = begin; v < end; ++v) {
+            for (int b = 0; b < count; ++b) {
+                if (std::abs(source.positions[v][mirrored[b]] - center[mirrored[b]]) <= distance)
+                    seam[v] |= 1 << b;
+            }
+            any |= seam[v] != 0;
+        }
+        if (any)
+            onSeam.store(true, std::memory_order_relaxed);
+    });
+    if (!onSeam.load())
+        return 0;
+
+    //Every copy of a seam vertex welds into the copy with the seam bits cleared, which comes first, and is moved
+    //exactly onto the planes so the welded surface is symmetric
+    std::vector<int> target(vertexCount * copies);
+    ParallelFor(vertexCount * copies, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t c = i / vertexCount, v = i % vertexCount;
+            target[i] = (int)((c & ~(size_t)seam[v]) * vertexCount + v);
+            for (int b = 0; b < count; ++b) {
+                if (seam[v] >> b & 1)
+                    result.positions[i][mirrored[b]] = center[mirrored[b]];
+            }
+        }
+    });
+    HalfEdgeMesh mesh;
+    ArraysToMesh(result, mesh);
+    size_t merged = WeldVertices(mesh, target);
+    MeshToArrays(mesh, result);
+    return merged;
+}
\ No newline at end of file
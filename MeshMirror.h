@@ -0,0 +1,17 @@
+#pragma once
+
+#include "MeshArrays.h"
+
+/// <summary>
+/// Reflections across the planes through center normal to the axes set in axes, one for every combination of them.
+/// Bit b of a copy's index reflects it across the b-th set axis, so the first copy is the identity.
+/// </summary>
+void MirrorTransforms(glm::bvec3 axes, const glm::vec3& center, std::vector<glm::mat4>& outTransforms);
+
+/// <summary>
+/// Source and all its reflections as one mesh, reflected copies wound the other way so they still face outwards.
+/// Vertices within distance of a mirror plane are moved onto it and welded to their own reflections, so a half
+/// modelled up to the plane closes into one surface along the seam. Nothing away from the planes is welded.
+/// Returns the number of vertices merged away.
+/// </summary>
+size_t MirrorArrays(const MeshArrays& source, glm::bvec3 axes, const glm::vec3& center, float distance, MeshArrays& result);
\ No newline at end of file
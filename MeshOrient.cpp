@@ -0,0 +1,356 @@
+#include "MeshOrient.h"
+#include "BVH.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    /// <summary>
+    /// Face corners in index form, numbered face by face in loop order. Corner c is also the half edge leaving it.
+    /// </summary>
+    struct CornerTable {
+        std::vector<unsigned int> faceOffsets;
+        std::vector<unsigned int> vertex;
+        std::vector<unsigned int> face;
+        std::vector<HalfEdge*> edge;
+        /// <summary>
+        /// The other corner starting an edge when exactly two faces use it, in either direction. -1 on boundaries and non manifold edges.
+        /// </summary>
+        std::vector<int> opposite;
+
+        unsigned int NextCorner(unsigned int c) const {
+            unsigned int f = face[c];
+            return c + 1 < faceOffsets[f + 1] ? c + 1 : faceOffsets[f];
+        }
+    };
+
+    /// <summary>
+    /// A face a ray is cast from, the biggest faces of a piece are used
+    /// </summary>
+    struct Probe {
+        float area = -1.0f;
+        unsigned int face = 0;
+    };
+
+    void BuildCornerTable(const HalfEdgeMesh& mesh, CornerTable& table) {
+        TRACE_SCOPE("Orient Corners");
+        std::unordered_map<const Vertex*, unsigned int> vertexIndex;
+        vertexIndex.reserve(mesh.vertices.size());
+        for (size_t v = 0; v < mesh.vertices.size(); ++v)
+            vertexIndex.emplace(mesh.vertices[v].get(), (unsigned int)v);
+
+        size_t faceCount = mesh.faces.size();
+        table.faceOffsets.assign(faceCount + 1, 0);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                unsigned int corners = 0;
+                const HalfEdge* start = mesh.faces[f]->edge;
+                const HalfEdge* e = start;
+                do {
+                    corners++;
+                    e = e->next;
+                } while (e != start);
+                table.faceOffsets[f + 1] = corners;
+            }
+        });
+        for (size_t f = 0; f < faceCount; ++f)
+            table.faceOffsets[f + 1] += table.faceOffsets[f];
+
+        size_t cornerCount = table.faceOffsets[faceCount];
+        table.vertex.resize(cornerCount);
+        table.face.resize(cornerCount);
+        table.edge.resize(cornerCount);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                unsigned int c = table.faceOffsets[f];
+                HalfEdge* start = mesh.faces[f]->edge;
+                HalfEdge* e = start;
+                do {
+                    table.vertex[c] = vertexIndex.find(e->origin)->second;
+                    table.face[c] = (unsigned int)f;
+                    table.edge[c] = e;
+                    c++;
+                    e = e->next;
+                } while (e != start);
+            }
+        });
+
+        //Edges are matched on their undirected keys, so neighbours wound either way are found
+        std::vector<std::pair<uint64_t, unsigned int>> keys(cornerCount);
+        ParallelFor(cornerCount, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                unsigned int a = table.vertex[c], b = table.vertex[table.NextCorner((unsigned int)c)];
+                keys[c] = { (uint64_t)std::min(a, b) << 32 | std::max(a, b), (unsigned int)c };
+            }
+        });
+        std::sort(keys.begin(), keys.end());
+        table.opposite.assign(cornerCount, -1);
+        for (size_t i = 0; i < cornerCount;) {
+            size_t j = i;
+            while (j < cornerCount && keys[j].first == keys[i].first) j++;
+            if (j - i == 2) {
+                table.opposite[keys[i].second] = (int)keys[i + 1].second;
+                table.opposite[keys[i + 1].second] = (int)keys[i].second;
+            }
+            i = j;
+        }
+    }
+
+    /// <summary>
+    /// Grows the connected pieces breadth first, the faces of each frontier are expanded in parallel.
+    /// A face joins through whichever neighbour claims it first and flips when it runs the same way round
+    /// their shared edge as that neighbour. Returns the number of pieces.
+    /// </summary>
+    size_t FindPieces(const CornerTable& table, std::vector<int>& outPiece, std::vector<char>& outFlip) {
+        TRACE_SCOPE("Orient Pieces");
+        size_t faceCount = table.faceOffsets.size() - 1;
+        std::unique_ptr<std::atomic<int>[]> piece(new std::atomic<int>[faceCount]);
+        for (size_t f = 0; f < faceCount; ++f)
+            piece[f].store(-1, std::memory_order_relaxed);
+        outFlip.assign(faceCount, 0);
+
+        std::vector<unsigned int> frontier, next;
+        std::mutex nextMutex;
+        int pieceCount = 0;
+        for (size_t seed = 0; seed < faceCount; ++seed) {
+            if (piece[seed].load(std::memory_order_relaxed) >= 0)
+                continue;
+            int id = pieceCount++;
+            piece[seed].store(id, std::memory_order_relaxed);
+            frontier.assign(1, (unsigned int)seed);
+            while (!frontier.empty()) {
+                next.clear();
+                ParallelFor(frontier.size(), [&](size_t begin, size_t end) {
+                    std::vector<unsigned int> claimed;
+                    for (size_t i = begin; i < end; ++i) {
+                        unsigned int f = frontier[i];
+                        for (unsigned int c = table.faceOffsets[f]; c < table.faceOffsets[f + 1]; ++c) {
+                            int other = table.opposite[c];
+                            if (other < 0)
+                                continue;
+                            unsigned int g = table.face[other];
+                            int unclaimed = -1;
+                            if (!piece[g].compare_exchange_strong(unclaimed, id, std::memory_order_relaxed))
+                                continue;
+                            outFlip[g] = outFlip[f] ^ (table.vertex[c] == table.vertex[other]);
+                            claimed.push_back(g);
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(nextMutex);
+                    next.insert(next.end(), claimed.begin(), claimed.end());
+                }, 1024);
+                std::swap(frontier, next);
+            }
+        }
+
+        outPiece.resize(faceCount);
+        for (size_t f = 0; f < faceCount; ++f)
+            outPiece[f] = piece[f].load(std::memory_order_relaxed);
+        return (size_t)pieceCount;
+    }
+
+    /// <summary>
+    /// Per piece, true when most probe rays leaving along the normals cross the piece an odd number of times,
+    /// meaning the faces (with the winding FindPieces gave them) point inwards
+    /// </summary>
+    void FindInwardPieces(const HalfEdgeMesh& mesh, const CornerTable& table, const std::vector<int>& piece,
+        const std::vector<char>& flip, size_t pieceCount, std::vector<char>& outInward)
+    {
+        TRACE_SCOPE("Orient Rays");
+        size_t faceCount = piece.size();
+        auto position = [&](unsigned int c) -> const glm::vec3& {
+            return mesh.vertices[table.vertex[c]]->position;
+        };
+
+        //Newell normals with the new winding, twice the area long
+        std::vector<glm::vec3> normals(faceCount);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                glm::vec3 n(0.0f);
+                for (unsigned int c = table.faceOffsets[f]; c < table.faceOffsets[f + 1]; ++c)
+                    n += glm::cross(position(c), position(table.NextCorner(c)));
+                normals[f] = flip[f] ? -n : n;
+            }
+        });
+
+        std::vector<std::array<Probe, ORIENT_RAYS>> probes(pieceCount);
+        for (size_t f = 0; f < faceCount; ++f) {
+            std::array<Probe, ORIENT_RAYS>& best = probes[piece[f]];
+            Probe probe{ glm::length(normals[f]), (unsigned int)f };
+            for (int i = 0; i < ORIENT_RAYS && probe.area > 0.0f; ++i) {
+                if (probe.area > best[i].area)
+                    std::swap(probe, best[i]);
+            }
+        }
+
+        //Fan triangles like MeshToTriangles, face f starts at triangle faceOffsets[f] - 2f
+        size_t triangleCount = table.vertex.size() - 2 * faceCount;
+        std::vector<unsigned int> triangleCorners(triangleCount * 3);
+        std::vector<AABB> boxes(triangleCount);
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                unsigned int first = table.faceOffsets[f], last = table.faceOffsets[f + 1];
+                size_t t = first - 2 * f;
+                for (unsigned int c = first + 1; c + 1 < last; ++c, ++t) {
+                    unsigned int corners[3] = { first, c, c + 1 };
+                    for (int k = 0; k < 3; ++k) {
+                        triangleCorners[3 * t + k] = corners[k];
+                        boxes[t].Expand(position(corners[k]));
+                    }
+                }
+            }
+        });
+        BVH bvh;
+        bvh.Build(boxes);
+
+        AABB bounds = mesh.ComputeLocalBounds();
+        float offset = 1e-4f * glm::length(bounds.max - bounds.min);
+        //tilted slightly off the normal so rays don't run exactly along the edges of axis aligned geometry
+        const glm::vec3 tilt(0.0137f, 0.0071f, 0.0193f);
+        outInward.assign(pieceCount, 0);
+        ParallelFor(pieceCount, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                int cast = 0, inward = 0;
+                for (const Probe& probe : probes[p]) {
+                    if (probe.area <= 0.0f)
+                        continue;
+                    //The ray leaves from the largest fan triangle of the face along that triangle's own normal. The
+                    //centroid of a bent polygon lies off its triangles, a ray from there can cross its own face.
+                    unsigned int f = probe.face;
+                    size_t start = 0;
+                    float startArea = 0.0f;
+                    glm::vec3 n(0.0f), centroid(0.0f);
+                    for (size_t t = table.faceOffsets[f] - 2 * f; t < table.faceOffsets[f + 1] - 2 * (f + 1); ++t) {
+                        const unsigned int* corners = &triangleCorners[3 * t];
+                        glm::vec3 a = position(corners[0]), b = position(corners[1]), c = position(corners[2]);
+                        glm::vec3 normal = glm::cross(b - a, c - a);
+                        float area = glm::length(normal);
+                        if (area > startArea) {
+                            start = t;
+                            startArea = area;
+                            n = (flip[f] ? -normal : normal) / area;
+                            centroid = (a + b + c) / 3.0f;
+                        }
+                    }
+                    if (startArea <= 0.0f)
+                        continue;
+                    glm::vec3 origin = centroid + n * offset;
+                    glm::vec3 dir = glm::normalize(n + tilt);
+
+                    int crossings = 0;
+                    bvh.QueryRay(origin, dir, boxes, [&](uint32_t t) {
+                        const unsigned int* corners = &triangleCorners[3 * t];
+                        if (t == start || piece[table.face[corners[0]]] != (int)p)
+                            return;
+                        float hitT;
+                        if (HalfEdgeMesh::RayTriangle(origin, dir, position(corners[0]), position(corners[1]), position(corners[2]), hitT))
+                            crossings++;
+                    });
+                    cast++;
+                    inward += crossings & 1;
+                }
+                outInward[p] = inward * 2 > cast;
+            }
+        }, 64);
+    }
+}
+
+size_t RecalculateNormalsOutside(HalfEdgeMesh& mesh) {
+    TRACE_SCOPE("Recalculate Outside");
+    if (mesh.faces.empty())
+        return 0;
+    CornerTable table;
+    BuildCornerTable(mesh, table);
+    std::vector<int> piece;
+    std::vector<char> flip, inward;
+    size_t pieceCount = FindPieces(table, piece, flip);
+    FindInwardPieces(mesh, table, piece, flip, pieceCount, inward);
+
+    std::vector<Face*> selection;
+    for (size_t f = 0; f < mesh.faces.size(); ++f) {
+        if (flip[f] != inward[piece[f]])
+            selection.push_back(mesh.faces[f].get());
+    }
+    //twins are relinked below anyway, so the flip doesn't have to keep the edge map up to date
+    mesh.edgeMap = {};
+    mesh.edgeMapDirty = true;
+    mesh.FlipFaces(&selection);
+
+    //Every half edge kept its edge through the flip, so the pairs matched before are still the same edges.
+    //Pairs that now run opposite ways become twins, anything still running the same way as its twin is cut.
+    ParallelFor(table.edge.size(), [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            HalfEdge* he = table.edge[c];
+            int other = table.opposite[c];
+            if (other >= 0 && table.edge[other]->origin != he->origin)
+                he->twin = table.edge[other];
+            else if (he->twin && he->twin->origin == he->origin)
+                he->twin = nullptr;
+        }
+    });
+    return selection.size();
+}
+
+bool TrianglesFaceOutwards(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& remap,
+    const std::vector<unsigned int>& indices)
+{
+    TRACE_SCOPE("Outward Check");
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint64_t> edges;
+    edges.reserve(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        unsigned int c[3] = { remap[indices[3 * t]], remap[indices[3 * t + 1]], remap[indices[3 * t + 2]] };
+        //collapsed triangles have no inside, they're left out of everything
+        if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2])
+            continue;
+        for (int k = 0; k < 3; ++k)
+            edges.push_back((uint64_t)c[k] << 32 | c[(k + 1) % 3]);
+    }
+    if (edges.empty())
+        return false;
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        uint64_t reverse = edges[i] << 32 | edges[i] >> 32;
+        if ((i + 1 < edges.size() && edges[i + 1] == edges[i]) || !std::binary_search(edges.begin(), edges.end(), reverse))
+            return false;
+    }
+
+    //Pieces are joined through their vertices, a consistently wound closed piece facing out has a positive volume
+    std::vector<unsigned int> parent(positions.size());
+    for (size_t v = 0; v < parent.size(); ++v)
+        parent[v] = (unsigned int)v;
+    auto find = [&](unsigned int v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (uint64_t edge : edges) {
+        unsigned int a = find((unsigned int)(edge >> 32)), b = find((unsigned int)(edge & 0xFFFFFFFF));
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+    //relative to one point of the piece, so far away meshes don't lose the volume to rounding
+    std::vector<double> volume(positions.size(), 0.0);
+    std::vector<char> used(positions.size(), 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        unsigned int a = remap[indices[3 * t]], b = remap[indices[3 * t + 1]], c = remap[indices[3 * t + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        unsigned int root = find(a);
+        glm::dvec3 origin(positions[root]);
+        glm::dvec3 pa = glm::dvec3(positions[a]) - origin, pb = glm::dvec3(positions[b]) - origin, pc = glm::dvec3(positions[c]) - origin;
+        volume[root] += glm::dot(pa, glm::cross(pb, pc));
+        used[root] = 1;
+    }
+    for (size_t v = 0; v < positions.size(); ++v) {
+        if (used[v] && !(volume[v] > 0.0))
+            return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+
+/// <summary>
+/// Rays cast per connected piece when deciding whether it faces outwards, the majority wins
+/// </summary>
+const int ORIENT_RAYS = 5;
+
+/// <summary>
+/// Gives every connected piece of the mesh one consistent winding and then turns it to face outwards.
+/// Pieces are grown across edges used by exactly two faces in either direction, so wrongly wound neighbours
+/// (which addFace leaves without twins) are still connected. Whether a piece faces in or out is decided by ray parity:
+/// a ray leaving a face along its normal crosses the piece an even number of times when the normal points out.
+/// Twins of the fixed edges are linked afterwards and edgeMap is left to be rebuilt. Returns the number of flipped faces.
+/// </summary>
+size_t RecalculateNormalsOutside(HalfEdgeMesh& mesh);
+
+/// <summary>
+/// True when an indexed triangle list is closed, consistently wound and every connected piece of it encloses a
+/// positive volume, so its normals all point out. remap maps each index to a canonical one at the same position, as
+/// WeldPositions gives it, so duplicated render vertices are joined. Every directed edge has to be matched by exactly
+/// one running the other way.
+/// </summary>
+bool TrianglesFaceOutwards(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& remap,
+    const std::vector<unsigned int>& indices);
\ No newline at end of file
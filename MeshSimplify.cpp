@@ -0,0 +1,287 @@
+#include "MeshSimplify.h"
+#include "Trace.h"
+#include <unordered_map>
+#include <queue>
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+
+namespace {
+    /// <summary>
+    /// Collapses that would turn a triangle's normal by more than this (as a cosine) are rejected
+    /// </summary>
+    const double FLIP_COSINE = 0.2;
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const noexcept {
+            uint32_t x, y, z;
+            std::memcpy(&x, &p.x, sizeof(float));
+            std::memcpy(&y, &p.y, sizeof(float));
+            std::memcpy(&z, &p.z, sizeof(float));
+            return (size_t)x * 73856093u ^ (size_t)y * 19349663u ^ (size_t)z * 83492791u;
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse& other) const {
+            return cost > other.cost;
+        }
+    };
+}
+
+size_t WeldPositions(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& outRemap) {
+    outRemap.resize(positions.size());
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> firstIndex;
+    firstIndex.reserve(positions.size());
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        // adding zero turns -0 into +0 so both hash the same
+        auto [it, inserted] = firstIndex.emplace(positions[i] + glm::vec3(0.0f), (unsigned int)i);
+        outRemap[i] = it->second;
+        if (inserted)
+            uniqueCount++;
+    }
+    return uniqueCount;
+}
+
+size_t SimplifyTriangles(const std::vector<glm::vec3>& positions,
+    const std::vector<unsigned int>& indices,
+    size_t targetIndexCount,
+    std::vector<unsigned int>& outIndices,
+    const std::atomic<bool>* cancel,
+    const std::vector<unsigned char>* edgeFlags,
+    std::vector<unsigned char>* outEdgeFlags)
+{
+    TRACE_SCOPE("Simplify");
+    outIndices.clear();
+    if (outEdgeFlags)
+        outEdgeFlags->clear();
+    //the setup passes are long on big meshes too, a cancelled run stops between them
+    auto cancelled = [&] { return cancel && cancel->load(std::memory_order_relaxed); };
+    size_t vertexCount = positions.size();
+    size_t triangleCount = indices.size() / 3;
+
+    //Work on welded positions, the canonical index of a position is also a vertex at that position
+    std::vector<unsigned int> remap;
+    WeldPositions(positions, remap);
+    std::vector<unsigned int> corners(triangleCount * 3);
+    //render vertex each corner outputs, only changes once the corner is moved
+    std::vector<unsigned int> outputCorners(indices.begin(), indices.begin() + triangleCount * 3);
+    for (size_t i = 0; i < corners.size(); ++i)
+        corners[i] = remap[indices[i]];
+    if (cancelled())
+        return 0;
+
+    auto triangleNormal = [&](unsigned int a, unsigned int b, unsigned int c) {
+        glm::dvec3 pa(positions[a]), pb(positions[b]), pc(positions[c]);
+        return glm::cross(pb - pa, pc - pa);
+    };
+
+    std::vector<char> triangleAlive(triangleCount, 1);
+    std::vector<Quadric> quadrics(vertexCount);
+    size_t liveTriangles = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        unsigned int a = corners[3 * t], b = corners[3 * t + 1], c = corners[3 * t + 2];
+        glm::dvec3 n = triangleNormal(a, b, c);
+        double length = glm::length(n);
+        if (a == b || b == c || a == c || length <= 0.0) {
+            triangleAlive[t] = 0;
+            continue;
+        }
+        liveTriangles++;
+        n /= length;
+        double d = -glm::dot(n, glm::dvec3(positions[a]));
+        // area weighted so large flat regions resist being moved off their plane
+        double area = length * 0.5;
+        quadrics[a].AddPlane(n, d, area);
+        quadrics[b].AddPlane(n, d, area);
+        quadrics[c].AddPlane(n, d, area);
+    }
+
+    if (cancelled())
+        return 0;
+
+    std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (!triangleAlive[t]) continue;
+        for (int k = 0; k < 3; ++k)
+            vertexTriangles[corners[3 * t + k]].push_back((unsigned int)t);
+    }
+
+    //Lock boundary and non manifold vertices, an edge used by exactly two triangles is interior
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::vector<uint64_t> edgeKeys;
+        edgeKeys.reserve(liveTriangles * 3);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (!triangleAlive[t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int a = corners[3 * t + k], b = corners[3 * t + (k + 1) % 3];
+                edgeKeys.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edgeKeys.begin(), edgeKeys.end());
+        for (size_t i = 0; i < edgeKeys.size();) {
+            size_t j = i;
+            while (j < edgeKeys.size() && edgeKeys[j] == edgeKeys[i]) j++;
+            if (j - i != 2) {
+                locked[edgeKeys[i] >> 32] = 1;
+                locked[edgeKeys[i] & 0xFFFFFFFF] = 1;
+            }
+            i = j;
+        }
+    }
+
+    if (cancelled())
+        return 0;
+
+    std::vector<unsigned int> versions(vertexCount, 0);
+    std::vector<char> vertexAlive(vertexCount, 1);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    auto collapseCost = [&](unsigned int from, unsigned int to) {
+        Quadric q = quadrics[from];
+        q += quadrics[to];
+        return q.Evaluate(glm::dvec3(positions[to]));
+    };
+    //queue the cheaper direction of an edge
+    auto pushEdge = [&](unsigned int a, unsigned int b) {
+        bool aMovable = !locked[a], bMovable = !locked[b];
+        if (!aMovable && !bMovable) return;
+        double costAB = aMovable ? collapseCost(a, b) : DBL_MAX;
+        double costBA = bMovable ? collapseCost(b, a) : DBL_MAX;
+        if (costAB <= costBA)
+            queue.push({ costAB, a, b, versions[a], versions[b] });
+        else
+            queue.push({ costBA, b, a, versions[b], versions[a] });
+    };
+
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (!triangleAlive[t]) continue;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int a = corners[3 * t + k], b = corners[3 * t + (k + 1) % 3];
+            //each interior edge is seen from both triangles, queue it once
+            if (a < b || locked[a] || locked[b])
+                pushEdge(a, b);
+        }
+    }
+
+    if (cancelled())
+        return 0;
+
+    std::vector<unsigned int> fromNeighbors, toNeighbors;
+    auto gatherNeighbors = [&](unsigned int v, std::vector<unsigned int>& out) {
+        out.clear();
+        for (unsigned int t : vertexTriangles[v]) {
+            if (!triangleAlive[t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                if (corners[3 * t + k] != v)
+                    out.push_back(corners[3 * t + k]);
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    size_t iterations = 0;
+    while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+        if (cancel && (++iterations & 1023) == 0 && cancel->load(std::memory_order_relaxed))
+            break;
+
+        Collapse collapse = queue.top();
+        queue.pop();
+        unsigned int u = collapse.from, v = collapse.to;
+        if (!vertexAlive[u] || !vertexAlive[v] || versions[u] != collapse.fromVersion || versions[v] != collapse.toVersion)
+            continue;
+
+        //Link condition: the shared neighbours have to be exactly the opposite corners of the shared triangles,
+        //otherwise the collapse pinches the surface into a non manifold
+        int sharedTriangles = 0;
+        for (unsigned int t : vertexTriangles[u]) {
+            if (!triangleAlive[t]) continue;
+            if (corners[3 * t] == v || corners[3 * t + 1] == v || corners[3 * t + 2] == v)
+                sharedTriangles++;
+        }
+        if (sharedTriangles == 0)
+            continue;
+        gatherNeighbors(u, fromNeighbors);
+        gatherNeighbors(v, toNeighbors);
+        size_t sharedNeighbors = 0;
+        for (size_t i = 0, j = 0; i < fromNeighbors.size() && j < toNeighbors.size();) {
+            if (fromNeighbors[i] < toNeighbors[j]) i++;
+            else if (fromNeighbors[i] > toNeighbors[j]) j++;
+            else { sharedNeighbors++; i++; j++; }
+        }
+        if (sharedNeighbors != (size_t)sharedTriangles)
+            continue;
+
+        //Reject collapses that fold a triangle over
+        bool flips = false;
+        for (unsigned int t : vertexTriangles[u]) {
+            if (!triangleAlive[t]) continue;
+            unsigned int c[3] = { corners[3 * t], corners[3 * t + 1], corners[3 * t + 2] };
+            if (c[0] == v || c[1] == v || c[2] == v) continue;
+            glm::dvec3 before = triangleNormal(c[0], c[1], c[2]);
+            for (auto& corner : c) {
+                if (corner == u) corner = v;
+            }
+            glm::dvec3 after = triangleNormal(c[0], c[1], c[2]);
+            double beforeLength = glm::length(before), afterLength = glm::length(after);
+            if (afterLength <= 0.0 || glm::dot(before, after) < FLIP_COSINE * beforeLength * afterLength) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        //Collapse u onto v
+        for (unsigned int t : vertexTriangles[u]) {
+            if (!triangleAlive[t]) continue;
+            bool hasV = corners[3 * t] == v || corners[3 * t + 1] == v || corners[3 * t + 2] == v;
+            if (hasV) {
+                triangleAlive[t] = 0;
+                liveTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (corners[3 * t + k] == u) {
+                    corners[3 * t + k] = v;
+                    outputCorners[3 * t + k] = v;
+                }
+            }
+            vertexTriangles[v].push_back(t);
+        }
+        vertexTriangles[u].clear();
+        vertexTriangles[u].shrink_to_fit();
+        vertexAlive[u] = 0;
+        quadrics[v] += quadrics[u];
+        versions[v]++;
+
+        auto& around = vertexTriangles[v];
+        around.erase(std::remove_if(around.begin(), around.end(),
+            [&](unsigned int t) { return !triangleAlive[t]; }), around.end());
+        for (unsigned int t : around) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int w = corners[3 * t + k];
+                if (w != v)
+                    pushEdge(v, w);
+            }
+        }
+    }
+
+    outIndices.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (!triangleAlive[t]) continue;
+        outIndices.push_back(outputCorners[3 * t]);
+        outIndices.push_back(outputCorners[3 * t + 1]);
+        outIndices.push_back(outputCorners[3 * t + 2]);
+        if (edgeFlags && outEdgeFlags)
+            outEdgeFlags->push_back((*edgeFlags)[t]);
+    }
+    return outIndices.size();
+}
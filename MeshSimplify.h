@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <atomic>
+
+/// <summary>
+/// Symmetric 4x4 error quadric (Garland-Heckbert), the sum of squared distances to a set of planes.
+/// </summary>
+struct Quadric {
+    // upper triangle of the matrix, row major
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void AddPlane(const glm::dvec3& n, double d, double weight) {
+        a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+        a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+        a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+        a33 += weight * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        return *this;
+    }
+
+    double Evaluate(const glm::dvec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+            + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+            + a22 * z * z + 2 * a23 * z
+            + a33;
+        return error > 0.0 ? error : 0.0;
+    }
+};
+
+/// <summary>
+/// Maps every position to the first index with the exact same position, so duplicated render vertices
+/// (flat shading) are treated as one. Returns the number of unique positions.
+/// </summary>
+size_t WeldPositions(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& outRemap);
+
+/// <summary>
+/// Reduces an indexed triangle list to about targetIndexCount indices with quadric error edge collapses.
+/// Collapses only move vertices onto existing ones so the result indexes the same vertex buffer.
+/// Boundary vertices are kept in place. Returns the final index count, stops early when cancel is set.
+/// edgeFlags optionally holds a byte per triangle whose bit k marks the edge from corner k to corner k + 1 as a
+/// polygon edge rather than a triangulation diagonal. Triangles keep their corner order through the collapses,
+/// so outEdgeFlags gets the bytes of the surviving triangles in the order of outIndices.
+/// </summary>
+size_t SimplifyTriangles(const std::vector<glm::vec3>& positions,
+    const std::vector<unsigned int>& indices,
+    size_t targetIndexCount,
+    std::vector<unsigned int>& outIndices,
+    const std::atomic<bool>* cancel = nullptr,
+    const std::vector<unsigned char>* edgeFlags = nullptr,
+    std::vector<unsigned char>* outEdgeFlags = nullptr);
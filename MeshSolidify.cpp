@@ -0,0 +1,79 @@
+#include "MeshSolidify.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+
+void SolidifyArrays(MeshArrays& arrays, float thickness) {
+    TRACE_SCOPE("Solidify");
+    size_t vertexCount = arrays.positions.size();
+    size_t faceCount = arrays.faceEdge.size();
+    if (faceCount == 0)
+        return;
+
+    //Newell normals, their length is twice the face area
+    std::vector<glm::vec3> faceNormals(faceCount);
+    ParallelFor(faceCount, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            glm::vec3 normal(0.0f);
+            int h = arrays.faceEdge[f];
+            do {
+                glm::vec3 a = arrays.positions[arrays.origin[h]], b = arrays.positions[arrays.origin[arrays.next[h]]];
+                normal += glm::vec3((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+                h = arrays.next[h];
+            } while (h != arrays.faceEdge[f]);
+            faceNormals[f] = normal;
+        }
+    });
+    std::vector<glm::vec3> vertexNormals(vertexCount, glm::vec3(0.0f));
+    for (size_t h = 0; h < arrays.next.size(); ++h)
+        vertexNormals[arrays.origin[h]] += faceNormals[arrays.face[h]];
+
+    //The copies come after the originals, vertex v's copy is v + vertexCount
+    std::vector<glm::vec3> positions(vertexCount * 2);
+    ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            float length = glm::length(vertexNormals[v]);
+            glm::vec3 offset = length > 0.0f ? vertexNormals[v] * (thickness / length) : glm::vec3(0.0f);
+            positions[v] = arrays.positions[v];
+            positions[v + vertexCount] = arrays.positions[v] + offset;
+        }
+    });
+
+    //Corner lists: the faces, their reversed copies, then one quad per boundary half edge
+    size_t edgeCount = arrays.next.size();
+    std::vector<uint32_t> faceStart;
+    std::vector<uint32_t> corners;
+    faceStart.reserve(faceCount * 2 + 1);
+    corners.reserve(edgeCount * 2);
+    faceStart.push_back(0);
+    for (size_t f = 0; f < faceCount; ++f) {
+        int h = arrays.faceEdge[f];
+        do {
+            corners.push_back((uint32_t)arrays.origin[h]);
+            h = arrays.next[h];
+        } while (h != arrays.faceEdge[f]);
+        faceStart.push_back((uint32_t)corners.size());
+    }
+    for (size_t f = 0; f < faceCount; ++f) {
+        uint32_t first = faceStart[f], last = faceStart[f + 1];
+        for (uint32_t c = last; c > first; --c)
+            corners.push_back(corners[c - 1] + (uint32_t)vertexCount);
+        faceStart.push_back((uint32_t)corners.size());
+    }
+    for (size_t h = 0; h < edgeCount; ++h) {
+        if (arrays.twin[h] >= 0)
+            continue;
+        uint32_t a = (uint32_t)arrays.origin[h], b = (uint32_t)arrays.origin[arrays.next[h]];
+        //runs b to a along the original side and a to b along the copy, against both faces' directions
+        corners.insert(corners.end(), { b, a, a + (uint32_t)vertexCount, b + (uint32_t)vertexCount });
+        faceStart.push_back((uint32_t)corners.size());
+    }
+    //Outwards the copies are the outer side, so the whole shell turns around: the originals reversed instead
+    if (thickness > 0.0f) {
+        ParallelFor(faceStart.size() - 1, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f)
+                std::reverse(corners.begin() + faceStart[f], corners.begin() + faceStart[f + 1]);
+        });
+    }
+    PolygonsToArrays(std::move(positions), faceStart, corners, arrays);
+}
\ No newline at end of file
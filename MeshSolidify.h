@@ -0,0 +1,10 @@
+#pragma once
+
+#include "MeshArrays.h"
+
+/// <summary>
+/// Gives the surface a thickness: every face gets an offset copy along the vertex normals wound the other way, and
+/// every boundary edge a quad joining it to its copy. Closed parts turn into two nested shells. Positive thickness
+/// goes out along the normals, negative goes in, and the shell faces outwards either way. Vertex normals are the area weighted normals of the faces around them.
+/// </summary>
+void SolidifyArrays(MeshArrays& arrays, float thickness);
\ No newline at end of file
@@ -0,0 +1,463 @@
+#include "MeshWeld.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+namespace {
+    /// <summary>
+    /// Bits per axis of a packed cell key, cells are widened on huge meshes so every coordinate fits
+    /// </summary>
+    const int CELL_BITS = 21;
+    const uint64_t EMPTY_KEY = ~(uint64_t)0;
+
+    /// <summary>
+    /// Open addressing table from 64 bit keys to slots that several threads can insert into at once.
+    /// Nothing is ever removed, so a slot stays with its key and per slot data can live in plain arrays next to the table.
+    /// Sized for count keys at most two thirds full.
+    /// </summary>
+    class KeyTable {
+    public:
+        explicit KeyTable(size_t count) {
+            size_t capacity = 16;
+            while (capacity < count + count / 2)
+                capacity <<= 1;
+            mask = capacity - 1;
+            keys.reset(new std::atomic<uint64_t>[capacity]);
+            ParallelFor(capacity, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    keys[i].store(EMPTY_KEY, std::memory_order_relaxed);
+            });
+        }
+
+        size_t Capacity() const { return mask + 1; }
+
+        /// <summary>
+        /// Slot of key, claimed for it if it isn't in the table yet
+        /// </summary>
+        size_t Insert(uint64_t key) {
+            for (size_t slot = Hash(key) & mask;; slot = (slot + 1) & mask) {
+                uint64_t found = keys[slot].load(std::memory_order_relaxed);
+                if (found == EMPTY_KEY && keys[slot].compare_exchange_strong(found, key, std::memory_order_relaxed))
+                    return slot;
+                if (found == key)
+                    return slot;
+            }
+        }
+
+        /// <summary>
+        /// Slot of key or -1 when it was never inserted, only valid once the inserts are done
+        /// </summary>
+        long long Find(uint64_t key) const {
+            for (size_t slot = Hash(key) & mask;; slot = (slot + 1) & mask) {
+                uint64_t found = keys[slot].load(std::memory_order_relaxed);
+                if (found == key)
+                    return (long long)slot;
+                if (found == EMPTY_KEY)
+                    return -1;
+            }
+        }
+
+    private:
+        static uint64_t Hash(uint64_t key) {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdull;
+            key ^= key >> 33;
+            key *= 0xc4ceb9fe1a85ec53ull;
+            return key ^ (key >> 33);
+        }
+
+        size_t mask = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> keys;
+    };
+
+    uint64_t CellKey(const glm::ivec3& cell) {
+        return (uint64_t)cell.x << (2 * CELL_BITS) | (uint64_t)cell.y << CELL_BITS | (uint64_t)cell.z;
+    }
+
+    uint64_t PointerKey(const void* p) {
+        return (uint64_t)(uintptr_t)p;
+    }
+
+    /// <summary>
+    /// Parents only ever point at lower indices, so halving the path on the way up is safe while other threads link roots
+    /// </summary>
+    int FindRoot(std::atomic<int>* parent, int v) {
+        while (true) {
+            int p = parent[v].load(std::memory_order_relaxed);
+            if (p == v)
+                return v;
+            int grandparent = parent[p].load(std::memory_order_relaxed);
+            if (grandparent != p)
+                parent[v].store(grandparent, std::memory_order_relaxed);
+            v = grandparent;
+        }
+    }
+
+    /// <summary>
+    /// Links the higher root under the lower one, every group ends up rooted at its first vertex whatever order the links came in
+    /// </summary>
+    void Unite(std::atomic<int>* parent, int a, int b) {
+        while (true) {
+            a = FindRoot(parent, a);
+            b = FindRoot(parent, b);
+            if (a == b)
+                return;
+            if (a < b)
+                std::swap(a, b);
+            int root = a;
+            if (parent[a].compare_exchange_strong(root, b, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    /// <summary>
+    /// A half edge touching a welded vertex that still has to find its twin, from and to are the new vertex indices
+    /// </summary>
+    struct LooseEdge {
+        HalfEdge* edge;
+        int from, to;
+    };
+
+    /// <summary>
+    /// Finds the group every vertex welds into, target[v] is the first vertex of v's group. Returns the number merged away.
+    /// </summary>
+    size_t FindWeldGroups(const HalfEdgeMesh& mesh, float distance, std::vector<int>& target) {
+        TRACE_SCOPE("Weld Groups");
+        size_t vertexCount = mesh.vertices.size();
+        AABB bounds = mesh.ComputeLocalBounds();
+        glm::vec3 extent = bounds.max - bounds.min;
+        float largest = std::max(extent.x, std::max(extent.y, extent.z));
+        float cellSize = std::max(4.0f * distance, largest / (float)((1 << CELL_BITS) - 4));
+        if (!(cellSize > 0.0f))
+            cellSize = 1.0f;
+        float inverse = 1.0f / cellSize;
+        float distance2 = distance * distance;
+        const int maxCell = (1 << CELL_BITS) - 2;
+        //Cells are offset by one so the neighbours of the first and last cells still have valid coordinates
+        auto cellOf = [&](const glm::vec3& local) {
+            return glm::clamp(glm::ivec3(glm::floor(local)) + 1, glm::ivec3(1), glm::ivec3(maxCell));
+        };
+
+        //Bucket the vertices, the table hands out a slot per occupied cell and a counting pass lays the cells out contiguously
+        std::vector<glm::vec3> positions(vertexCount);
+        std::vector<uint32_t> vertexCell(vertexCount);
+        KeyTable cells(vertexCount);
+        size_t capacity = cells.Capacity();
+        std::unique_ptr<std::atomic<uint32_t>[]> cursor(new std::atomic<uint32_t>[capacity]);
+        ParallelFor(capacity, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                cursor[i].store(0, std::memory_order_relaxed);
+        });
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                positions[v] = mesh.vertices[v]->position;
+                size_t slot = cells.Insert(CellKey(cellOf((positions[v] - bounds.min) * inverse)));
+                vertexCell[v] = (uint32_t)slot;
+                cursor[slot].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        std::vector<uint32_t> cellStart(capacity + 1);
+        cellStart[0] = 0;
+        for (size_t i = 0; i < capacity; ++i) {
+            cellStart[i + 1] = cellStart[i] + cursor[i].load(std::memory_order_relaxed);
+            cursor[i].store(cellStart[i], std::memory_order_relaxed);
+        }
+        //Vertices in cell order, so the search below walks memory in order instead of jumping between cells
+        std::vector<uint32_t> cellVertices(vertexCount);
+        std::vector<glm::vec3> sortedPositions(vertexCount);
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                uint32_t i = cursor[vertexCell[v]].fetch_add(1, std::memory_order_relaxed);
+                cellVertices[i] = (uint32_t)v;
+                sortedPositions[i] = positions[v];
+            }
+        });
+        positions = {};
+        vertexCell = {};
+
+        //The union find runs on the sorted order too, parent[i] is the parent of cellVertices[i]
+        std::unique_ptr<std::atomic<int>[]> parent(new std::atomic<int>[vertexCount]);
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                parent[i].store((int)i, std::memory_order_relaxed);
+        });
+        //A cell is four times the distance wide, so anything close enough is in the vertex's own cell or in the neighbours
+        //across the faces it is within distance of. Both vertices of a pair find each other this way, the first one links them.
+        float reach = distance * inverse;
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const glm::vec3& p = sortedPositions[i];
+                glm::vec3 local = (p - bounds.min) * inverse;
+                glm::ivec3 cell = cellOf(local);
+                //the rest of the own cell follows directly
+                for (size_t j = i + 1; j < vertexCount && cellOf((sortedPositions[j] - bounds.min) * inverse) == cell; ++j) {
+                    glm::vec3 d = sortedPositions[j] - p;
+                    if (glm::dot(d, d) <= distance2)
+                        Unite(parent.get(), (int)i, (int)j);
+                }
+
+                glm::vec3 inCell = local - glm::vec3(cell - 1);
+                glm::ivec3 side(0);
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (inCell[axis] <= reach)
+                        side[axis] = -1;
+                    else if (inCell[axis] >= 1.0f - reach)
+                        side[axis] = 1;
+                }
+                if (side == glm::ivec3(0))
+                    continue;
+                for (int corner = 1; corner < 8; ++corner) {
+                    if ((corner & 1 && !side.x) || (corner & 2 && !side.y) || (corner & 4 && !side.z))
+                        continue;
+                    glm::ivec3 neighbour = cell + glm::ivec3(corner & 1 ? side.x : 0, corner & 2 ? side.y : 0, corner & 4 ? side.z : 0);
+                    long long slot = cells.Find(CellKey(neighbour));
+                    if (slot < 0)
+                        continue;
+                    for (uint32_t j = std::max(cellStart[slot], (uint32_t)i + 1); j < cellStart[slot + 1]; ++j) {
+                        glm::vec3 d = sortedPositions[j] - p;
+                        if (glm::dot(d, d) <= distance2)
+                            Unite(parent.get(), (int)i, (int)j);
+                    }
+                }
+            }
+        });
+
+        //Cells were filled in whatever order the threads got to them, so the group keeps its lowest vertex index
+        std::vector<int> roots(vertexCount);
+        std::unique_ptr<std::atomic<int>[]> first(new std::atomic<int>[vertexCount]);
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                roots[i] = FindRoot(parent.get(), (int)i);
+                first[i].store(INT_MAX, std::memory_order_relaxed);
+            }
+        });
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                std::atomic<int>& lowest = first[roots[i]];
+                int current = lowest.load(std::memory_order_relaxed);
+                while ((int)cellVertices[i] < current && !lowest.compare_exchange_weak(current, (int)cellVertices[i], std::memory_order_relaxed)) {}
+            }
+        });
+        target.resize(vertexCount);
+        std::atomic<size_t> merged{ 0 };
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            size_t count = 0;
+            for (size_t i = begin; i < end; ++i) {
+                int v = (int)cellVertices[i];
+                target[v] = first[roots[i]].load(std::memory_order_relaxed);
+                count += target[v] != v;
+            }
+            merged.fetch_add(count, std::memory_order_relaxed);
+        });
+        return merged.load();
+    }
+}
+
+size_t MergeByDistance(HalfEdgeMesh& mesh, float distance) {
+    TRACE_SCOPE("Merge By Distance");
+    if (mesh.vertices.size() < 2 || !(distance >= 0.0f))
+        return 0;
+    std::vector<int> target;
+    if (FindWeldGroups(mesh, distance, target) == 0)
+        return 0;
+    return WeldVertices(mesh, target);
+}
+
+size_t WeldVertices(HalfEdgeMesh& mesh, const std::vector<int>& target) {
+    TRACE_SCOPE("Weld Vertices");
+    size_t vertexCount = mesh.vertices.size();
+    size_t merged = 0;
+    for (size_t v = 0; v < vertexCount; ++v)
+        merged += target[v] != (int)v;
+    if (merged == 0)
+        return 0;
+
+    //Welded vertices and the ones they weld into, only faces with one of these as a corner change
+    std::vector<char> welded(vertexCount, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (target[v] != (int)v) {
+            welded[v] = 1;
+            welded[target[v]] = 1;
+        }
+    }
+
+    std::vector<HalfEdge*> deadEdges;
+    std::vector<LooseEdge> looseEdges;
+    size_t deadFaces = 0;
+    {
+        TRACE_SCOPE("Weld Faces");
+        KeyTable vertexTable(vertexCount);
+        std::vector<int> slotVertex(vertexTable.Capacity());
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v)
+                slotVertex[vertexTable.Insert(PointerKey(mesh.vertices[v].get()))] = (int)v;
+        });
+
+        //Every corner moves onto its group's first vertex. In touched faces the corners that landed on the vertex before
+        //them lose their (now zero length) edge, a face with fewer than 3 edges left goes entirely.
+        std::mutex resultMutex;
+        ParallelFor(mesh.faces.size(), [&](size_t begin, size_t end) {
+            std::vector<HalfEdge*> loop, dead;
+            std::vector<int> corners;
+            std::vector<size_t> kept;
+            std::vector<LooseEdge> loose;
+            size_t removedFaces = 0;
+            for (size_t f = begin; f < end; ++f) {
+                Face* face = mesh.faces[f].get();
+                loop.clear();
+                corners.clear();
+                bool touched = false;
+                HalfEdge* start = face->edge;
+                HalfEdge* e = start;
+                do {
+                    int v = target[slotVertex[vertexTable.Find(PointerKey(e->origin))]];
+                    e->origin = mesh.vertices[v].get();
+                    loop.push_back(e);
+                    corners.push_back(v);
+                    touched |= welded[v] != 0;
+                    e = e->next;
+                } while (e != start);
+                if (!touched)
+                    continue;
+
+                size_t n = loop.size();
+                kept.clear();
+                for (size_t k = 0; k < n; ++k) {
+                    if (corners[k] != corners[(k + 1) % n])
+                        kept.push_back(k);
+                }
+                if (kept.size() < 3) {
+                    for (HalfEdge* he : loop) {
+                        he->face = nullptr;
+                        dead.push_back(he);
+                    }
+                    face->edge = nullptr;
+                    removedFaces++;
+                    continue;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    if (corners[k] == corners[(k + 1) % n]) {
+                        loop[k]->face = nullptr;
+                        dead.push_back(loop[k]);
+                    }
+                }
+                //Dropped edges had no length, so the next kept edge starts where this one ends
+                for (size_t i = 0; i < kept.size(); ++i) {
+                    size_t k = kept[i];
+                    loop[k]->next = loop[kept[(i + 1) % kept.size()]];
+                    int to = corners[(k + 1) % n];
+                    if (welded[corners[k]] || welded[to])
+                        loose.push_back({ loop[k], corners[k], to });
+                }
+                face->edge = loop[kept[0]];
+            }
+            std::lock_guard<std::mutex> lock(resultMutex);
+            deadEdges.insert(deadEdges.end(), dead.begin(), dead.end());
+            looseEdges.insert(looseEdges.end(), loose.begin(), loose.end());
+            deadFaces += removedFaces;
+        }, 1024);
+    }
+
+    {
+        TRACE_SCOPE("Weld Twins");
+        //Edges away from the welded vertices keep their twins, unless the other half went with a removed face
+        for (HalfEdge* e : deadEdges) {
+            HalfEdge* twin = e->twin;
+            if (twin && twin->face && twin->twin == e)
+                twin->twin = nullptr;
+        }
+
+        //Both halves of an edge touching a welded vertex are loose. They are bucketed by their lower vertex, which only
+        //holds a handful of edges, and pairs running opposite ways become twins. Edges used by more than two faces or
+        //twice the same way stay open like FlipFaces leaves them.
+        size_t looseCount = looseEdges.size();
+        std::unique_ptr<std::atomic<uint32_t>[]> cursor(new std::atomic<uint32_t>[vertexCount]);
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v)
+                cursor[v].store(0, std::memory_order_relaxed);
+        });
+        ParallelFor(looseCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                cursor[std::min(looseEdges[i].from, looseEdges[i].to)].fetch_add(1, std::memory_order_relaxed);
+        });
+        std::vector<uint32_t> bucketStart(vertexCount + 1);
+        bucketStart[0] = 0;
+        for (size_t v = 0; v < vertexCount; ++v) {
+            bucketStart[v + 1] = bucketStart[v] + cursor[v].load(std::memory_order_relaxed);
+            cursor[v].store(bucketStart[v], std::memory_order_relaxed);
+        }
+        std::vector<uint32_t> buckets(looseCount);
+        ParallelFor(looseCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                buckets[cursor[std::min(looseEdges[i].from, looseEdges[i].to)].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)i;
+        });
+        ParallelFor(looseCount, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const LooseEdge& loose = looseEdges[i];
+                int low = std::min(loose.from, loose.to), high = std::max(loose.from, loose.to);
+                const LooseEdge* match = nullptr;
+                int uses = 0;
+                for (uint32_t j = bucketStart[low]; j < bucketStart[low + 1]; ++j) {
+                    const LooseEdge& other = looseEdges[buckets[j]];
+                    if (std::max(other.from, other.to) != high)
+                        continue;
+                    uses++;
+                    if (buckets[j] != i)
+                        match = &other;
+                }
+                loose.edge->twin = uses == 2 && match->from == loose.to ? match->edge : nullptr;
+            }
+        });
+
+        //Outgoing edges that were dropped are replaced, loose edges cover every vertex that was welded
+        for (const LooseEdge& loose : looseEdges) {
+            Vertex* origin = loose.edge->origin;
+            if (!origin->outgoing || !origin->outgoing->face)
+                origin->outgoing = loose.edge;
+        }
+        bool orphaned = false;
+        for (HalfEdge* e : deadEdges) {
+            if (e->origin->outgoing == e) {
+                e->origin->outgoing = nullptr;
+                orphaned = true;
+            }
+        }
+        if (orphaned) {
+            for (auto& he : mesh.halfEdges) {
+                if (he->face && !he->origin->outgoing)
+                    he->origin->outgoing = he.get();
+            }
+        }
+    }
+
+    if (!deadEdges.empty()) {
+        mesh.halfEdges.erase(std::remove_if(mesh.halfEdges.begin(), mesh.halfEdges.end(),
+            [](const ElementPtr<HalfEdge>& he) { return !he->face; }), mesh.halfEdges.end());
+    }
+    if (deadFaces > 0) {
+        mesh.faces.erase(std::remove_if(mesh.faces.begin(), mesh.faces.end(),
+            [](const ElementPtr<Face>& face) { return !face->edge; }), mesh.faces.end());
+    }
+    ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            if (target[v] != (int)v)
+                mesh.vertices[v].reset();
+        }
+    });
+    size_t kept = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (mesh.vertices[v])
+            mesh.vertices[kept++] = std::move(mesh.vertices[v]);
+    }
+    mesh.vertices.resize(kept);
+
+    mesh.edgeMap = {};
+    mesh.edgeMapDirty = true;
+    mesh.boundsDirty = true;
+    return merged;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+
+/// <summary>
+/// Welds every group of vertices closer than distance to each other (chains included) into the group's first vertex,
+/// for triangle soups and parts that were duplicated and joined without sharing any topology.
+/// Positions are bucketed into a hash grid of cells four times the distance wide, so each vertex only has to look past
+/// its own cell across the faces it is that close to, and the groups are found in parallel with a lock free union find.
+/// Only faces around welded vertices are touched: corners that end up on the same vertex are dropped, faces left
+/// with fewer than 3 corners are removed and twins are matched again along their edges. edgeMap is left to be rebuilt.
+/// Returns the number of vertices merged away.
+/// </summary>
+size_t MergeByDistance(HalfEdgeMesh& mesh, float distance);
+
+/// <summary>
+/// Welds every vertex v into target[v], which has to be the first vertex of v's group (target[target[v]] == target[v]
+/// and target[v] <= v). The face and twin repair of MergeByDistance for callers that already know which vertices
+/// belong together. Returns the number of vertices merged away.
+/// </summary>
+size_t WeldVertices(HalfEdgeMesh& mesh, const std::vector<int>& target);
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "ModifierStack.h"
+#include "Subdivision.h"
+#include "MeshSolidify.h"
+#include "MeshWeld.h"
+#include "MeshMirror.h"
+#include "Trace.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+
+namespace {
+    /// <summary>
+    /// 0 is never handed out, so a modifier that was never marked changed can't match a cached result
+    /// </summary>
+    std::atomic<unsigned int> nextModifierVersion{ 1 };
+}
+
+const char* ModifierTypeName(ModifierType type) {
+    switch (type) {
+    case ModifierType::Subdivision: return "Subdivision";
+    case ModifierType::Solidify: return "Solidify";
+    case ModifierType::Boolean: return "Boolean";
+    case ModifierType::Decimate: return "Decimate";
+    case ModifierType::Weld: return "Weld";
+    case ModifierType::Array: return "Array";
+    case ModifierType::Mirror: return "Mirror";
+    }
+    return "";
+}
+
+void CopyTransforms(const Modifier& modifier, std::vector<glm::mat4>& outTransforms) {
+    if (modifier.type == ModifierType::Mirror) {
+        MirrorTransforms(modifier.mirrorAxes, modifier.mirrorCenter, outTransforms);
+        return;
+    }
+    int count = std::max(1, modifier.count);
+    outTransforms.assign(count, glm::mat4(1.0f));
+    switch (modifier.arrayMode) {
+    case ArrayMode::Linear:
+        for (int i = 1; i < count; ++i)
+            outTransforms[i] = glm::translate(glm::mat4(1.0f), modifier.offset * (float)i);
+        break;
+    case ArrayMode::Radial: {
+        if (glm::length(modifier.axis) == 0.0f)
+            break;
+        bool fullTurn = std::abs(std::abs(modifier.angle) - 360.0f) < 1e-3f;
+        float step = modifier.angle / (fullTurn ? count : std::max(1, count - 1));
+        for (int i = 1; i < count; ++i) {
+            outTransforms[i] = glm::translate(glm::mat4(1.0f), modifier.offset * (float)i)
+                * glm::rotate(glm::mat4(1.0f), glm::radians(step * i), glm::normalize(modifier.axis));
+        }
+        break;
+    }
+    case ArrayMode::Curve: {
+        //without a path there's nowhere to put the copies
+        if (!modifier.operand || modifier.operand->vertices.size() < 2) {
+            outTransforms.resize(1);
+            break;
+        }
+        std::vector<glm::vec3> path;
+        path.reserve(modifier.operand->vertices.size() + 1);
+        for (const auto& v : modifier.operand->vertices)
+            path.push_back(glm::vec3(modifier.operandToLocal * glm::vec4(v->position, 1.0f)));
+        if (modifier.closedCurve)
+            path.push_back(path.front());
+        std::vector<float> length(path.size(), 0.0f);
+        for (size_t i = 1; i < path.size(); ++i)
+            length[i] = length[i - 1] + glm::distance(path[i - 1], path[i]);
+        //a closed path comes back to the first copy, an open one ends on the last
+        float spacing = length.back() / (modifier.closedCurve ? count : std::max(1, count - 1));
+        size_t segment = 1;
+        for (int i = 0; i < count; ++i) {
+            float s = std::min(spacing * i, length.back());
+            while (segment + 1 < path.size() && length[segment] < s)
+                segment++;
+            glm::vec3 a = path[segment - 1], b = path[segment];
+            float segmentLength = length[segment] - length[segment - 1];
+            float t = segmentLength > 0.0f ? (s - length[segment - 1]) / segmentLength : 0.0f;
+            glm::vec3 tangent = segmentLength > 0.0f ? (b - a) / segmentLength : glm::vec3(1.0f, 0.0f, 0.0f);
+            outTransforms[i] = glm::translate(glm::mat4(1.0f), glm::mix(a, b, t))
+                * glm::mat4_cast(glm::quat(glm::vec3(1.0f, 0.0f, 0.0f), tangent));
+        }
+        break;
+    }
+    }
+}
+
+void ModifierStack::Changed(size_t index) {
+    modifiers[index].version = nextModifierVersion.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ModifierStack::SetBase(std::shared_ptr<const MeshArrays> mesh) {
+    base = std::move(mesh);
+    baseVersion++;
+}
+
+size_t ModifierStack::FirstDirty() const {
+    size_t count = std::min(modifiers.size(), results.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i].baseVersion != baseVersion || results[i].version != modifiers[i].version
+            || modifiers[i].version == 0)
+            return i;
+    }
+    return count;
+}
+
+size_t ModifierStack::InstancedFrom() const {
+    size_t start = modifiers.size();
+    while (start > 0 && IsInstancedModifier(modifiers[start - 1]))
+        start--;
+    return start;
+}
+
+void ModifierStack::InstanceTransforms(std::vector<glm::mat4>& outTransforms) const {
+    outTransforms.clear();
+    std::vector<glm::mat4> copies, combined;
+    for (size_t i = InstancedFrom(); i < modifiers.size(); ++i) {
+        if (!modifiers[i].enabled)
+            continue;
+        CopyTransforms(modifiers[i], copies);
+        if (outTransforms.empty()) {
+            outTransforms = copies;
+            continue;
+        }
+        //later modifiers repeat everything before them
+        combined.clear();
+        for (const glm::mat4& copy : copies) {
+            for (const glm::mat4& inner : outTransforms) {
+                if (combined.size() == MODIFIER_MAX_INSTANCES)
+                    break;
+                combined.push_back(copy * inner);
+            }
+        }
+        outTransforms.swap(combined);
+    }
+    if (outTransforms.size() > MODIFIER_MAX_INSTANCES)
+        outTransforms.resize(MODIFIER_MAX_INSTANCES);
+}
+
+void ModifierStack::Store(size_t first, std::vector<ModifierResult> evaluated) {
+    if (FirstDirty() < first)
+        return;
+    //entries past the end belong to removed modifiers, new ones stay empty and never match
+    results.resize(modifiers.size());
+    for (size_t i = 0; i < evaluated.size() && first + i < modifiers.size(); ++i) {
+        //a modifier edited while the worker ran makes its result and everything after it stale
+        if (evaluated[i].baseVersion != baseVersion || evaluated[i].version != modifiers[first + i].version)
+            break;
+        results[first + i] = std::move(evaluated[i]);
+    }
+}
+
+std::shared_ptr<const MeshArrays> ApplyModifier(const Modifier& modifier, std::shared_ptr<const MeshArrays> input,
+    const std::atomic<bool>* cancel) {
+    if (!modifier.enabled || !input)
+        return input;
+    auto output = std::make_shared<MeshArrays>();
+    switch (modifier.type) {
+    case ModifierType::Subdivision:
+        *output = *input;
+        SubdivideArrays(*output, modifier.levels, modifier.creases);
+        break;
+    case ModifierType::Solidify:
+        *output = *input;
+        SolidifyArrays(*output, modifier.thickness);
+        break;
+    case ModifierType::Boolean: {
+        if (!modifier.operand)
+            return input;
+        HalfEdgeMesh mesh;
+        ArraysToMesh(*input, mesh);
+        MeshBoolean(mesh, *modifier.operand, modifier.operandToLocal, modifier.operation, *output);
+        break;
+    }
+    case ModifierType::Decimate:
+        *output = *input;
+        DecimateArrays(*output, modifier.decimate, nullptr, cancel);
+        break;
+    case ModifierType::Weld: {
+        HalfEdgeMesh mesh;
+        ArraysToMesh(*input, mesh);
+        MergeByDistance(mesh, modifier.distance);
+        MeshToArrays(mesh, *output);
+        break;
+    }
+    case ModifierType::Array: {
+        std::vector<glm::mat4> transforms;
+        CopyTransforms(modifier, transforms);
+        RepeatArrays(*input, transforms, *output);
+        if (!modifier.merge)
+            break;
+        HalfEdgeMesh mesh;
+        ArraysToMesh(*output, mesh);
+        MergeByDistance(mesh, modifier.distance);
+        MeshToArrays(mesh, *output);
+        break;
+    }
+    case ModifierType::Mirror:
+        MirrorArrays(*input, modifier.mirrorAxes, modifier.mirrorCenter, modifier.distance, *output);
+        break;
+    }
+    return output;
+}
+
+std::vector<ModifierResult> EvaluateModifiers(std::shared_ptr<const MeshArrays> input, const std::vector<Modifier>& modifiers,
+    size_t first, unsigned int baseVersion, const std::atomic<bool>* cancel) {
+    TRACE_SCOPE("Evaluate Modifiers");
+    std::vector<ModifierResult> results;
+    for (size_t i = first; i < modifiers.size(); ++i) {
+        if (cancel && cancel->load())
+            break;
+        ModifierResult result;
+        result.mesh = ApplyModifier(modifiers[i], input, cancel);
+        //a cancelled decimation hands back a partial mesh, it must not be cached
+        if (cancel && cancel->load())
+            break;
+        result.baseVersion = baseVersion;
+        result.version = modifiers[i].version;
+        input = result.mesh;
+        results.push_back(std::move(result));
+    }
+    return results;
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "MeshArrays.h"
+#include "MeshBoolean.h"
+#include "MeshDecimate.h"
+#include <atomic>
+#include <memory>
+
+enum class ModifierType {
+    Subdivision = 0,
+    Solidify = 1,
+    Boolean = 2,
+    Decimate = 3,
+    /// <summary>
+    /// Merge by Distance
+    /// </summary>
+    Weld = 4,
+    /// <summary>
+    /// Repeated copies, drawn as instances of its input while only other instanced modifiers follow it
+    /// </summary>
+    Array = 5,
+    /// <summary>
+    /// Reflected copies, drawn as instances like Array
+    /// </summary>
+    Mirror = 6
+};
+
+const int MODIFIER_TYPE_COUNT = 7;
+
+/// <summary>
+/// Instances drawn for one object at most, the smallest texture buffer GL guarantees (65536 texels) holds this many matrices
+/// </summary>
+const size_t MODIFIER_MAX_INSTANCES = 16384;
+
+enum class ArrayMode {
+    /// <summary>
+    /// Copy i is moved by i offsets
+    /// </summary>
+    Linear = 0,
+    /// <summary>
+    /// Copy i is turned around axis through the local origin by i steps, then moved by i offsets
+    /// </summary>
+    Radial = 1,
+    /// <summary>
+    /// Copies are spread evenly by length along the vertices of the operand object in order, local x along the path
+    /// </summary>
+    Curve = 2
+};
+
+const char* ModifierTypeName(ModifierType type);
+
+/// <summary>
+/// One entry of a modifier stack. The settings of every type sit side by side and only the ones of type are read,
+/// so the struct stays a plain value the worker can take a copy of.
+/// </summary>
+struct Modifier {
+    ModifierType type = ModifierType::Subdivision;
+    bool enabled = true;
+    /// <summary>
+    /// Unique over every modifier ever changed, see ModifierStack::Changed. Results are cached against it.
+    /// </summary>
+    unsigned int version = 0;
+    //Subdivision
+    int levels = 1;
+    bool creases = false;
+    //Solidify, along the vertex normals
+    float thickness = -0.1f;
+    //Boolean
+    BooleanOperation operation = BooleanOperation::Difference;
+    /// <summary>
+    /// Scene object the operand follows, only compared against and never dereferenced here
+    /// </summary>
+    const HalfEdgeMesh* operandSource = nullptr;
+    /// <summary>
+    /// Copy of the operand's geometry taken on the main thread, in its own local space
+    /// </summary>
+    std::shared_ptr<const HalfEdgeMesh> operand;
+    /// <summary>
+    /// Version of the operand object the snapshot was taken at, kept for whoever tracks it
+    /// </summary>
+    unsigned int operandVersion = 0;
+    glm::mat4 operandToLocal = glm::mat4(1.0f);
+    //Decimate
+    DecimateOptions decimate;
+    //Weld, and the seams of an applied array or mirror
+    float distance = 0.0001f;
+    //Array, a curve follows the operand
+    ArrayMode arrayMode = ArrayMode::Linear;
+    int count = 2;
+    glm::vec3 offset = glm::vec3(2.0f, 0.0f, 0.0f);
+    glm::vec3 axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    /// <summary>
+    /// Degrees a radial array covers, a full turn leaves the same gap after the last copy as between the others
+    /// </summary>
+    float angle = 360.0f;
+    bool closedCurve = false;
+    /// <summary>
+    /// Weld vertices of neighbouring copies closer than distance when the array is evaluated into geometry
+    /// </summary>
+    bool merge = false;
+    //Mirror, across the planes through mirrorCenter in local space
+    glm::bvec3 mirrorAxes = glm::bvec3(true, false, false);
+    glm::vec3 mirrorCenter = glm::vec3(0.0f);
+    /// <summary>
+    /// Keep mirrorCenter on the 3D cursor, whoever owns the stack moves it there
+    /// </summary>
+    bool mirrorAtCursor = false;
+};
+
+/// <summary>
+/// Drawn as instances rather than evaluated while every modifier after it is too. Disabled ones don't change anything.
+/// </summary>
+inline bool IsInstancedModifier(const Modifier& modifier) {
+    return !modifier.enabled || modifier.type == ModifierType::Array || modifier.type == ModifierType::Mirror;
+}
+
+/// <summary>
+/// Reads operand, so whoever owns the stack has to keep its snapshot current
+/// </summary>
+inline bool UsesOperand(const Modifier& modifier) {
+    return modifier.type == ModifierType::Boolean
+        || (modifier.type == ModifierType::Array && modifier.arrayMode == ArrayMode::Curve);
+}
+
+/// <summary>
+/// Copy transforms of an array or mirror modifier in the object's local space, the first is always the identity
+/// </summary>
+void CopyTransforms(const Modifier& modifier, std::vector<glm::mat4>& outTransforms);
+
+/// <summary>
+/// Output of one modifier and the version of every input it was evaluated from
+/// </summary>
+struct ModifierResult {
+    std::shared_ptr<const MeshArrays> mesh;
+    unsigned int baseVersion = 0;
+    unsigned int version = 0;
+};
+
+/// <summary>
+/// Modifiers applied in order on top of a base mesh, each keeps its last result so an edit only re-evaluates the
+/// modifiers from the changed one down. Results are shared and never written after they're made, so the worker
+/// evaluating the stack and the main thread can hold the same ones.
+/// </summary>
+struct ModifierStack {
+    std::vector<Modifier> modifiers;
+    /// <summary>
+    /// Cached output of modifiers[i], may be shorter than modifiers
+    /// </summary>
+    std::vector<ModifierResult> results;
+    /// <summary>
+    /// Snapshot of the base mesh the first modifier reads and the version it was taken at
+    /// </summary>
+    std::shared_ptr<const MeshArrays> base;
+    unsigned int baseVersion = 0;
+
+    bool empty() const {
+        return modifiers.empty();
+    }
+
+    /// <summary>
+    /// Call after any change to modifiers[index]'s settings
+    /// </summary>
+    void Changed(size_t index);
+
+    /// <summary>
+    /// Replaces the base snapshot, every cached result goes out of date
+    /// </summary>
+    void SetBase(std::shared_ptr<const MeshArrays> mesh);
+
+    /// <summary>
+    /// Index of the first modifier whose cached result is out of date, modifiers.size() when all of them are current
+    /// </summary>
+    size_t FirstDirty() const;
+
+    /// <summary>
+    /// What modifiers[index] reads: the previous result or the base
+    /// </summary>
+    std::shared_ptr<const MeshArrays> Input(size_t index) const {
+        return index == 0 ? base : results[index - 1].mesh;
+    }
+
+    /// <summary>
+    /// Start of the trailing run of instanced modifiers, only the modifiers before it are evaluated into geometry
+    /// </summary>
+    size_t InstancedFrom() const;
+
+    /// <summary>
+    /// Transforms the evaluated result is drawn with, every combination of the copies of the instanced modifiers.
+    /// Empty when there are none, capped at MODIFIER_MAX_INSTANCES.
+    /// </summary>
+    void InstanceTransforms(std::vector<glm::mat4>& outTransforms) const;
+
+    /// <summary>
+    /// Stores results evaluated from modifiers[first] on, unless the base or a modifier before them changed meanwhile
+    /// </summary>
+    void Store(size_t first, std::vector<ModifierResult> evaluated);
+};
+
+/// <summary>
+/// Runs one modifier. Disabled modifiers and ones missing their operand hand back their input unchanged.
+/// </summary>
+std::shared_ptr<const MeshArrays> ApplyModifier(const Modifier& modifier, std::shared_ptr<const MeshArrays> input,
+    const std::atomic<bool>* cancel = nullptr);
+
+/// <summary>
+/// Runs modifiers from first to the end on input, the output of modifiers[first - 1]. Setting cancel stops after the
+/// modifier being evaluated and returns the results so far.
+/// </summary>
+std::vector<ModifierResult> EvaluateModifiers(std::shared_ptr<const MeshArrays> input, const std::vector<Modifier>& modifiers,
+    size_t first, unsigned int baseVersion, const std::atomic<bool>* cancel = nullptr);
\ No newline at end of file
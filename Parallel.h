@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/// <summary>
+/// Ranges shorter than this per thread aren't worth starting a thread for
+/// </summary>
+const size_t PARALLEL_MIN_PER_TASK = 4096;
+
+/// <summary>
+/// Splits [0, count) into one contiguous range per hardware thread and calls fn(begin, end) on each.
+/// The calling thread takes the first range and everything has finished when this returns.
+/// fn must only write to elements of its own range.
+/// </summary>
+template <typename Fn>
+void ParallelFor(size_t count, const Fn& fn, size_t minPerTask = PARALLEL_MIN_PER_TASK) {
+    if (count == 0)
+        return;
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t tasks = std::min(threads, (count + minPerTask - 1) / minPerTask);
+    if (tasks <= 1) {
+        fn((size_t)0, count);
+        return;
+    }
+    size_t perTask = (count + tasks - 1) / tasks;
+    std::vector<std::thread> workers;
+    workers.reserve(tasks - 1);
+    for (size_t begin = perTask; begin < count; begin += perTask) {
+        size_t end = std::min(count, begin + perTask);
+        workers.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    fn((size_t)0, std::min(count, perTask));
+    for (auto& worker : workers)
+        worker.join();
+}
+
+/// <summary>
+/// Tasks started by RunDetached that haven't returned yet
+/// </summary>
+inline std::atomic<int> detachedTasks{ 0 };
+
+/// <summary>
+/// Runs fn(args...) on a thread of its own and returns the future of its result. Unlike with std::async, dropping the
+/// future doesn't wait for the task, so a job abandoned through its cancel flag winds down in the background.
+/// fn and args are moved into the task and must not refer to anything the caller might free.
+/// </summary>
+template <typename Fn, typename... Args>
+std::future<std::invoke_result_t<Fn&, Args&&...>> RunDetached(Fn fn, Args... args) {
+    using Result = std::invoke_result_t<Fn&, Args&&...>;
+    std::promise<Result> promise;
+    std::future<Result> future = promise.get_future();
+    detachedTasks.fetch_add(1);
+    std::thread([promise = std::move(promise), fn = std::move(fn), args = std::make_tuple(std::move(args)...)]() mutable {
+        try {
+            promise.set_value(std::apply(fn, std::move(args)));
+        }
+        catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+        detachedTasks.fetch_sub(1);
+    }).detach();
+    return future;
+}
+
+/// <summary>
+/// Blocks until every detached task has returned, for shutting down once their jobs have been cancelled
+/// </summary>
+inline void WaitForDetachedTasks() {
+    while (detachedTasks.load() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+#include "HalfEdgeMesh.h"
+
+//Builders add their faces to mesh, centered on the origin
+
+void BuildCube(HalfEdgeMesh& mesh, float size);
+
+void BuildCylinder(HalfEdgeMesh& mesh, int resolution, float radius, float height);
+
+void BuildCone(HalfEdgeMesh& mesh, int resolution, float radius, float height);
+
+void BuildCircle(HalfEdgeMesh& mesh, int resolution, float radius);
+
+/// <summary>
+/// Flat square of segmentsX * segmentsY quads in the xy plane, facing +z
+/// </summary>
+void BuildGrid(HalfEdgeMesh& mesh, int segmentsX, int segmentsY, float size);
\ No newline at end of file
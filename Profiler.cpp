@@ -0,0 +1,155 @@
+#include "Profiler.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cfloat>
+
+Profiler& Profiler::Get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Series& Profiler::GetSeries(const char* name, SeriesType type) {
+    auto it = seriesIndex.find(name);
+    if (it != seriesIndex.end())
+        return series[it->second];
+    seriesIndex[name] = (int)series.size();
+    series.emplace_back();
+    series.back().name = name;
+    series.back().type = type;
+    return series.back();
+}
+
+void Profiler::BeginFrame() {
+    if (!enabled) return;
+    //this buffer was last used two frames ago, read what finished and drop the rest rather than wait on it
+    gpuFrame ^= 1;
+    ResolveGpuFrame(gpuFrames[gpuFrame]);
+}
+
+void Profiler::ResolveGpuFrame(GpuFrame& frame) {
+    for (int i = 0; i < frame.used; ++i) {
+        GpuTimer& timer = frame.timers[i];
+        GLint available = 0;
+        glGetQueryObjectiv(timer.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(timer.queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(timer.queries[1], GL_QUERY_RESULT, &end);
+        Series& s = GetSeries(timer.name, SeriesType::Gpu);
+        s.current += (end - begin) * 1e-6;
+        s.gpuSampled = true;
+    }
+    frame.used = 0;
+
+    for (Series& s : series) {
+        if (s.type != SeriesType::Gpu || !s.gpuSampled)
+            continue;
+        s.history[s.gpuHead] = (float)s.current;
+        s.gpuHead = (s.gpuHead + 1) % HISTORY_FRAMES;
+        s.gpuCount = std::min(s.gpuCount + 1, HISTORY_FRAMES);
+        s.current = 0.0;
+        s.gpuSampled = false;
+    }
+}
+
+void Profiler::EndFrame() {
+    if (!enabled) return;
+    for (Series& s : series) {
+        if (s.type == SeriesType::Gpu)
+            continue;
+        s.history[historyHead] = (float)s.current;
+        s.current = 0.0;
+    }
+    historyHead = (historyHead + 1) % HISTORY_FRAMES;
+    frameCount = std::min(frameCount + 1, HISTORY_FRAMES);
+}
+
+void Profiler::AddCpuTime(const char* name, double seconds) {
+    if (!enabled) return;
+    GetSeries(name, SeriesType::Cpu).current += seconds * 1000.0;
+}
+
+void Profiler::AddCounter(const char* name, double value) {
+    if (!enabled) return;
+    GetSeries(name, SeriesType::Counter).current += value;
+}
+
+int Profiler::BeginGpu(const char* name) {
+    if (!enabled) return -1;
+    GpuFrame& frame = gpuFrames[gpuFrame];
+    if (frame.used == (int)frame.timers.size()) {
+        frame.timers.emplace_back();
+        glGenQueries(2, frame.timers.back().queries);
+    }
+    GpuTimer& timer = frame.timers[frame.used];
+    timer.name = name;
+    glQueryCounter(timer.queries[0], GL_TIMESTAMP);
+    return frame.used++;
+}
+
+void Profiler::EndGpu(int handle) {
+    if (handle < 0) return;
+    glQueryCounter(gpuFrames[gpuFrame].timers[handle].queries[1], GL_TIMESTAMP);
+}
+
+void Profiler::Shutdown() {
+    for (GpuFrame& frame : gpuFrames) {
+        for (GpuTimer& timer : frame.timers)
+            glDeleteQueries(2, timer.queries);
+        frame.timers.clear();
+        frame.used = 0;
+    }
+}
+
+void Profiler::DrawWindow() {
+    ImGui::Begin("Profiler");
+    ImGui::Checkbox("Enabled", &enabled);
+    bool tracing = Trace::enabled.load();
+    if (ImGui::Checkbox("Record Trace", &tracing))
+        Trace::enabled.store(tracing);
+    ImGui::SameLine();
+    if (ImGui::Button("Save Trace"))
+        traceSaved = Trace::WriteChromeTrace(tracePath) ? 1 : -1;
+    if (traceSaved != 0)
+        ImGui::Text(traceSaved > 0 ? "Saved %s" : "Could not write %s", tracePath.c_str());
+
+    std::vector<float> sorted;
+    auto drawGroup = [&](SeriesType type, const char* header, const char* unit) {
+        if (!ImGui::CollapsingHeader(header, ImGuiTreeNodeFlags_DefaultOpen))
+            return;
+        for (Series& s : series) {
+            if (s.type != type)
+                continue;
+            bool gpu = type == SeriesType::Gpu;
+            int count = gpu ? s.gpuCount : frameCount;
+            int head = gpu ? s.gpuHead : historyHead;
+            if (count == 0)
+                continue;
+
+            //the ring is full once count reaches HISTORY_FRAMES, before that it starts at 0
+            sorted.clear();
+            int start = count < HISTORY_FRAMES ? 0 : head;
+            for (int i = 0; i < count; ++i)
+                sorted.push_back(s.history[(start + i) % HISTORY_FRAMES]);
+            float last = sorted.back();
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&](float p) {
+                return sorted[std::min((size_t)(p * (sorted.size() - 1) + 0.5f), sorted.size() - 1)];
+            };
+
+            ImGui::Text("%s", s.name.c_str());
+            ImGui::Text("last %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f %s",
+                last, percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back(), unit);
+            ImGui::PushID(s.name.c_str());
+            ImGui::PlotHistogram("##history", s.history, count < HISTORY_FRAMES ? count : HISTORY_FRAMES,
+                start, nullptr, 0.0f, std::max(percentile(0.99f) * 1.2f, FLT_MIN), ImVec2(-1.0f, 40.0f));
+            ImGui::PopID();
+        }
+    };
+    drawGroup(SeriesType::Cpu, "CPU", "ms");
+    drawGroup(SeriesType::Gpu, "GPU", "ms");
+    drawGroup(SeriesType::Counter, "Counters", "");
+
+    ImGui::End();
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include "Trace.h"
+
+/// <summary>
+/// Frame profiler for CPU scopes, GPU passes and per frame counters, shown with DrawWindow.
+/// Main thread only.
+/// </summary>
+class Profiler {
+public:
+    /// <summary>
+    /// Frames of history kept per series
+    /// </summary>
+    static const int HISTORY_FRAMES = 240;
+
+    enum class SeriesType {
+        Cpu = 0,
+        Gpu = 1,
+        Counter = 2
+    };
+
+    struct Series {
+        std::string name;
+        SeriesType type = SeriesType::Cpu;
+        /// <summary>
+        /// Milliseconds for timers, raw values for counters, ring buffer indexed by Profiler::historyHead
+        /// </summary>
+        float history[HISTORY_FRAMES] = {};
+        /// <summary>
+        /// Sum of this frame's samples, pushed into history by EndFrame
+        /// </summary>
+        double current = 0.0;
+        /// <summary>
+        /// GPU results arrive frames late and only for frames that rendered, they get their own ring
+        /// </summary>
+        int gpuHead = 0;
+        int gpuCount = 0;
+        bool gpuSampled = false;
+    };
+
+    bool enabled = true;
+
+    static Profiler& Get();
+
+    void BeginFrame();
+
+    void EndFrame();
+
+    void AddCpuTime(const char* name, double seconds);
+
+    void AddCounter(const char* name, double value);
+
+    /// <summary>
+    /// Starts timing GPU work under name, returns a handle for EndGpu. Uses timestamp pairs so passes can sit
+    /// inside other GL_TIME_ELAPSED queries.
+    /// </summary>
+    int BeginGpu(const char* name);
+
+    void EndGpu(int handle);
+
+    void DrawWindow();
+
+    /// <summary>
+    /// Where the Save Trace button writes
+    /// </summary>
+    std::string tracePath = "trace.json";
+
+    /// <summary>
+    /// Deletes the GPU queries, has to run while the GL context still exists
+    /// </summary>
+    void Shutdown();
+
+private:
+    struct GpuTimer {
+        const char* name = nullptr;
+        GLuint queries[2] = { 0, 0 };
+    };
+    /// <summary>
+    /// Timers issued during one frame, the pool grows to the most timers a frame has used
+    /// </summary>
+    struct GpuFrame {
+        std::vector<GpuTimer> timers;
+        int used = 0;
+    };
+
+    std::vector<Series> series;
+    std::unordered_map<std::string, int> seriesIndex;
+    int historyHead = 0;
+    int frameCount = 0;
+    /// <summary>
+    /// Double buffered, a frame's queries are read back when its buffer comes around again
+    /// </summary>
+    GpuFrame gpuFrames[2];
+    int gpuFrame = 0;
+    /// <summary>
+    /// Result of the last Save Trace, 1 written, -1 failed, 0 not saved yet
+    /// </summary>
+    int traceSaved = 0;
+
+    Profiler() = default;
+
+    Series& GetSeries(const char* name, SeriesType type);
+
+    void ResolveGpuFrame(GpuFrame& frame);
+};
+
+/// <summary>
+/// Adds the time between construction and destruction to a CPU series, and to the trace while it records
+/// </summary>
+class ScopedCpuTimer {
+public:
+    explicit ScopedCpuTimer(const char* name) : name(name), start(Trace::Clock::now()) {}
+
+    ~ScopedCpuTimer() {
+        Trace::Clock::time_point end = Trace::Clock::now();
+        Profiler::Get().AddCpuTime(name, std::chrono::duration<double>(end - start).count());
+        if (Trace::enabled.load(std::memory_order_relaxed))
+            Trace::Record(name, start, end);
+    }
+
+private:
+    const char* name;
+    Trace::Clock::time_point start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+/// <summary>
+/// Times the rest of the enclosing scope under name, main thread only. Worker threads use TRACE_SCOPE.
+/// </summary>
+#define PROFILE_SCOPE(name) ScopedCpuTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
\ No newline at end of file
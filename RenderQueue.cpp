@@ -0,0 +1,193 @@
+#include "RenderQueue.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+RenderQueue::~RenderQueue() {
+    glDeleteVertexArrays(1, &edgeVao);
+    glDeleteVertexArrays(1, &boxVao);
+    glDeleteBuffers(1, &boxVbo);
+}
+
+void RenderQueue::Submit(Mesh* mesh, float depth) {
+    RenderPass facePass = mesh->ObjectColor.a < 1.0f ? RenderPass::Transparent : RenderPass::Opaque;
+    packets.push_back({ facePass, mesh, depth });
+    if (mesh->edgeOverlay != EdgeOverlay::Hidden)
+        packets.push_back({ RenderPass::Edges, mesh, depth });
+}
+
+void RenderQueue::SubmitBoundsProxy(Mesh* mesh, float depth) {
+    RenderPass facePass = mesh->ObjectColor.a < 1.0f ? RenderPass::Transparent : RenderPass::Opaque;
+    packets.push_back({ facePass, mesh, depth, true });
+}
+
+void RenderQueue::CreateBox() {
+    //normal, then two tangents with cross(u, v) == normal so the triangles wind counter clockwise from outside
+    const glm::vec3 axes[6][3] = {
+        { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+        { { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+        { { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },
+        { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+        { { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+        { { 0, 0, -1 }, { 0, 1, 0 }, { 1, 0, 0 } },
+    };
+    const glm::vec2 corners[6] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, -1 }, { 1, 1 }, { -1, 1 } };
+    std::vector<glm::vec3> vertexData;
+    for (const auto& face : axes) {
+        for (const auto& c : corners) {
+            vertexData.push_back((face[0] + face[1] * c.x + face[2] * c.y) * 0.5f);
+            vertexData.push_back(face[0]);
+        }
+    }
+
+    glGenVertexArrays(1, &boxVao);
+    glGenBuffers(1, &boxVbo);
+    glBindVertexArray(boxVao);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(glm::vec3), vertexData.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)sizeof(glm::vec3));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RenderQueue::Execute(Shader& objectShader, Shader& edgeShader) {
+    stats = RenderQueueStats();
+    stats.packets = (int)packets.size();
+    if (!edgeVao)
+        glGenVertexArrays(1, &edgeVao);
+    if (!boxVao)
+        CreateBox();
+
+    //Every mesh has its own buffers, so within a pass the only order that matters is depth.
+    //Opaque proxies all share the box buffers and go first.
+    std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+        if (a.pass != b.pass)
+            return a.pass < b.pass;
+        if (a.pass == RenderPass::Opaque && a.boundsProxy != b.boundsProxy)
+            return a.boundsProxy;
+        if (a.pass == RenderPass::Transparent)
+            return a.depth > b.depth;
+        if (a.pass == RenderPass::Edges)
+            return a.mesh < b.mesh;
+        return a.depth < b.depth;
+    });
+
+    //GL state isn't tracked between frames, other code (ImGui, the grid) changes it
+    currentProgram = 0;
+    currentVao = 0;
+    polygonOffset = false;
+    depthWrite = true;
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDepthMask(GL_TRUE);
+
+    static const char* passNames[] = { "Opaque Faces", "Edges", "Transparent Faces" };
+    RenderPass pass = RenderPass::Opaque;
+    bool passStarted = false;
+    int passTimer = -1;
+    for (const DrawPacket& packet : packets) {
+        if (!passStarted || packet.pass != pass) {
+            pass = packet.pass;
+            passStarted = true;
+            Profiler::Get().EndGpu(passTimer);
+            passTimer = Profiler::Get().BeginGpu(passNames[(int)pass]);
+            switch (pass) {
+            case RenderPass::Opaque:
+            case RenderPass::Transparent:
+                UseShader(objectShader);
+                objectShader.setBool("lightingEnabled", true);
+                objectShader.setInt("instanceTransforms", 2);
+                SetPolygonOffset(false);
+                SetDepthWrite(pass == RenderPass::Opaque);
+                break;
+            case RenderPass::Edges:
+                UseShader(edgeShader);
+                edgeShader.setInt("vertexData", 0);
+                edgeShader.setInt("edgeIndices", 1);
+                edgeShader.setInt("instanceTransforms", 2);
+                edgeShader.setFloat("lineWidth", 2.0f);
+                SetPolygonOffset(true);
+                SetDepthWrite(true);
+                BindVao(edgeVao);
+                break;
+            }
+        }
+
+        Mesh* mesh = packet.mesh;
+        if (!packet.boundsProxy && !mesh->instanceTransforms.empty()) {
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_BUFFER, mesh->instanceTexture);
+            stats.textureChanges++;
+        }
+        if (pass == RenderPass::Edges) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, mesh->vertexTexture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, mesh->edgeIndexTexture);
+            stats.textureChanges += 2;
+            stats.drawCalls += mesh->DrawEdges(edgeShader);
+        }
+        else if (packet.boundsProxy) {
+            BindVao(boxVao);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), mesh->worldBounds.Center());
+            model = glm::scale(model, glm::max(mesh->worldBounds.max - mesh->worldBounds.min, glm::vec3(1e-4f)));
+            objectShader.setMat4("model", model);
+            objectShader.setVec4("objectColor", mesh->ObjectColor);
+            objectShader.setBool("instanced", false);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            stats.drawCalls++;
+        }
+        else {
+            BindVao(mesh->vao);
+            stats.drawCalls += mesh->Draw(objectShader);
+        }
+    }
+
+    Profiler::Get().EndGpu(passTimer);
+
+    BindVao(0);
+    SetPolygonOffset(false);
+    SetDepthWrite(true);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void RenderQueue::UseShader(Shader& shader) {
+    if (currentProgram == shader.ID) return;
+    shader.use();
+    currentProgram = shader.ID;
+    stats.shaderChanges++;
+}
+
+void RenderQueue::BindVao(GLuint vao) {
+    if (currentVao == vao) return;
+    glBindVertexArray(vao);
+    currentVao = vao;
+    stats.vaoChanges++;
+}
+
+void RenderQueue::SetPolygonOffset(bool enabled) {
+    if (polygonOffset == enabled) return;
+    if (enabled) {
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(-1.0f, -1.0f);  // Pull edges toward the camera
+    }
+    else {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+    polygonOffset = enabled;
+    stats.stateChanges++;
+}
+
+void RenderQueue::SetDepthWrite(bool enabled) {
+    if (depthWrite == enabled) return;
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    depthWrite = enabled;
+    stats.stateChanges++;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include "shader_s.h"
+
+class Mesh;
+
+/// <summary>
+/// Passes run in this order, each one sets its shader and GL state once
+/// </summary>
+enum class RenderPass {
+    /// <summary>
+    /// Faces of meshes with an opaque color, front to back so early depth testing rejects hidden fragments
+    /// </summary>
+    Opaque = 0,
+    /// <summary>
+    /// Edge overlays of every mesh, with polygon offset
+    /// </summary>
+    Edges = 1,
+    /// <summary>
+    /// Faces of meshes whose ObjectColor.a is below 1, back to front without depth writes
+    /// </summary>
+    Transparent = 2
+};
+
+struct DrawPacket {
+    RenderPass pass = RenderPass::Opaque;
+    Mesh* mesh = nullptr;
+    /// <summary>
+    /// Distance from the camera to the mesh's bounding sphere
+    /// </summary>
+    float depth = 0.0f;
+    /// <summary>
+    /// Draw the mesh's world bounds as a box instead of its faces
+    /// </summary>
+    bool boundsProxy = false;
+};
+
+/// <summary>
+/// GL calls the last Execute made, for profiling
+/// </summary>
+struct RenderQueueStats {
+    int packets = 0;
+    int drawCalls = 0;
+    int shaderChanges = 0;
+    int vaoChanges = 0;
+    int textureChanges = 0;
+    /// <summary>
+    /// Polygon offset and depth write toggles
+    /// </summary>
+    int stateChanges = 0;
+};
+
+/// <summary>
+/// Collects the meshes to draw this frame, sorts them by pass, depth and buffers and draws them
+/// while only changing GL state when it actually differs.
+/// </summary>
+class RenderQueue {
+public:
+    RenderQueueStats stats;
+
+    RenderQueue() = default;
+    ~RenderQueue();
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    void Clear() {
+        packets.clear();
+    }
+
+    /// <summary>
+    /// Queues the faces and edges of a mesh. CullClusters must have been called on it this frame.
+    /// </summary>
+    void Submit(Mesh* mesh, float depth);
+
+    /// <summary>
+    /// Queues a box over the mesh's world bounds in the mesh's color, no edges
+    /// </summary>
+    void SubmitBoundsProxy(Mesh* mesh, float depth);
+
+    /// <summary>
+    /// Sorts and draws everything submitted. Both shaders need their view and projection set already.
+    /// </summary>
+    void Execute(Shader& objectShader, Shader& edgeShader);
+
+private:
+    std::vector<DrawPacket> packets;
+    /// <summary>
+    /// Vertex array with no attributes for the edge quads, everything they need comes from texture buffers
+    /// </summary>
+    GLuint edgeVao = 0;
+    /// <summary>
+    /// Unit cube (-0.5 to 0.5) with face normals for bounds proxies
+    /// </summary>
+    GLuint boxVao = 0, boxVbo = 0;
+
+    //What the last Execute left bound
+    GLuint currentProgram = 0;
+    GLuint currentVao = 0;
+    bool polygonOffset = false;
+    bool depthWrite = true;
+
+    void CreateBox();
+
+    void UseShader(Shader& shader);
+    void BindVao(GLuint vao);
+    void SetPolygonOffset(bool enabled);
+    void SetDepthWrite(bool enabled);
+};
\ No newline at end of file
@@ -0,0 +1,664 @@
+#include "Subdivision.h"
+#include "MeshArrays.h"
+#include "Parallel.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+    /// <summary>
+    /// MeshArrays with the per half edge flags the rules need. Each refinement knows its exact element counts
+    /// up front so every pass writes straight into presized arrays.
+    /// </summary>
+    struct SubdivisionLevel : MeshArrays {
+        /// <summary>
+        /// Per half edge, set on both halves of a sharp edge. Boundary edges are always sharp and don't need it.
+        /// </summary>
+        std::vector<char> crease;
+        /// <summary>
+        /// Per half edge, set when it runs along an edge of the control mesh. Only tracked for SubdivisionSurface.
+        /// </summary>
+        std::vector<char> cage;
+    };
+
+    /// <summary>
+    /// Marks the creases of a level that only has its arrays filled in
+    /// </summary>
+    void MarkCreases(SubdivisionLevel& level, bool creaseFeatureEdges) {
+        int count = (int)level.next.size();
+        level.crease.assign(count, 0);
+        if (!creaseFeatureEdges)
+            return;
+        //Same face normal as the feature edge overlay, the plane through the first three corners
+        std::vector<glm::vec3> normals(level.faceEdge.size());
+        ParallelFor(normals.size(), [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                int e0 = level.faceEdge[f], e1 = level.next[e0], e2 = level.next[e1];
+                glm::vec3 p0 = level.positions[level.origin[e0]];
+                normals[f] = glm::cross(level.positions[level.origin[e1]] - p0, level.positions[level.origin[e2]] - p0);
+            }
+        });
+        ParallelFor((size_t)count, [&](size_t begin, size_t end) {
+            for (size_t h = begin; h < end; ++h) {
+                int t = level.twin[h];
+                if (t < 0)
+                    continue;
+                glm::vec3 a = normals[level.face[h]], b = normals[level.face[t]];
+                float lengths = glm::length(a) * glm::length(b);
+                level.crease[h] = lengths > 0.0f && glm::dot(a, b) < FEATURE_EDGE_COSINE * lengths;
+            }
+        });
+    }
+
+    /// <summary>
+    /// Copies the mesh into index form and marks the creases. Half edges are numbered face by face, in loop order.
+    /// </summary>
+    void FromMesh(const HalfEdgeMesh& mesh, SubdivisionLevel& level, bool creaseFeatureEdges) {
+        TRACE_SCOPE("Subdivide Index");
+        MeshToArrays(mesh, level);
+        MarkCreases(level, creaseFeatureEdges);
+    }
+
+    /// <summary>
+    /// Lookups of one level shared by the topology, point and stencil passes
+    /// </summary>
+    struct LevelAdjacency {
+        std::vector<int> prev;
+        /// <summary>
+        /// Edge number of every half edge, both halves share the number of the lower one
+        /// </summary>
+        std::vector<int> edgeOf;
+        /// <summary>
+        /// The lower half edge of every edge
+        /// </summary>
+        std::vector<int> edgeHalf;
+    };
+
+    void BuildAdjacency(const SubdivisionLevel& in, LevelAdjacency& adjacency) {
+        size_t edgeCount = in.next.size();
+        adjacency.prev.resize(edgeCount);
+        ParallelFor(edgeCount, [&](size_t begin, size_t end) {
+            for (size_t h = begin; h < end; ++h)
+                adjacency.prev[in.next[h]] = (int)h;
+        });
+
+        adjacency.edgeOf.resize(edgeCount);
+        adjacency.edgeHalf.clear();
+        adjacency.edgeHalf.reserve(edgeCount);
+        for (size_t h = 0; h < edgeCount; ++h) {
+            int t = in.twin[h];
+            if (t < 0 || (int)h < t) {
+                adjacency.edgeOf[h] = (int)adjacency.edgeHalf.size();
+                adjacency.edgeHalf.push_back((int)h);
+            }
+            else {
+                adjacency.edgeOf[h] = adjacency.edgeOf[t];
+            }
+        }
+    }
+
+    /// <summary>
+    /// The edges and faces around a vertex, scratch reused between vertices
+    /// </summary>
+    struct VertexRing {
+        std::vector<int> neighbours, faces;
+        int creaseNeighbours[2] = { -1, -1 };
+        int creaseCount = 0;
+        bool boundary = false;
+    };
+
+    void GatherRing(const SubdivisionLevel& in, const LevelAdjacency& adjacency, int v, VertexRing& ring) {
+        ring.neighbours.clear();
+        ring.faces.clear();
+        ring.creaseCount = 0;
+        ring.boundary = false;
+        auto addEdge = [&](int neighbour, bool sharp) {
+            ring.neighbours.push_back(neighbour);
+            if (sharp) {
+                if (ring.creaseCount < 2)
+                    ring.creaseNeighbours[ring.creaseCount] = neighbour;
+                ring.creaseCount++;
+            }
+        };
+        auto addOutgoing = [&](int h) {
+            addEdge(in.origin[in.next[h]], in.twin[h] < 0 || in.crease[h]);
+            ring.faces.push_back(in.face[h]);
+        };
+
+        //Turn one way around the vertex, if a boundary stops the walk turn the other way from the start
+        int start = in.vertexEdge[v];
+        size_t guard = in.next.size();
+        int h = start;
+        do {
+            addOutgoing(h);
+            int incoming = adjacency.prev[h];
+            if (in.twin[incoming] < 0) {
+                addEdge(in.origin[incoming], true);
+                ring.boundary = true;
+                break;
+            }
+            h = in.twin[incoming];
+        } while (h != start && --guard > 0);
+        if (ring.boundary) {
+            h = start;
+            while (in.twin[h] >= 0 && --guard > 0) {
+                h = in.next[in.twin[h]];
+                addOutgoing(h);
+            }
+        }
+    }
+
+    //The rules are written once against an accumulator with Vertex(v, weight) for a vertex of the level
+    //and FacePoint(f, weight) for the new point of a face, so positions and stencils come from the same code.
+
+    /// <summary>
+    /// Catmull-Clark edge rule, the average of the ends and the two face points. Creases and boundaries take the midpoint.
+    /// </summary>
+    template <typename Accumulator>
+    void EdgePointRule(const SubdivisionLevel& in, int h, Accumulator& accumulator) {
+        int t = in.twin[h];
+        int a = in.origin[h], b = in.origin[in.next[h]];
+        if (t < 0 || in.crease[h]) {
+            accumulator.Vertex(a, 0.5f);
+            accumulator.Vertex(b, 0.5f);
+            return;
+        }
+        accumulator.Vertex(a, 0.25f);
+        accumulator.Vertex(b, 0.25f);
+        accumulator.FacePoint(in.face[h], 0.25f);
+        accumulator.FacePoint(in.face[t], 0.25f);
+    }
+
+    /// <summary>
+    /// Catmull-Clark vertex rule. Smooth vertices move towards the average of their face and edge points,
+    /// vertices on exactly two crease (or boundary) edges follow the curve rule and corners stay put.
+    /// </summary>
+    template <typename Accumulator>
+    void VertexPointRule(const SubdivisionLevel& in, const LevelAdjacency& adjacency, int v, VertexRing& ring, Accumulator& accumulator) {
+        if (in.vertexEdge[v] < 0) {
+            accumulator.Vertex(v, 1.0f);
+            return;
+        }
+        GatherRing(in, adjacency, v, ring);
+        //a boundary vertex with a single face is an open corner, pin it like one so flat panels keep their outline
+        if (ring.creaseCount > 2 || (ring.boundary && ring.faces.size() == 1)) {
+            accumulator.Vertex(v, 1.0f);
+            return;
+        }
+        if (ring.creaseCount == 2) {
+            accumulator.Vertex(ring.creaseNeighbours[0], 0.125f);
+            accumulator.Vertex(v, 0.75f);
+            accumulator.Vertex(ring.creaseNeighbours[1], 0.125f);
+            return;
+        }
+        // (Q + 2R + (n - 3)S) / n with Q the average face point and R the average edge midpoint (S + neighbour) / 2
+        float n = (float)ring.neighbours.size();
+        float faceWeight = 1.0f / (n * (float)ring.faces.size());
+        for (int f : ring.faces)
+            accumulator.FacePoint(f, faceWeight);
+        for (int neighbour : ring.neighbours)
+            accumulator.Vertex(neighbour, 1.0f / (n * n));
+        accumulator.Vertex(v, (n - 2.0f) / n);
+    }
+
+    struct PositionAccumulator {
+        const glm::vec3* positions;
+        const glm::vec3* facePoints;
+        glm::vec3 sum = glm::vec3(0.0f);
+
+        void Vertex(int v, float weight) {
+            sum += weight * positions[v];
+        }
+        void FacePoint(int f, float weight) {
+            sum += weight * facePoints[f];
+        }
+    };
+
+    /// <summary>
+    /// Topology of the next level. New vertices are the old vertices, then one per face, then one per edge.
+    /// Half edge h turns into the quad of its starting corner, numbered 4h to 4h + 3.
+    /// </summary>
+    void RefineTopology(const SubdivisionLevel& in, const LevelAdjacency& adjacency, SubdivisionLevel& out) {
+        size_t vertexCount = in.positions.size();
+        size_t faceCount = in.faceEdge.size();
+        size_t edgeCount = in.next.size();
+        size_t facePointOffset = vertexCount;
+        size_t edgePointOffset = vertexCount + faceCount;
+        bool trackCage = !in.cage.empty();
+
+        out.next.resize(edgeCount * 4);
+        out.twin.resize(edgeCount * 4);
+        out.origin.resize(edgeCount * 4);
+        out.face.resize(edgeCount * 4);
+        out.crease.resize(edgeCount * 4);
+        out.cage.resize(trackCage ? edgeCount * 4 : 0);
+        out.faceEdge.resize(edgeCount);
+        ParallelFor(edgeCount, [&](size_t begin, size_t end) {
+            for (size_t h = begin; h < end; ++h) {
+                int p = adjacency.prev[h], t = in.twin[h], tp = in.twin[p];
+                int base = (int)h * 4;
+                // corner -> edge point -> face point -> previous edge point
+                out.origin[base] = in.origin[h];
+                out.origin[base + 1] = (int)edgePointOffset + adjacency.edgeOf[h];
+                out.origin[base + 2] = (int)facePointOffset + in.face[h];
+                out.origin[base + 3] = (int)edgePointOffset + adjacency.edgeOf[p];
+                for (int k = 0; k < 4; ++k) {
+                    out.next[base + k] = base + (k + 1) % 4;
+                    out.face[base + k] = (int)h;
+                }
+                //outer halves pair with the quads across the old edges, inner ones with the neighbouring corners
+                out.twin[base] = t < 0 ? -1 : 4 * in.next[t] + 3;
+                out.twin[base + 1] = 4 * in.next[h] + 2;
+                out.twin[base + 2] = 4 * p + 1;
+                out.twin[base + 3] = tp < 0 ? -1 : 4 * tp;
+                //the outer halves are the two halves of the old edges, they inherit its flags
+                out.crease[base] = in.crease[h];
+                out.crease[base + 1] = 0;
+                out.crease[base + 2] = 0;
+                out.crease[base + 3] = in.crease[p];
+                if (trackCage) {
+                    out.cage[base] = in.cage[h];
+                    out.cage[base + 1] = 0;
+                    out.cage[base + 2] = 0;
+                    out.cage[base + 3] = in.cage[p];
+                }
+                out.faceEdge[h] = base;
+            }
+        });
+
+        out.vertexEdge.resize(vertexCount + faceCount + adjacency.edgeHalf.size());
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v)
+                out.vertexEdge[v] = in.vertexEdge[v] < 0 ? -1 : 4 * in.vertexEdge[v];
+        });
+        for (size_t f = 0; f < faceCount; ++f)
+            out.vertexEdge[facePointOffset + f] = 4 * in.faceEdge[f] + 2;
+        for (size_t e = 0; e < adjacency.edgeHalf.size(); ++e)
+            out.vertexEdge[edgePointOffset + e] = 4 * adjacency.edgeHalf[e] + 1;
+    }
+
+    /// <summary>
+    /// Positions of the next level, face points first since the other rules use them
+    /// </summary>
+    void RefinePositions(const SubdivisionLevel& in, const LevelAdjacency& adjacency, std::vector<glm::vec3>& out) {
+        size_t vertexCount = in.positions.size();
+        size_t faceCount = in.faceEdge.size();
+        out.resize(vertexCount + faceCount + adjacency.edgeHalf.size());
+        glm::vec3* facePoints = &out[vertexCount];
+        glm::vec3* edgePoints = facePoints + faceCount;
+
+        ParallelFor(faceCount, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                glm::vec3 sum(0.0f);
+                int corners = 0;
+                int h = in.faceEdge[f];
+                do {
+                    sum += in.positions[in.origin[h]];
+                    corners++;
+                    h = in.next[h];
+                } while (h != in.faceEdge[f]);
+                facePoints[f] = sum / (float)corners;
+            }
+        });
+        ParallelFor(adjacency.edgeHalf.size(), [&](size_t begin, size_t end) {
+            for (size_t e = begin; e < end; ++e) {
+                PositionAccumulator accumulator{ in.positions.data(), facePoints };
+                EdgePointRule(in, adjacency.edgeHalf[e], accumulator);
+                edgePoints[e] = accumulator.sum;
+            }
+        });
+        ParallelFor(vertexCount, [&](size_t begin, size_t end) {
+            VertexRing ring;
+            for (size_t v = begin; v < end; ++v) {
+                PositionAccumulator accumulator{ in.positions.data(), facePoints };
+                VertexPointRule(in, adjacency, (int)v, ring, accumulator);
+                out[v] = accumulator.sum;
+            }
+        });
+    }
+
+    void Refine(const SubdivisionLevel& in, SubdivisionLevel& out) {
+        TRACE_SCOPE("Subdivide Level");
+        LevelAdjacency adjacency;
+        BuildAdjacency(in, adjacency);
+        RefineTopology(in, adjacency, out);
+        RefinePositions(in, adjacency, out.positions);
+    }
+
+    /// <summary>
+    /// Expands every vertex a rule uses through that vertex's own stencil, so the rows of a level
+    /// come out in terms of the control vertices. Dense scratch over the control vertices, one per thread.
+    /// </summary>
+    struct StencilAccumulator {
+        const SubdivisionLevel& in;
+        /// <summary>
+        /// Rows of the level's vertices, null on the first level where they are the control vertices themselves
+        /// </summary>
+        const StencilTable* previous;
+        std::vector<float> dense;
+        std::vector<char> used;
+        std::vector<unsigned int> touched;
+
+        StencilAccumulator(const SubdivisionLevel& level, const StencilTable* previousRows, size_t controlCount)
+            : in(level), previous(previousRows), dense(controlCount, 0.0f), used(controlCount, 0) {}
+
+        void Add(unsigned int control, float weight) {
+            if (!used[control]) {
+                used[control] = 1;
+                touched.push_back(control);
+            }
+            dense[control] += weight;
+        }
+
+        void Vertex(int v, float weight) {
+            if (!previous) {
+                Add((unsigned int)v, weight);
+                return;
+            }
+            for (unsigned int i = previous->offsets[v]; i < previous->offsets[v + 1]; ++i)
+                Add(previous->indices[i], weight * previous->weights[i]);
+        }
+
+        void FacePoint(int f, float weight) {
+            int corners = 0;
+            int h = in.faceEdge[f];
+            do {
+                corners++;
+                h = in.next[h];
+            } while (h != in.faceEdge[f]);
+            float cornerWeight = weight / (float)corners;
+            do {
+                Vertex(in.origin[h], cornerWeight);
+                h = in.next[h];
+            } while (h != in.faceEdge[f]);
+        }
+
+        /// <summary>
+        /// Appends the accumulated row to rows and clears the scratch for the next one
+        /// </summary>
+        void Flush(StencilTable& rows) {
+            for (unsigned int control : touched) {
+                rows.indices.push_back(control);
+                rows.weights.push_back(dense[control]);
+                dense[control] = 0.0f;
+                used[control] = 0;
+            }
+            touched.clear();
+            rows.offsets.push_back((unsigned int)rows.indices.size());
+        }
+    };
+
+    /// <summary>
+    /// Rows of the next level's vertices, in the same order RefineTopology numbers them.
+    /// Rows are built in fixed blocks on the worker threads and stitched together afterwards.
+    /// </summary>
+    void RefineStencils(const SubdivisionLevel& in, const LevelAdjacency& adjacency, const StencilTable* previous,
+        size_t controlCount, StencilTable& out)
+    {
+        TRACE_SCOPE("Subdivide Stencils");
+        const size_t BLOCK_ROWS = 1024;
+        size_t vertexCount = in.positions.size();
+        size_t faceCount = in.faceEdge.size();
+        size_t rowCount = vertexCount + faceCount + adjacency.edgeHalf.size();
+        size_t blockCount = (rowCount + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+        std::vector<StencilTable> blocks(blockCount);
+        ParallelFor(blockCount, [&](size_t begin, size_t end) {
+            StencilAccumulator accumulator(in, previous, controlCount);
+            VertexRing ring;
+            for (size_t b = begin; b < end; ++b) {
+                StencilTable& block = blocks[b];
+                size_t first = b * BLOCK_ROWS, last = std::min(rowCount, first + BLOCK_ROWS);
+                for (size_t row = first; row < last; ++row) {
+                    if (row < vertexCount)
+                        VertexPointRule(in, adjacency, (int)row, ring, accumulator);
+                    else if (row < vertexCount + faceCount)
+                        accumulator.FacePoint((int)(row - vertexCount), 1.0f);
+                    else
+                        EdgePointRule(in, adjacency.edgeHalf[row - vertexCount - faceCount], accumulator);
+                    accumulator.Flush(block);
+                }
+            }
+        }, 1);
+
+        std::vector<size_t> blockStart(blockCount + 1, 0);
+        for (size_t b = 0; b < blockCount; ++b)
+            blockStart[b + 1] = blockStart[b] + blocks[b].indices.size();
+        out.offsets.resize(rowCount + 1);
+        out.indices.resize(blockStart[blockCount]);
+        out.weights.resize(blockStart[blockCount]);
+        out.offsets[0] = 0;
+        ParallelFor(blockCount, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                const StencilTable& block = blocks[b];
+                std::copy(block.indices.begin(), block.indices.end(), out.indices.begin() + blockStart[b]);
+                std::copy(block.weights.begin(), block.weights.end(), out.weights.begin() + blockStart[b]);
+                for (size_t i = 0; i < block.offsets.size(); ++i)
+                    out.offsets[b * BLOCK_ROWS + i + 1] = (unsigned int)(blockStart[b] + block.offsets[i]);
+            }
+        }, 1);
+    }
+}
+
+void SubdivideCatmullClark(HalfEdgeMesh& mesh, int levels, bool creaseFeatureEdges) {
+    TRACE_SCOPE("Subdivide");
+    if (levels <= 0 || mesh.faces.empty())
+        return;
+    SubdivisionLevel current, refined;
+    FromMesh(mesh, current, creaseFeatureEdges);
+    for (int i = 0; i < levels; ++i) {
+        Refine(current, refined);
+        std::swap(current, refined);
+    }
+    ArraysToMesh(current, mesh);
+}
+
+void SubdivideArrays(MeshArrays& arrays, int levels, bool creaseFeatureEdges) {
+    TRACE_SCOPE("Subdivide");
+    if (levels <= 0 || arrays.faceEdge.empty())
+        return;
+    SubdivisionLevel current, refined;
+    static_cast<MeshArrays&>(current) = std::move(arrays);
+    MarkCreases(current, creaseFeatureEdges);
+    for (int i = 0; i < levels; ++i) {
+        Refine(current, refined);
+        std::swap(current, refined);
+    }
+    arrays = std::move(static_cast<MeshArrays&>(current));
+}
+
+void BuildSubdivisionSurface(const HalfEdgeMesh& control, int levels, bool creaseFeatureEdges, SubdivisionSurface& surface) {
+    TRACE_SCOPE("Subdivision Surface");
+    surface = SubdivisionSurface();
+    surface.controlCount = control.vertices.size();
+    if (levels <= 0 || control.faces.empty())
+        return;
+    surface.levels = levels;
+
+    SubdivisionLevel current, refined;
+    FromMesh(control, current, creaseFeatureEdges);
+    current.cage.assign(current.next.size(), 1);
+    StencilTable rows;
+    LevelAdjacency adjacency;
+    for (int i = 0; i < levels; ++i) {
+        BuildAdjacency(current, adjacency);
+        RefineStencils(current, adjacency, i == 0 ? nullptr : &rows, surface.controlCount, surface.stencils);
+        RefineTopology(current, adjacency, refined);
+        //the rules only read positions to size the vertex passes, the stencils carry the actual geometry
+        refined.positions.resize(refined.vertexEdge.size());
+        std::swap(current, refined);
+        std::swap(rows, surface.stencils);
+    }
+    surface.stencils = std::move(rows);
+
+    //Quads of the last level, half edge 4f + k is side k of quad f
+    size_t quadCount = current.faceEdge.size();
+    surface.quads.resize(quadCount * 4);
+    surface.neighbours.resize(quadCount * 4);
+    surface.cageSides.resize(quadCount);
+    ParallelFor(quadCount, [&](size_t begin, size_t end) {
+        for (size_t f = begin; f < end; ++f) {
+            unsigned char sides = 0;
+            for (int k = 0; k < 4; ++k) {
+                size_t h = 4 * f + k;
+                surface.quads[h] = (unsigned int)current.origin[h];
+                surface.neighbours[h] = current.twin[h] < 0 ? -1 : current.twin[h] / 4;
+                if (current.cage[h])
+                    sides |= 1 << k;
+            }
+            surface.cageSides[f] = sides;
+        }
+    });
+}
+
+bool EvaluateSubdivisionSurface(const SubdivisionSurface& surface, const HalfEdgeMesh& control, std::vector<glm::vec3>& outPositions) {
+    TRACE_SCOPE("Evaluate Stencils");
+    if (control.vertices.size() != surface.controlCount)
+        return false;
+    std::vector<glm::vec3> controlPositions(surface.controlCount);
+    for (size_t v = 0; v < surface.controlCount; ++v)
+        controlPositions[v] = control.vertices[v]->position;
+
+    const StencilTable& stencils = surface.stencils;
+    outPositions.resize(stencils.RowCount());
+    ParallelFor(stencils.RowCount(), [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            glm::vec3 sum(0.0f);
+            for (unsigned int i = stencils.offsets[row]; i < stencils.offsets[row + 1]; ++i)
+                sum += stencils.weights[i] * controlPositions[stencils.indices[i]];
+            outPositions[row] = sum;
+        }
+    });
+    return true;
+}
+
+namespace {
+    const unsigned int CLUSTER_QUADS = CLUSTER_TRIANGLES / 2;
+
+    glm::vec3 QuadNormal(const SubdivisionSurface& surface, const std::vector<glm::vec3>& positions, size_t q) {
+        const unsigned int* corners = &surface.quads[4 * q];
+        glm::vec3 p0 = positions[corners[0]];
+        glm::vec3 n = glm::cross(positions[corners[1]] - p0, positions[corners[2]] - p0);
+        float length = glm::length(n);
+        return length > 0.0f ? n / length : n;
+    }
+
+    void SurfaceNormals(const SubdivisionSurface& surface,
+        const std::vector<glm::vec3>& positions,
+        bool flatShading,
+        std::vector<glm::vec3>& outPositions,
+        std::vector<glm::vec3>& outNormals)
+    {
+        size_t quadCount = surface.QuadCount();
+        std::vector<glm::vec3> quadNormals(quadCount);
+        ParallelFor(quadCount, [&](size_t begin, size_t end) {
+            for (size_t q = begin; q < end; ++q)
+                quadNormals[q] = QuadNormal(surface, positions, q);
+        });
+
+        if (flatShading) {
+            outPositions.resize(quadCount * 4);
+            outNormals.resize(quadCount * 4);
+            ParallelFor(quadCount, [&](size_t begin, size_t end) {
+                for (size_t q = begin; q < end; ++q) {
+                    for (int k = 0; k < 4; ++k) {
+                        outPositions[4 * q + k] = positions[surface.quads[4 * q + k]];
+                        outNormals[4 * q + k] = quadNormals[q];
+                    }
+                }
+            });
+            return;
+        }
+
+        //Same as ComputeNormals, the sum of the unit normals of the faces around each vertex
+        outPositions = positions;
+        outNormals.assign(positions.size(), glm::vec3(0.0f));
+        for (size_t q = 0; q < quadCount; ++q) {
+            for (int k = 0; k < 4; ++k)
+                outNormals[surface.quads[4 * q + k]] += quadNormals[q];
+        }
+        ParallelFor(outNormals.size(), [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                float length = glm::length(outNormals[v]);
+                if (length > 0.0f)
+                    outNormals[v] /= length;
+            }
+        });
+    }
+}
+
+void SubdivisionSurfaceToTriangles(const SubdivisionSurface& surface,
+    const std::vector<glm::vec3>& positions,
+    bool flatShading,
+    std::vector<glm::vec3>& outPositions,
+    std::vector<glm::vec3>& outNormals,
+    std::vector<unsigned int>& outIndices,
+    std::vector<unsigned int>& outEdgeIndices,
+    std::vector<MeshCluster>* outClusters)
+{
+    TRACE_SCOPE("Triangulate Surface");
+    outIndices.clear();
+    outEdgeIndices.clear();
+    if (outClusters)
+        outClusters->clear();
+    SurfaceNormals(surface, positions, flatShading, outPositions, outNormals);
+
+    //Refined quads are already grouped by control face, so runs of consecutive quads make compact clusters
+    size_t quadCount = surface.QuadCount();
+    bool clustering = outClusters && quadCount >= CLUSTER_MIN_FACES;
+    outIndices.reserve(quadCount * 6);
+    auto renderIndex = [&](size_t q, int k) {
+        return flatShading ? (unsigned int)(4 * q + k) : surface.quads[4 * q + k];
+    };
+    for (size_t first = 0; first < quadCount; first += CLUSTER_QUADS) {
+        size_t last = std::min(quadCount, first + CLUSTER_QUADS);
+        MeshCluster cluster;
+        cluster.indexOffset = (unsigned int)outIndices.size();
+        cluster.edgeOffset = (unsigned int)outEdgeIndices.size();
+        for (size_t q = first; q < last; ++q) {
+            unsigned int c0 = renderIndex(q, 0), c1 = renderIndex(q, 1), c2 = renderIndex(q, 2), c3 = renderIndex(q, 3);
+            outIndices.insert(outIndices.end(), { c0, c1, c2, c0, c2, c3 });
+
+            //Only the control mesh's edges are drawn. A shared side is emitted by the lower quad, unless the other
+            //quad is in another cluster, then both emit it so it stays visible if either cluster is drawn.
+            for (int k = 0; k < 4; ++k) {
+                if (!(surface.cageSides[q] >> k & 1))
+                    continue;
+                int neighbour = surface.neighbours[4 * q + k];
+                bool otherCluster = clustering && neighbour >= 0 && (neighbour < (int)first || neighbour >= (int)last);
+                if (neighbour < 0 || otherCluster || (int)q < neighbour) {
+                    outEdgeIndices.push_back(renderIndex(q, k));
+                    outEdgeIndices.push_back(renderIndex(q, (k + 1) % 4));
+                }
+            }
+        }
+        if (clustering) {
+            cluster.indexCount = (unsigned int)outIndices.size() - cluster.indexOffset;
+            cluster.edgeCount = (unsigned int)outEdgeIndices.size() - cluster.edgeOffset;
+            outClusters->push_back(cluster);
+        }
+    }
+    if (clustering) {
+        ParallelFor(outClusters->size(), [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c)
+                ComputeClusterBounds((*outClusters)[c], outPositions, outIndices);
+        }, 64);
+    }
+}
+
+void UpdateSubdivisionSurfaceTriangles(const SubdivisionSurface& surface,
+    const std::vector<glm::vec3>& positions,
+    bool flatShading,
+    const std::vector<unsigned int>& indices,
+    std::vector<glm::vec3>& outPositions,
+    std::vector<glm::vec3>& outNormals,
+    std::vector<MeshCluster>* clusters)
+{
+    TRACE_SCOPE("Update Surface");
+    SurfaceNormals(surface, positions, flatShading, outPositions, outNormals);
+    if (clusters) {
+        ParallelFor(clusters->size(), [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c)
+                ComputeClusterBounds((*clusters)[c], outPositions, indices);
+        }, 64);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "HalfEdgeMesh.h"
+#include "MeshArrays.h"
+
+/// <summary>
+/// Most levels the tool window offers, every level multiplies the face count by about four
+/// </summary>
+const int SUBDIVISION_MAX_LEVELS = 4;
+
+/// <summary>
+/// Refines the mesh with Catmull-Clark subdivision, levels times. Every face turns into one quad per corner.
+/// Boundary edges are always kept as creases, with creaseFeatureEdges the edges sharper than
+/// FEATURE_EDGE_COSINE are too, so hard surface edges stay sharp while the faces between them round off.
+/// The refined mesh replaces the old elements, any pointers into the mesh are invalidated.
+/// </summary>
+void SubdivideCatmullClark(HalfEdgeMesh& mesh, int levels, bool creaseFeatureEdges);
+
+/// <summary>
+/// SubdivideCatmullClark on the index form, the refined arrays replace the old ones
+/// </summary>
+void SubdivideArrays(MeshArrays& arrays, int levels, bool creaseFeatureEdges);
+
+/// <summary>
+/// Sparse weights, row r is the weighted sum of indices/weights in [offsets[r], offsets[r + 1])
+/// </summary>
+struct StencilTable {
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> indices;
+    std::vector<float> weights;
+
+    size_t RowCount() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+};
+
+/// <summary>
+/// Catmull-Clark surface of a control mesh kept as stencils: every refined vertex is a fixed combination of control vertices.
+/// Only a topology change needs BuildSubdivisionSurface, moving control vertices just re-evaluates the stencils.
+/// </summary>
+struct SubdivisionSurface {
+    int levels = 0;
+    /// <summary>
+    /// Vertex count of the control mesh the stencils were built for, rows index control vertices in mesh.vertices order
+    /// </summary>
+    size_t controlCount = 0;
+    StencilTable stencils;
+    /// <summary>
+    /// Refined faces, all quads, as four refined vertex indices each in counter clockwise order.
+    /// The quads of a control face are contiguous.
+    /// </summary>
+    std::vector<unsigned int> quads;
+    /// <summary>
+    /// Quad across each side, side k runs from corner k to k + 1. -1 on a boundary.
+    /// </summary>
+    std::vector<int> neighbours;
+    /// <summary>
+    /// Bit k is set when side k lies along an edge of the control mesh, those are the edges the overlay shows
+    /// </summary>
+    std::vector<unsigned char> cageSides;
+
+    size_t QuadCount() const {
+        return quads.size() / 4;
+    }
+};
+
+/// <summary>
+/// Computes the refined topology and the stencils of every refined vertex. Rule choice matches SubdivideCatmullClark.
+/// </summary>
+void BuildSubdivisionSurface(const HalfEdgeMesh& control, int levels, bool creaseFeatureEdges, SubdivisionSurface& surface);
+
+/// <summary>
+/// Refined vertex positions from the current control positions. Returns false when the control mesh
+/// no longer has the vertex count the surface was built for.
+/// </summary>
+bool EvaluateSubdivisionSurface(const SubdivisionSurface& surface, const HalfEdgeMesh& control, std::vector<glm::vec3>& outPositions);
+
+/// <summary>
+/// Render data of the refined surface in the layout MeshToTriangles produces: fan triangles, per face vertices when flat shaded,
+/// edge pairs along the control mesh's edges and, for big surfaces, clusters of consecutive quads.
+/// </summary>
+void SubdivisionSurfaceToTriangles(const SubdivisionSurface& surface,
+    const std::vector<glm::vec3>& positions,
+    bool flatShading,
+    std::vector<glm::vec3>& outPositions,
+    std::vector<glm::vec3>& outNormals,
+    std::vector<unsigned int>& outIndices,
+    std::vector<unsigned int>& outEdgeIndices,
+    std::vector<MeshCluster>* outClusters = nullptr);
+
+/// <summary>
+/// Refreshes positions, normals and cluster bounds of render data from SubdivisionSurfaceToTriangles after the refined
+/// positions moved. Indices and edges only depend on the topology and stay as they are.
+/// </summary>
+void UpdateSubdivisionSurfaceTriangles(const SubdivisionSurface& surface,
+    const std::vector<glm::vec3>& positions,
+    bool flatShading,
+    const std::vector<unsigned int>& indices,
+    std::vector<glm::vec3>& outPositions,
+    std::vector<glm::vec3>& outNormals,
+    std::vector<MeshCluster>* clusters = nullptr);
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "Trace.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+    struct Event {
+        const char* name;
+        int64_t start, end;
+    };
+
+    /// <summary>
+    /// Ring slot, relaxed atomics so a reader racing the writer gets a stale value rather than undefined behaviour
+    /// </summary>
+    struct EventSlot {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<int64_t> start{ 0 }, end{ 0 };
+    };
+
+    /// <summary>
+    /// Single writer ring, only its own thread writes events and head. Readers copy slots and then use head to
+    /// find which of them may have been overwritten meanwhile.
+    /// </summary>
+    struct ThreadBuffer {
+        std::unique_ptr<EventSlot[]> events = std::make_unique<EventSlot[]>(Trace::EVENTS_PER_THREAD);
+        std::atomic<uint64_t> head{ 0 };
+        unsigned int threadId = 0;
+        std::string name;
+    };
+
+    const Trace::Clock::time_point epoch = Trace::Clock::now();
+
+    std::mutex registryMutex;
+    //buffers outlive their threads so worker events are still there when the trace is written
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+    //Buffers of exited worker threads. ParallelFor and the background jobs start fresh threads all the time, the
+    //next one carries on in the same ring under the same track instead of registering another buffer.
+    std::vector<ThreadBuffer*> freeBuffers;
+
+    /// <summary>
+    /// Owns the calling thread's buffer until the thread exits, then hands it to the next thread to record
+    /// </summary>
+    struct BufferLease {
+        ThreadBuffer* buffer = nullptr;
+        bool named = false;
+
+        ~BufferLease() {
+            //named threads keep their track, their events would read as another thread's otherwise
+            if (!buffer || named)
+                return;
+            std::lock_guard<std::mutex> lock(registryMutex);
+            freeBuffers.push_back(buffer);
+        }
+    };
+    thread_local BufferLease localBuffer;
+
+    ThreadBuffer& LocalBuffer() {
+        if (!localBuffer.buffer) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (!freeBuffers.empty()) {
+                localBuffer.buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            else {
+                registry.push_back(std::make_unique<ThreadBuffer>());
+                localBuffer.buffer = registry.back().get();
+                localBuffer.buffer->threadId = (unsigned int)registry.size();
+                localBuffer.buffer->name = "Worker " + std::to_string(localBuffer.buffer->threadId);
+            }
+        }
+        return *localBuffer.buffer;
+    }
+
+    void WriteEscaped(std::ofstream& out, const char* s) {
+        for (; *s; ++s) {
+            if (*s == '"' || *s == '\\')
+                out << '\\';
+            out << *s;
+        }
+    }
+
+    /// <summary>
+    /// Chrome traces are in microseconds, keep three decimals so sub microsecond scopes don't read as zero
+    /// </summary>
+    void WriteMicroseconds(std::ofstream& out, int64_t nanoseconds) {
+        out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+    }
+}
+
+std::atomic<bool> Trace::enabled{ false };
+
+void Trace::Record(const char* name, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer& buffer = LocalBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    EventSlot& slot = buffer.events[head % EVENTS_PER_THREAD];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(), std::memory_order_relaxed);
+    slot.end.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - epoch).count(), std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::SetThreadName(const char* name) {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+    localBuffer.named = true;
+}
+
+bool Trace::WriteChromeTrace(const std::string& path) {
+    struct ThreadEvents {
+        unsigned int threadId;
+        std::string name;
+        std::vector<Event> events;
+    };
+    std::vector<ThreadEvents> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& buffer : registry) {
+            ThreadEvents copy{ buffer->threadId, buffer->name, {} };
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+            copy.events.reserve((size_t)(head - first));
+            for (uint64_t i = first; i < head; ++i) {
+                const EventSlot& slot = buffer->events[i % EVENTS_PER_THREAD];
+                copy.events.push_back({ slot.name.load(std::memory_order_relaxed),
+                    slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed) });
+            }
+
+            //The writer may have lapped the copy, slots it reached (including the one it is writing) are torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = buffer->head.load(std::memory_order_relaxed);
+            uint64_t firstIntact = after >= EVENTS_PER_THREAD ? after - EVENTS_PER_THREAD + 1 : 0;
+            if (firstIntact > first) {
+                size_t torn = (size_t)std::min<uint64_t>(firstIntact - first, copy.events.size());
+                copy.events.erase(copy.events.begin(), copy.events.begin() + torn);
+            }
+            threads.push_back(std::move(copy));
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const ThreadEvents& thread : threads) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadId
+            << ",\"args\":{\"name\":\"";
+        WriteEscaped(out, thread.name.c_str());
+        out << "\"}}";
+        first = false;
+        for (const Event& e : thread.events) {
+            out << ",\n{\"name\":\"";
+            WriteEscaped(out, e.name);
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.threadId << ",\"ts\":";
+            WriteMicroseconds(out, e.start);
+            out << ",\"dur\":";
+            WriteMicroseconds(out, e.end - e.start);
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
\ No newline at end of file
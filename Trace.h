@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// Records timed scopes from any thread into per thread ring buffers and writes them out as Chrome trace JSON,
+/// which chrome://tracing and ui.perfetto.dev both open. Recording takes no locks, a thread only locks once to
+/// take a buffer the first time it records and once more to give it back when it exits. Unnamed threads hand their
+/// buffer on to the next thread, so short lived workers share a few tracks instead of each keeping its own.
+/// </summary>
+namespace Trace {
+    /// <summary>
+    /// Events kept per thread, older events are overwritten once a thread's buffer wraps
+    /// </summary>
+    const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    using Clock = std::chrono::steady_clock;
+
+    /// <summary>
+    /// Recording is off until enabled, a disabled scope costs one relaxed load
+    /// </summary>
+    extern std::atomic<bool> enabled;
+
+    /// <summary>
+    /// Records a finished scope on the calling thread. name has to outlive the trace, use string literals.
+    /// </summary>
+    void Record(const char* name, Clock::time_point start, Clock::time_point end);
+
+    /// <summary>
+    /// Names the calling thread in the written trace, call before it records anything
+    /// </summary>
+    void SetThreadName(const char* name);
+
+    /// <summary>
+    /// Writes every buffered event to path as Chrome trace JSON. Safe to call while other threads keep recording,
+    /// events they overwrite during the copy are left out. Returns false when the file can't be written.
+    /// </summary>
+    bool WriteChromeTrace(const std::string& path);
+
+    /// <summary>
+    /// Adds the time between construction and destruction to the trace
+    /// </summary>
+    class Scope {
+    public:
+        explicit Scope(const char* name) : name(name), active(enabled.load(std::memory_order_relaxed)) {
+            if (active)
+                start = Clock::now();
+        }
+
+        ~Scope() {
+            if (active)
+                Record(name, start, Clock::now());
+        }
+
+    private:
+        const char* name;
+        bool active;
+        Clock::time_point start;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+/// <summary>
+/// Traces the rest of the enclosing scope under name, safe on any thread
+/// </summary>
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#include "Viewport.h"
 #include "ObjectPrimitives.h"
+#include "Profiler.h"
 #include <glm/gtx/string_cast.hpp>
 #include <glm/gtx/vector_angle.hpp>
 #include "imgui.h"
@@ -36,7 +37,7 @@ void Viewport::Init() {
 	sceneMeshes.push_back(CreateCube(1.0f));
 	viewportCamera = new Camera();
 	objectShader = new Shader("objectVert.vert", "objectFrag.frag");
-	edgeShader = new Shader("edgeVert.vert", "edgeFrag.frag", "edgeGeom.geom");
+	edgeShader = new Shader("edgeVert.vert", "edgeFrag.frag");
 	gridShader = new Shader("gridVert.vert", "gridFrag.frag");
 }
 
@@ -46,46 +47,100 @@ void Viewport::ResizeViewportFramebuffer(int width, int height) {
 
 	viewportWidth = width;
 	viewportHeight = height;
-	CreateViewportFramebuffer();
+	//Smaller sizes render into a corner of the current targets, larger ones wait for the size to settle
+	//and are stretched from the old resolution meanwhile
+	if (width > targetWidth || height > targetHeight)
+		pendingResizeTime = glfwGetTime();
+	renderWidth = std::min(width, targetWidth);
+	renderHeight = std::min(height, targetHeight);
+	Invalidate();
 
 	// Update projection matrix for new size
-	Projection = glm::perspective(glm::radians(51.0f),
+	Projection = glm::perspective(glm::radians(FIELD_OF_VIEW),
 		(float)width / (float)height,
 		0.1f, 1000.0f);
 }
 
 void Viewport::CreateViewportFramebuffer() {
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	AllocateRenderTargets(viewportWidth, viewportHeight);
+	renderWidth = viewportWidth;
+	renderHeight = viewportHeight;
+	pendingResizeTime = -1.0;
+}
+
+void Viewport::AllocateRenderTargets(int width, int height) {
+	auto roundUp = [&](int size) {
+		return (size + RENDER_TARGET_GRANULARITY - 1) / RENDER_TARGET_GRANULARITY * RENDER_TARGET_GRANULARITY;
+	};
+	targetWidth = roundUp(width);
+	targetHeight = roundUp(height);
+
+	bool created = fbo != 0;
+	if (!created) {
+		glGenFramebuffers(1, &fbo);
+		glGenTextures(1, &fboTexture);
+		glGenRenderbuffers(1, &fboDepth);
+	}
 
 	// Viewport as image texture
-	glGenTextures(1, &fboTexture);
 	glBindTexture(GL_TEXTURE_2D, fboTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, viewportWidth, viewportHeight,
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, targetWidth, targetHeight,
 		0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-		GL_TEXTURE_2D, fboTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Depth buffer
-	glGenRenderbuffers(1, &fboDepth);
 	glBindRenderbuffer(GL_RENDERBUFFER, fboDepth);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
-		viewportWidth, viewportHeight);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-		GL_RENDERBUFFER, fboDepth);
+		targetWidth, targetHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "Framebuffer incomplete!" << std::endl;
+	if (!created) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, fboTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+			GL_RENDERBUFFER, fboDepth);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Framebuffer incomplete!" << std::endl;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+}
+
+void Viewport::UpdateRenderTargets() {
+	if (pendingResizeTime < 0.0 || glfwGetTime() - pendingResizeTime < RESIZE_DEBOUNCE_SECONDS)
+		return;
+	pendingResizeTime = -1.0;
+	if (viewportWidth > targetWidth || viewportHeight > targetHeight)
+		AllocateRenderTargets(std::max(viewportWidth, targetWidth), std::max(viewportHeight, targetHeight));
+	renderWidth = viewportWidth;
+	renderHeight = viewportHeight;
+	Invalidate();
+}
+
+void Viewport::DeleteViewportFramebuffer() {
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &fboTexture);
+	glDeleteRenderbuffers(1, &fboDepth);
+	fbo = fboTexture = fboDepth = 0;
+	targetWidth = targetHeight = 0;
+}
+
+void Viewport::GetImageUVs(ImVec2& uv0, ImVec2& uv1) const {
+	float u = targetWidth > 0 ? (float)frameWidth / targetWidth : 1.0f;
+	float v = targetHeight > 0 ? (float)frameHeight / targetHeight : 1.0f;
+	uv0 = ImVec2(0.0f, v);
+	uv1 = ImVec2(u, 0.0f);
 }
 
 void Viewport::Draw() {
 	//Draw custom cursor if there is an active tool, doing it here so it draws every frame
 	bool isViewportHovered = ImGui::IsWindowHovered();
-	IsActive = isViewportHovered || ActiveTool;
+	//a box select keeps the viewport active so the release is still seen outside the window
+	IsActive = isViewportHovered || ActiveTool || boxSelecting;
 	ImVec2 mousePos = ImGui::GetMousePos();
 	imguiWinPos = ImGui::GetWindowPos();
 	imguiCurPos = ImGui::GetCursorPos();
@@ -124,7 +179,7 @@ void Viewport::Draw() {
 		//Draw line from center of object to mouse
 		if (ActiveTool == Scale || ActiveTool == Rotate) {
 			glm::vec3 projected = glm::project(
-				selectedMesh->Translation,
+				activeMesh->Translation,
 				viewportCamera->GetViewMatrix(),
 				Projection,
 				glm::vec4(0, 0, viewportWidth, viewportHeight)
@@ -149,16 +204,24 @@ void Viewport::Draw() {
 			IM_COL32(0, 0, 0, 255));
 	}
 
-	//Draw selected origin
-	if (selectedMesh) {
+	//Draw selected origins, the active one highlighted
+	for (Mesh* mesh : selectedMeshes) {
 		glm::vec3 projectedOrigin = glm::project(
-			selectedMesh->GetGlobalOrigin(),
+			mesh->GetGlobalOrigin(),
 			viewportCamera->GetViewMatrix(),
 			Projection,
 			glm::vec4(0, 0, viewportWidth, viewportHeight)
 		);
 		ImVec2 screenSpaceOrigin(projectedOrigin.x + imguiWinPos.x + imguiCurPos.x, viewportHeight - projectedOrigin.y + imguiWinPos.y + imguiCurPos.y);
-		drawList->AddCircleFilled(screenSpaceOrigin, 3.0f, IM_COL32(0, 247, 255, 255));
+		drawList->AddCircleFilled(screenSpaceOrigin, 3.0f, mesh == activeMesh ? IM_COL32(0, 247, 255, 255) : IM_COL32(0, 140, 150, 255));
+	}
+
+	//Draw box select rectangle
+	if (boxSelecting && glm::distance(boxSelectStart, localCursorPos) >= BOX_SELECT_MIN_DRAG) {
+		ImVec2 boxStart(boxSelectStart.x + imguiWinPos.x + imguiCurPos.x, boxSelectStart.y + imguiWinPos.y + imguiCurPos.y);
+		ImVec2 boxEnd(localCursorPos.x + imguiWinPos.x + imguiCurPos.x, localCursorPos.y + imguiWinPos.y + imguiCurPos.y);
+		drawList->AddRectFilled(ImMin(boxStart, boxEnd), ImMax(boxStart, boxEnd), IM_COL32(255, 255, 255, 20));
+		drawList->AddRect(ImMin(boxStart, boxEnd), ImMax(boxStart, boxEnd), IM_COL32(255, 255, 255, 255));
 	}
 
 	//Draw 3d cursor
@@ -174,8 +237,93 @@ void Viewport::Draw() {
 	drawList->AddLine(ImVec2(screenSpaceCursor.x, screenSpaceCursor.y - 17.0f), ImVec2(screenSpaceCursor.x, screenSpaceCursor.y + 17.0f), IM_COL32(0, 255, 0, 255), 2.0f);
 	drawList->PopClipRect();
 
+	UpdateRenderTargets();
+	if (ActiveTool != None || viewportCamera->GetViewMatrix() != renderedView)
+		lastInteractionTime = glfwGetTime();
+	if (NeedsRender())
+		RenderScene();
+}
+
+bool Viewport::IsInteracting() {
+	return lastInteractionTime >= 0.0 && glfwGetTime() - lastInteractionTime < INTERACTION_SETTLE_SECONDS;
+}
+
+void Viewport::ReadRenderTimeQuery() {
+	if (!renderTimeQueries[0])
+		glGenQueries(2, renderTimeQueries);
+	//the other query is from the previous render, only read it once the GPU is done with it
+	int previous = renderTimeQueryIndex ^ 1;
+	if (!renderTimeQueryIssued[previous])
+		return;
+	GLint available = 0;
+	glGetQueryObjectiv(renderTimeQueries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(renderTimeQueries[previous], GL_QUERY_RESULT, &nanoseconds);
+	renderTimeQueryIssued[previous] = false;
+	//stats still hold the previous render at this point
+	lastRenderSeconds = nanoseconds * 1e-9;
+	lastRenderScale = (float)frameWidth / std::max(renderWidth, 1);
+	lastRenderTriangles = stats.trianglesDrawn;
+
+	if (lastRenderTriangles >= MIN_BUDGET_SAMPLE_TRIANGLES && lastRenderSeconds > 0.0) {
+		double measured = lastRenderTriangles * FRAME_BUDGET_SECONDS / lastRenderSeconds;
+		triangleBudget = glm::mix(triangleBudget, measured, 0.25);
+	}
+}
+
+void Viewport::UpdateResolutionScale() {
+	if (!dynamicResolution || !IsInteracting()) {
+		resolutionScale = 1.0f;
+		return;
+	}
+	if (lastRenderSeconds <= 0.0)
+		return;
+	//cost goes with the pixel count, so the linear scale goes with the square root of the time ratio
+	float target = lastRenderScale * (float)std::sqrt(FRAME_BUDGET_SECONDS / lastRenderSeconds);
+	target = glm::clamp(target, MIN_RESOLUTION_SCALE, 1.0f);
+	//halfway there each frame so one slow frame doesn't drop the resolution all at once
+	resolutionScale = glm::clamp(glm::mix(resolutionScale, target, 0.5f), MIN_RESOLUTION_SCALE, 1.0f);
+}
+
+bool Viewport::NeedsRender() {
+	if (sceneDirty || viewportCamera->GetViewMatrix() != renderedView || Projection != renderedProjection)
+		return true;
+	//a reduced frame from navigating gets replaced once the input settles
+	if (IsDegradedFrame() && !IsInteracting())
+		return true;
+	for (const auto& mesh : sceneMeshes) {
+		if (mesh->gpuDirty || mesh->positionsDirty || mesh->transformDirty || mesh->LodJobReady() || mesh->DecimateJobReady()
+			|| mesh->instancesDirty || mesh->ModifierJobNeeded() || mesh->ModifierJobReady())
+			return true;
+	}
+	return false;
+}
+
+bool Viewport::HasPendingWork() {
+	if (pendingResizeTime >= 0.0 || IsDegradedFrame())
+		return true;
+	for (const auto& mesh : sceneMeshes) {
+		if (mesh->LodJobPending() || mesh->DecimateJobPending() || mesh->ModifierJobPending())
+			return true;
+	}
+	return false;
+}
+
+void Viewport::RenderScene() {
+	sceneDirty = false;
+	renderedView = viewportCamera->GetViewMatrix();
+	renderedProjection = Projection;
+
+	ReadRenderTimeQuery();
+	UpdateResolutionScale();
+	frameWidth = std::max(1, (int)(renderWidth * resolutionScale));
+	frameHeight = std::max(1, (int)(renderHeight * resolutionScale));
+	glBeginQuery(GL_TIME_ELAPSED, renderTimeQueries[renderTimeQueryIndex]);
+
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glViewport(0, 0, viewportWidth, viewportHeight);
+	glViewport(0, 0, frameWidth, frameHeight);
 	glEnable(GL_DEPTH_TEST);
 	glDepthMask(GL_TRUE);
 	glEnable(GL_BLEND);
@@ -194,13 +342,87 @@ void Viewport::Draw() {
 	edgeShader->setMat4("projection", Projection);
 	edgeShader->setMat4("view", viewportCamera->GetViewMatrix());
 	edgeShader->setMat4("model", glm::mat4(1.0f));
-	edgeShader->setVec2("viewportSize", glm::vec2(viewportWidth, viewportHeight));
+	edgeShader->setVec2("viewportSize", glm::vec2(frameWidth, frameHeight));
+
+	Frustum viewFrustum = Frustum::FromMatrix(Projection * viewportCamera->GetViewMatrix());
+	stats = ViewportStats();
+	renderQueue.Clear();
+	stats.meshesTotal = (int)sceneMeshes.size();
+	std::vector<Mesh*> visibleMeshes;
+	for (const auto& mesh : sceneMeshes) {
+		mesh->UpdateBounds();
+		//sphere first since it's cheaper, the box is tighter for long thin meshes
+		if (frustumCulling && (viewFrustum.TestSphere(mesh->worldSphere.center, mesh->worldSphere.radius) == Containment::Outside
+			|| viewFrustum.TestAABB(mesh->worldBounds) == Containment::Outside)) {
+			stats.meshesCulled++;
+			continue;
+		}
+		float projectedRadius = ProjectedRadius(mesh->worldSphere);
+		mesh->SelectLod(projectedRadius);
+		mesh->SelectEdgeOverlay(projectedRadius);
+		visibleMeshes.push_back(mesh.get());
+	}
+	//after every model matrix is up to date, a moved operand starts its evaluation next frame
+	UpdateModifierOperands();
+
+	//While navigating over budget the heaviest meshes turn into proxies until the rest fits
+	//indexed like visibleMeshes
+	std::vector<bool> boxProxies(visibleMeshes.size(), false);
+	if (navigationProxy != NavigationProxy::Off && IsInteracting()) {
+		size_t totalTriangles = 0;
+		for (Mesh* mesh : visibleMeshes)
+			totalTriangles += mesh->LodTriangleCount(mesh->lodLevel);
+		if (totalTriangles > triangleBudget) {
+			std::vector<size_t> heaviest(visibleMeshes.size());
+			for (size_t i = 0; i < heaviest.size(); ++i)
+				heaviest[i] = i;
+			std::sort(heaviest.begin(), heaviest.end(), [&](size_t a, size_t b) {
+				return visibleMeshes[a]->LodTriangleCount(visibleMeshes[a]->lodLevel)
+					> visibleMeshes[b]->LodTriangleCount(visibleMeshes[b]->lodLevel);
+			});
+			for (size_t index : heaviest) {
+				Mesh* mesh = visibleMeshes[index];
+				size_t triangles = mesh->LodTriangleCount(mesh->lodLevel);
+				if (totalTriangles <= triangleBudget || triangles < PROXY_MIN_TRIANGLES)
+					break;
+				mesh->edgeOverlay = EdgeOverlay::Hidden;
+				if (navigationProxy == NavigationProxy::LowestLod && !mesh->lods.empty()) {
+					mesh->lodLevel = (int)mesh->lods.size();
+					totalTriangles -= triangles - mesh->LodTriangleCount(mesh->lodLevel);
+				}
+				else {
+					boxProxies[index] = true;
+					totalTriangles -= triangles;
+				}
+				stats.meshesProxied++;
+			}
+		}
+	}
 
-	for (const auto& mesh : sceneMeshes) {	
-		mesh->Draw(*objectShader);
-		mesh->DrawEdges(*edgeShader);
+	for (size_t index = 0; index < visibleMeshes.size(); ++index) {
+		Mesh* mesh = visibleMeshes[index];
+		float depth = glm::distance(mesh->worldSphere.center, viewportCamera->ZoomPosition);
+		stats.meshesDrawn++;
+		if (boxProxies[index]) {
+			renderQueue.SubmitBoundsProxy(mesh, depth);
+			stats.trianglesDrawn += 12;
+			continue;
+		}
+		mesh->CullClusters(viewFrustum, viewportCamera->ZoomPosition);
+		if (mesh->lodLevel > 0)
+			stats.meshesReducedLod++;
+		if (mesh->edgeOverlay != EdgeOverlay::Full)
+			stats.edgeOverlaysReduced++;
+		renderQueue.Submit(mesh, depth);
+		stats.clustersCulled += mesh->clustersCulled;
+		stats.trianglesDrawn += mesh->visibleTriangleCount;
+	}
+	{
+		PROFILE_SCOPE("Render Queue");
+		renderQueue.Execute(*objectShader, *edgeShader);
 	}
 
+	int gridTimer = Profiler::Get().BeginGpu("Grid");
 	gridShader->use();
 	gridShader->setMat4("projection", Projection);
 	gridShader->setMat4("view", viewportCamera->GetViewMatrix());
@@ -209,8 +431,14 @@ void Viewport::Draw() {
 	gridShader->setVec3("cameraPos", viewportCamera->Position);
 	glBindVertexArray(gridVao);
 	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	Profiler::Get().EndGpu(gridTimer);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glEndQuery(GL_TIME_ELAPSED);
+	Profiler::Get().AddCounter("Triangles", (double)stats.trianglesDrawn);
+	Profiler::Get().AddCounter("Draw Calls", renderQueue.stats.drawCalls + 1.0);
+	renderTimeQueryIssued[renderTimeQueryIndex] = true;
+	renderTimeQueryIndex ^= 1;
 }
 
 void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
@@ -257,7 +485,7 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 				//dot product is how similar the vector of the mouse movement is to the projected axis direction
 				float movementAlongAxis = glm::dot(mouseDelta, axisScreenDir);
 
-				float distance = glm::distance(selectedMesh->Translation, viewportCamera->ZoomPosition);
+				float distance = glm::distance(activeMesh->Translation, viewportCamera->ZoomPosition);
 
 				//std::cout << distance << std::endl;
 
@@ -271,15 +499,15 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 					vp,
 					selectedTransform);
 			}
-			selectedMesh->Translation += delta;
-			transformVisualText = "Move: " + glm::to_string(selectedMesh->Translation - selectedTransform);
+			activeMesh->Translation += delta;
+			transformVisualText = "Move: " + glm::to_string(activeMesh->Translation - selectedTransform);
 			break;
 		}
 		case Scale: {
 			if (firstScaleUpdate) {
 				firstScaleUpdate = false;
 				glm::vec3 projected = glm::project(
-					selectedMesh->Translation,
+					activeMesh->Translation,
 					viewportCamera->GetViewMatrix(),
 					Projection,
 					glm::vec4(0, 0, viewportWidth, viewportHeight)
@@ -291,7 +519,7 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 			
 			//project mesh origin to screen space
 			glm::vec3 projected = glm::project(
-				selectedMesh->Translation,
+				activeMesh->Translation,
 				viewportCamera->GetViewMatrix(),
 				Projection,
 				glm::vec4(0, 0, viewportWidth, viewportHeight)
@@ -299,21 +527,21 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 			glm::vec2 objectScreenPos(projected.x, viewportHeight - projected.y);
 
 			// Use camera front direction to determine scaling sign
-			glm::vec3 camToObj = glm::normalize(selectedMesh->Translation - viewportCamera->ZoomPosition);
+			glm::vec3 camToObj = glm::normalize(activeMesh->Translation - viewportCamera->ZoomPosition);
 
 			float currentDistance = glm::length(glm::vec2(xpos, ypos) - objectScreenPos);
 			float delta = (currentDistance - scaleStartDistance);
 			float scaleFactor = 1.0f + delta * 0.005f; // sensitivity tweak
 
 			if (transformAxis != glm::vec3(0.0f)) {
-				selectedMesh->Scale = selectedTransform * (glm::vec3(1.0f) - transformAxis) + selectedTransform * transformAxis * scaleFactor;
+				activeMesh->Scale = selectedTransform * (glm::vec3(1.0f) - transformAxis) + selectedTransform * transformAxis * scaleFactor;
 			}
 			else
-				selectedMesh->Scale = selectedTransform * scaleFactor;
+				activeMesh->Scale = selectedTransform * scaleFactor;
 
 			transformVisualText = "Scale: " + std::to_string(scaleFactor);
 
-			selectedMesh->transformDirty = true;
+			activeMesh->transformDirty = true;
 			break;
 			}
 		case Rotate: {
@@ -326,7 +554,7 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 				break;
 			}
 			glm::vec3 projected = glm::project(
-				selectedMesh->Translation,
+				activeMesh->Translation,
 				viewportCamera->GetViewMatrix(),
 				Projection,
 				glm::vec4(0, 0, viewportWidth, viewportHeight)
@@ -354,12 +582,12 @@ void Viewport::cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 			else
 				rotationMatrix = glm::rotate(glm::mat4(1.0f), accumulatedRotation, viewportCamera->Front);
 			glm::vec3 deltaEuler = glm::degrees(glm::eulerAngles(glm::quat_cast(rotationMatrix)));
-			selectedMesh->Rotation = selectedTransform + deltaEuler;
+			activeMesh->Rotation = selectedTransform + deltaEuler;
 			transformVisualText = "Rotate: " + glm::to_string(deltaEuler);
 			break;
 		}
 		}
-		selectedMesh->transformDirty = true;
+		activeMesh->transformDirty = true;
 	}
 	else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_3) == GLFW_PRESS) {
 		if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
@@ -381,15 +609,27 @@ void Viewport::scroll_callback(GLFWwindow* window, double xpos, double ypos) {
 
 void Viewport::mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
 	if (button == GLFW_MOUSE_BUTTON_1 && action == GLFW_PRESS) {
-		if (selectedMesh && ActiveTool) {
+		if (activeMesh && ActiveTool) {
 			SetActiveTool(window, None, false);
 			return;
 		}
+		//Wait for the release to decide between a click and a box select
+		boxSelecting = true;
+		boxSelectStart = localCursorPos;
+	}
+	else if (button == GLFW_MOUSE_BUTTON_1 && action == GLFW_RELEASE && boxSelecting) {
+		boxSelecting = false;
+		bool extend = (mods & GLFW_MOD_SHIFT) != 0;
+		if (glm::distance(boxSelectStart, localCursorPos) >= BOX_SELECT_MIN_DRAG) {
+			BoxSelect(boxSelectStart, localCursorPos, extend);
+			return;
+		}
 
 		glm::vec3 rayDir;
 		glm::vec3 origin;
 		viewportCamera->GetMouseRay(localCursorPos.x, localCursorPos.y, viewportWidth, viewportHeight, Projection, rayDir, origin);
 
+		PROFILE_SCOPE("Pick");
 		Mesh* selected = nullptr;
 		Face* selectedFace = nullptr;
 		float closestDistance = FLT_MAX;
@@ -405,13 +645,23 @@ void Viewport::mouse_button_callback(GLFWwindow* window, int button, int action,
 				}
 			}
 		}
-		SetSelected(selected);
+		if (!extend) {
+			SetSelected(selected);
+		}
+		else if (selected) {
+			//shift click toggles, but a selected mesh that isn't active becomes active first
+			if (selected->selected && selected == activeMesh)
+				RemoveFromSelection(selected);
+			else
+				AddToSelection(selected);
+		}
 	}
 	else if (button == GLFW_MOUSE_BUTTON_2 && action == GLFW_PRESS) {
-		if (selectedMesh && ActiveTool) {
+		if (activeMesh && ActiveTool) {
 			SetActiveTool(window, None, true);
 			return;
 		}
+		boxSelecting = false;
 	}
 }
 
@@ -422,22 +672,22 @@ void Viewport::key_callback(GLFWwindow* window, int key, int scancode, int actio
 		switch (key) {
 		case GLFW_KEY_D:
 			//duplicate mesh
-			if (selectedMesh) {
-				DuplicateMesh(selectedMesh);
+			if (activeMesh) {
+				DuplicateMesh(activeMesh);
 				SetActiveTool(window, Translate, true);
 			}
 			break;
 		case GLFW_KEY_S: 
 			//set 3D cursor to selected origin
-			if (selectedMesh) {
-				glm::vec3 selectedOrigin = selectedMesh->GetGlobalOrigin();
+			if (activeMesh) {
+				glm::vec3 selectedOrigin = activeMesh->GetGlobalOrigin();
 				cursor3D = selectedOrigin;
 			}
 		}
 		return;
 	}
 	//active mesh keys
-	if (!selectedMesh || action != GLFW_PRESS)
+	if (!activeMesh || action != GLFW_PRESS)
 		return;
 	if (transformKeyMappings.count(key)) {
 		SetActiveTool(window, transformKeyMappings[key]);
@@ -445,11 +695,15 @@ void Viewport::key_callback(GLFWwindow* window, int key, int scancode, int actio
 	}
 	switch (key) {
 	case GLFW_KEY_F:
-		viewportCamera->SetFocus(selectedMesh->Translation, 10.0f);
+		viewportCamera->SetFocus(activeMesh->Translation, 10.0f);
 		break;
-	case GLFW_KEY_DELETE:
-		DeleteMesh(selectedMesh);
+	case GLFW_KEY_DELETE: {
+		//copy since deleting edits the selection
+		std::vector<Mesh*> toDelete = selectedMeshes;
+		for (Mesh* mesh : toDelete)
+			DeleteMesh(mesh);
 		break;
+	}
 	case GLFW_KEY_ENTER:
 		SetActiveTool(window, None, false);
 		break;
@@ -480,9 +734,18 @@ void Viewport::AddMesh(std::unique_ptr<Mesh> mesh) {
 	mesh->transformDirty = true;
 	sceneMeshes.push_back(std::move(mesh));
 	SetSelected(newSelected);
+	Invalidate();
 }
 
 void Viewport::DeleteMesh(Mesh* mesh) {
+	RemoveFromSelection(mesh);
+	//booleans keep the last snapshot of a deleted operand
+	for (const auto& other : sceneMeshes) {
+		for (Modifier& modifier : other->modifierStack.modifiers) {
+			if (modifier.operandSource == mesh)
+				modifier.operandSource = nullptr;
+		}
+	}
 	auto it = std::find_if(sceneMeshes.begin(), sceneMeshes.end(),
 		[&](const std::unique_ptr<Mesh>& m) {
 			return m.get() == mesh;
@@ -491,36 +754,164 @@ void Viewport::DeleteMesh(Mesh* mesh) {
 	if (it != sceneMeshes.end()) {
 		sceneMeshes.erase(it);
 	}
-	selectedMesh = nullptr;
+	Invalidate();
+}
+
+void Viewport::UpdateModifierOperands() {
+	for (const auto& mesh : sceneMeshes) {
+		std::vector<Modifier>& modifiers = mesh->modifierStack.modifiers;
+		for (size_t i = 0; i < modifiers.size(); ++i) {
+			Modifier& modifier = modifiers[i];
+			if (modifier.type == ModifierType::Mirror && modifier.mirrorAtCursor) {
+				glm::vec3 center = glm::vec3(glm::inverse(mesh->GetModelMatrix()) * glm::vec4(cursor3D, 1.0f));
+				if (center != modifier.mirrorCenter) {
+					modifier.mirrorCenter = center;
+					mesh->ModifierChanged(i);
+				}
+				continue;
+			}
+			if (!UsesOperand(modifier) || !modifier.operandSource)
+				continue;
+			auto it = std::find_if(sceneMeshes.begin(), sceneMeshes.end(),
+				[&](const std::unique_ptr<Mesh>& m) {
+					return m.get() == modifier.operandSource;
+				});
+			if (it == sceneMeshes.end())
+				continue;
+			Mesh* source = it->get();
+			glm::mat4 operandToLocal = glm::inverse(mesh->GetModelMatrix()) * source->GetModelMatrix();
+			//renderVersion moves with every rebuild of the operand's geometry
+			bool edited = !modifier.operand || source->renderVersion != modifier.operandVersion;
+			if (!edited && operandToLocal == modifier.operandToLocal)
+				continue;
+			if (edited) {
+				auto operand = std::make_shared<HalfEdgeMesh>();
+				source->CloneInto(*operand);
+				modifier.operand = std::move(operand);
+				modifier.operandVersion = source->renderVersion;
+			}
+			modifier.operandToLocal = operandToLocal;
+			mesh->ModifierChanged(i);
+		}
+	}
 }
 
 void Viewport::DuplicateMesh(Mesh* mesh) {
+	PROFILE_SCOPE("Clone");
 	AddMesh(std::make_unique<Mesh>(mesh->Clone()));
 }
 
 void Viewport::SetSelected(Mesh* mesh) {
-	if (selectedMesh) {
-		selectedMesh->selected = false;
-	}
-	selectedMesh = mesh;
-	if (mesh) {
+	ClearSelection();
+	if (mesh)
+		AddToSelection(mesh);
+}
+
+void Viewport::AddToSelection(Mesh* mesh) {
+	if (!mesh->selected) {
 		mesh->selected = true;
-		forceMeshTab = true;
+		selectedMeshes.push_back(mesh);
 	}
+	activeMesh = mesh;
+	forceMeshTab = true;
+	Invalidate();
+}
+
+void Viewport::RemoveFromSelection(Mesh* mesh) {
+	if (!mesh->selected)
+		return;
+	mesh->selected = false;
+	selectedMeshes.erase(std::remove(selectedMeshes.begin(), selectedMeshes.end(), mesh), selectedMeshes.end());
+	if (activeMesh == mesh)
+		activeMesh = selectedMeshes.empty() ? nullptr : selectedMeshes.back();
+	Invalidate();
+}
+
+void Viewport::ClearSelection() {
+	for (Mesh* mesh : selectedMeshes)
+		mesh->selected = false;
+	selectedMeshes.clear();
+	activeMesh = nullptr;
+	Invalidate();
+}
+
+void Viewport::UpdateSceneBVH() {
+	bool sameObjects = sceneBVHMeshes.size() == sceneMeshes.size() && std::equal(sceneMeshes.begin(), sceneMeshes.end(),
+		sceneBVHMeshes.begin(), [](const std::unique_ptr<Mesh>& mesh, Mesh* built) { return mesh.get() == built; });
+	if (!sameObjects) {
+		sceneBVHMeshes.resize(sceneMeshes.size());
+		sceneBounds.resize(sceneMeshes.size());
+		for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+			sceneMeshes[i]->UpdateBounds();
+			sceneBVHMeshes[i] = sceneMeshes[i].get();
+			sceneBounds[i] = sceneMeshes[i]->worldBounds;
+		}
+		sceneBVH.Build(sceneBounds);
+		sceneBVHRefitMoves = 0;
+		return;
+	}
+
+	//a transform or an edit only shows up as new world bounds
+	size_t moved = 0;
+	for (size_t i = 0; i < sceneMeshes.size(); ++i) {
+		sceneMeshes[i]->UpdateBounds();
+		const AABB& bounds = sceneMeshes[i]->worldBounds;
+		if (bounds.min == sceneBounds[i].min && bounds.max == sceneBounds[i].max)
+			continue;
+		sceneBounds[i] = bounds;
+		moved++;
+	}
+	if (moved == 0)
+		return;
+	sceneBVHRefitMoves += moved;
+	if (sceneBVHRefitMoves > sceneBounds.size() / 4) {
+		sceneBVH.Build(sceneBounds);
+		sceneBVHRefitMoves = 0;
+	}
+	else {
+		sceneBVH.Refit(sceneBounds);
+	}
+}
+
+void Viewport::BoxSelect(glm::vec2 start, glm::vec2 end, bool extend) {
+	glm::vec2 minPixel = glm::min(start, end);
+	glm::vec2 maxPixel = glm::max(start, end);
+	//cursor y grows downwards, ndc y grows upwards
+	glm::vec2 ndcMin(2.0f * minPixel.x / viewportWidth - 1.0f, 1.0f - 2.0f * maxPixel.y / viewportHeight);
+	glm::vec2 ndcMax(2.0f * maxPixel.x / viewportWidth - 1.0f, 1.0f - 2.0f * minPixel.y / viewportHeight);
+	Frustum boxFrustum = Frustum::FromMatrix(Projection * viewportCamera->GetViewMatrix(), ndcMin, ndcMax);
+
+	UpdateSceneBVH();
+
+	Mesh* previousActive = activeMesh;
+	if (!extend)
+		ClearSelection();
+	sceneBVH.QueryFrustum(boxFrustum, sceneBounds, [&](uint32_t index, Containment containment) {
+		Mesh* mesh = sceneMeshes[index].get();
+		if (mesh->selected)
+			return;
+		//Only objects straddling the box edge need the exact triangle test
+		if (containment == Containment::Inside || MeshIntersectsFrustum(*mesh, boxFrustum))
+			AddToSelection(mesh);
+	});
+	//keep the previous active mesh if it survived the box
+	if (previousActive && previousActive->selected)
+		activeMesh = previousActive;
 }
 
 void Viewport::UndoTransform() {
 	switch (ActiveTool) {
 	case Rotate:
-		selectedMesh->Rotation = selectedTransform;
+		activeMesh->Rotation = selectedTransform;
 		break;
 	case Translate:
-		selectedMesh->Translation = selectedTransform;
+		activeMesh->Translation = selectedTransform;
 		break;
 	case Scale:
-		selectedMesh->Scale = selectedTransform;
+		activeMesh->Scale = selectedTransform;
 		break;
 	} 
+	activeMesh->transformDirty = true;
 }
 
 void Viewport::SetActiveTool(GLFWwindow* window, TransformTool activeTool, bool undoCurrent) {
@@ -548,14 +939,14 @@ void Viewport::SetActiveTool(GLFWwindow* window, TransformTool activeTool, bool
 	switch (activeTool) {
 	case Rotate:
 		firstRotationUpdate = true;
-		selectedTransform = selectedMesh->Rotation;
+		selectedTransform = activeMesh->Rotation;
 		break;
 	case Translate:
-		selectedTransform = selectedMesh->Translation;
+		selectedTransform = activeMesh->Translation;
 		break;
 	case Scale: {
 		firstScaleUpdate = true;
-		selectedTransform = selectedMesh->Scale;
+		selectedTransform = activeMesh->Scale;
 		break;
 	}
 	case None:
@@ -598,60 +989,43 @@ bool Viewport::PickMesh(Mesh& mesh, glm::vec3 rayOrigin, glm::vec3 rayDir, float
 	glm::vec3 localOrig = glm::vec3(invModel * glm::vec4(rayOrigin, 1.0f));
 	glm::vec3 localDir = glm::normalize(glm::vec3(invModel * glm::vec4(rayDir, 0.0f)));
 
-	outFace = nullptr;
-	outDist = FLT_MAX;
+	float t;
+	if (!mesh.Raycast(localOrig, localDir, t, outFace)) {
+		outDist = FLT_MAX;
+		return false;
+	}
+	glm::vec3 hitLocal = localOrig + localDir * t;
+	glm::vec3 hitWorld = glm::vec3(model * glm::vec4(hitLocal, 1.0f));
+	outDist = glm::length(hitWorld - rayOrigin);
+	return true;
+}
+
+float Viewport::ProjectedRadius(const BoundingSphere& sphere) {
+	float distanceSquared = glm::dot(sphere.center - viewportCamera->ZoomPosition, sphere.center - viewportCamera->ZoomPosition);
+	float radiusSquared = sphere.radius * sphere.radius;
+	//camera inside the sphere, it covers the whole view
+	if (distanceSquared <= radiusSquared)
+		return FLT_MAX;
+	float tangent = sphere.radius / std::sqrt(distanceSquared - radiusSquared);
+	return tangent / std::tan(glm::radians(FIELD_OF_VIEW) * 0.5f) * viewportHeight * 0.5f;
+}
+
+bool Viewport::MeshIntersectsFrustum(Mesh& mesh, const Frustum& frustum) {
+	//test in local space so the vertices don't need transforming
+	Frustum localFrustum = frustum.ToLocalSpace(mesh.GetModelMatrix());
 
 	for (auto& f : mesh.faces)
 	{
-		// Fan triangulate through all edges
 		const HalfEdge* start = f->edge;
-		const HalfEdge* e = start;
-		const HalfEdge* e1 = e->next;
+		const HalfEdge* e1 = start->next;
 		const HalfEdge* e2 = e1->next;
 
 		while (e2 != start) {
-			// Test triangle (e, e1, e2)
-			glm::vec3 v0 = e->origin->position;
-			glm::vec3 v1 = e1->origin->position;
-			glm::vec3 v2 = e2->origin->position;
-
-			float t;
-			if (RayTriangle(localOrig, localDir, v0, v1, v2, t) && t < outDist) {
-				glm::vec3 hitLocal = localOrig + localDir * t;
-				glm::vec3 hitWorld = glm::vec3(model * glm::vec4(hitLocal, 1.0f));
-				float tWorld = glm::length(hitWorld - rayOrigin);
-				outDist = tWorld;
-				outFace = f.get();
-			}
-			// Move forward in fan
+			if (localFrustum.IntersectsTriangle(start->origin->position, e1->origin->position, e2->origin->position))
+				return true;
 			e1 = e2;
 			e2 = e2->next;
 		}
 	}
-	return (outFace != nullptr);
-}
-
-bool Viewport::RayTriangle(const glm::vec3& orig, const glm::vec3& dir,
-		const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
-		float& tOut)
-{
-	const float EPSILON = 0.000001f;
-	glm::vec3 edge1 = v1 - v0;
-	glm::vec3 edge2 = v2 - v0;
-
-	glm::vec3 pvec = glm::cross(dir, edge2);
-	float det = glm::dot(edge1, pvec);
-	if (fabs(det) < EPSILON) return false;
-
-	float invDet = 1.0f / det;
-	glm::vec3 tvec = orig - v0;
-	float u = glm::dot(tvec, pvec) * invDet;
-	if (u < 0 || u > 1) return false;
-
-	glm::vec3 qvec = glm::cross(tvec, edge1);
-	float v = glm::dot(dir, qvec) * invDet;
-	if (v < 0 || u + v > 1) return false;
-
-	tOut = glm::dot(edge2, qvec) * invDet;
-	return (tOut > EPSILON);
+	return false;
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include <glad/glad.h>
 #include <glad/glad.h>
@@ -10,6 +10,9 @@
 #include "Mesh.h"
 #include "Face.h"
 #include "Camera.h"
+#include "Bounds.h"
+#include "BVH.h"
+#include "RenderQueue.h"
 #include <GLFW/glfw3.h>
 #include "imgui_internal.h"
 
@@ -19,12 +22,45 @@ enum TransformTool {
 	Translate = 2,
 	Scale = 3
 };
+/// <summary>
+/// What heavy meshes are drawn as while navigating a scene over the triangle budget
+/// </summary>
+enum class NavigationProxy {
+	Off = 0,
+	/// <summary>
+	/// Coarsest level of detail, meshes without one fall back to their bounding box
+	/// </summary>
+	LowestLod = 1,
+	BoundingBox = 2
+};
+
+/// <summary>
+/// Per frame counters shown in the stats panel
+/// </summary>
+struct ViewportStats {
+	int meshesTotal = 0;
+	int meshesDrawn = 0;
+	int meshesCulled = 0;
+	int clustersCulled = 0;
+	int meshesReducedLod = 0;
+	int edgeOverlaysReduced = 0;
+	int meshesProxied = 0;
+	size_t trianglesDrawn = 0;
+};
+
 class Viewport {
 public:
 	GLuint fbo = 0, fboTexture = 0, fboDepth = 0, gridVao = 0, gridVbo = 0;
 	Shader* objectShader, * edgeShader, * gridShader;
 	Camera* viewportCamera;
-	Mesh* selectedMesh;
+	/// <summary>
+	/// Every selected mesh, in the order they were selected
+	/// </summary>
+	std::vector<Mesh*> selectedMeshes;
+	/// <summary>
+	/// The mesh transform tools and the tool window act on, always part of selectedMeshes
+	/// </summary>
+	Mesh* activeMesh = nullptr;
 	/// <summary>
 	/// For use when applying transforms with the mouse. Need to save the meshes original transform so it can be undone.
 	/// </summary>
@@ -32,7 +68,104 @@ public:
 	float scaleStartDistance = 0.0f;
 	std::unordered_map<int, TransformTool> transformKeyMappings;
 	std::vector<std::unique_ptr<Mesh>> sceneMeshes;
+	/// <summary>
+	/// Hierarchy over the world bounds of sceneMeshes, primitive i is sceneMeshes[i]. Kept between queries and
+	/// brought up to date by UpdateSceneBVH.
+	/// </summary>
+	BVH sceneBVH;
+	std::vector<AABB> sceneBounds;
+	/// <summary>
+	/// sceneMeshes when sceneBVH was last built, any difference needs a new build
+	/// </summary>
+	std::vector<Mesh*> sceneBVHMeshes;
+	/// <summary>
+	/// Objects moved by refits since the last build, past a quarter of the scene the splits are rebuilt
+	/// </summary>
+	size_t sceneBVHRefitMoves = 0;
+	ViewportStats stats;
+	RenderQueue renderQueue;
+	bool frustumCulling = true;
+	/// <summary>
+	/// Set by anything that changes what the scene looks like without going through the mesh dirty flags or the camera,
+	/// fboTexture is only redrawn when the scene changed
+	/// </summary>
+	bool sceneDirty = true;
+	/// <summary>
+	/// Camera the fbo was last rendered with
+	/// </summary>
+	glm::mat4 renderedView = glm::mat4(0.0f);
+	glm::mat4 renderedProjection = glm::mat4(0.0f);
+	/// <summary>
+	/// Size of the viewport panel, what projection, picking and the overlays work in
+	/// </summary>
 	int viewportWidth = 1000, viewportHeight = 1000;
+	/// <summary>
+	/// Allocated size of the render targets, the scene is rendered into the bottom left corner of them
+	/// </summary>
+	int targetWidth = 0, targetHeight = 0;
+	/// <summary>
+	/// Size the scene is rendered at, the panel size clamped to the allocation while a resize is debounced
+	/// </summary>
+	int renderWidth = 1000, renderHeight = 1000;
+	/// <summary>
+	/// Render targets are allocated in steps of this many pixels so small resizes fit the existing allocation
+	/// </summary>
+	const int RENDER_TARGET_GRANULARITY = 256;
+	/// <summary>
+	/// How long the panel size has to stay put before the render targets are reallocated
+	/// </summary>
+	const double RESIZE_DEBOUNCE_SECONDS = 0.2;
+	/// <summary>
+	/// glfwGetTime of the last size change that didn't fit the allocation, negative when none is pending
+	/// </summary>
+	double pendingResizeTime = -1.0;
+	/// <summary>
+	/// Size of the last rendered frame, renderWidth/renderHeight scaled down while navigating
+	/// </summary>
+	int frameWidth = 1000, frameHeight = 1000;
+	/// <summary>
+	/// Render at a lower resolution while the camera or a transform tool moves, sized to keep the GPU time in budget
+	/// </summary>
+	bool dynamicResolution = true;
+	/// <summary>
+	/// Linear scale of the frame while navigating, renders go back to 1 once input settles
+	/// </summary>
+	float resolutionScale = 1.0f;
+	const float MIN_RESOLUTION_SCALE = 0.35f;
+	/// <summary>
+	/// GPU time a scene render should take while navigating
+	/// </summary>
+	const double FRAME_BUDGET_SECONDS = 1.0 / 60.0;
+	/// <summary>
+	/// Time without camera or tool movement before the frame is re-rendered at full resolution
+	/// </summary>
+	const double INTERACTION_SETTLE_SECONDS = 0.15;
+	double lastInteractionTime = -1.0;
+	/// <summary>
+	/// GL_TIME_ELAPSED queries around the scene render, alternated so the previous result is read without stalling
+	/// </summary>
+	GLuint renderTimeQueries[2] = { 0, 0 };
+	bool renderTimeQueryIssued[2] = { false, false };
+	int renderTimeQueryIndex = 0;
+	/// <summary>
+	/// GPU time of the most recent scene render that has a result, and the resolution scale it ran at
+	/// </summary>
+	double lastRenderSeconds = 0.0;
+	float lastRenderScale = 1.0f;
+	size_t lastRenderTriangles = 0;
+	NavigationProxy navigationProxy = NavigationProxy::LowestLod;
+	/// <summary>
+	/// Triangles the GPU gets through within FRAME_BUDGET_SECONDS, measured from render times
+	/// </summary>
+	double triangleBudget = 2000000.0;
+	/// <summary>
+	/// Renders with fewer triangles than this say too little about throughput to update the budget
+	/// </summary>
+	const size_t MIN_BUDGET_SAMPLE_TRIANGLES = 50000;
+	/// <summary>
+	/// Meshes smaller than this are never swapped for proxies, they cost next to nothing
+	/// </summary>
+	const size_t PROXY_MIN_TRIANGLES = 2000;
 	glm::vec2 localCursorPos;
 	glm::mat4 Projection;
 	glm::vec3 viewportLight = glm::vec3(1.2f, 1.0f, 10.0f);
@@ -41,6 +174,7 @@ public:
 	ImVec2 imguiCurPos = ImVec2(0.0f, 0.0f);
 	glm::vec3 transformAxis = glm::vec3(0.0f);
 	const int GRID_SIZE = 20;
+	const float FIELD_OF_VIEW = 51.0f;
 	double lastX, lastY;
 	bool firstMouse = true;
 	bool IsActive = false;
@@ -48,6 +182,12 @@ public:
 	bool firstScaleUpdate = false;
 	bool firstRotationUpdate = false;
 	bool ignoreNextMouseDelta = false;
+	bool boxSelecting = false;
+	glm::vec2 boxSelectStart = glm::vec2(0.0f);
+	/// <summary>
+	/// Cursor travel in pixels before a left click turns into a box select
+	/// </summary>
+	const float BOX_SELECT_MIN_DRAG = 4.0f;
 	float accumulatedRotation = 0.0;
 	TransformTool ActiveTool = None;
 	std::string transformVisualText;
@@ -58,17 +198,48 @@ public:
 		Init();
 	}
 
+	~Viewport() {
+		DeleteViewportFramebuffer();
+		glDeleteQueries(2, renderTimeQueries);
+	}
+
 	void InitGrid();
 
 	void Init();
 
+	/// <summary>
+	/// Creates the fbo and render targets for the current panel size. The objects are reused by later resizes.
+	/// </summary>
 	void CreateViewportFramebuffer();
 
+	void DeleteViewportFramebuffer();
+
+	/// <summary>
+	/// UV rectangle of fboTexture holding the last rendered frame, flipped for ImGui::Image
+	/// </summary>
+	void GetImageUVs(ImVec2& uv0, ImVec2& uv1) const;
 
 	void ResizeViewportFramebuffer(int width, int height);
 
+	/// <summary>
+	/// Draws the ImGui overlays every frame and re-renders the scene into fboTexture when it changed
+	/// </summary>
 	void Draw();
 
+	void Invalidate() {
+		sceneDirty = true;
+	}
+
+	/// <summary>
+	/// True if the last rendered frame is out of date
+	/// </summary>
+	bool NeedsRender();
+
+	/// <summary>
+	/// True while background work (level of detail builds) will change the scene without any input
+	/// </summary>
+	bool HasPendingWork();
+
 	void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos);
 
 	void scroll_callback(GLFWwindow* window, double xpos, double ypos);
@@ -83,8 +254,27 @@ public:
 
 	void DuplicateMesh(Mesh* mesh);
 
+	/// <summary>
+	/// Retakes the snapshot or transform of every modifier whose operand object was edited or moved, and moves the
+	/// mirrors that follow the 3D cursor
+	/// </summary>
+	void UpdateModifierOperands();
+
 	void SetSelected(Mesh* mesh);
 
+	void AddToSelection(Mesh* mesh);
+
+	void RemoveFromSelection(Mesh* mesh);
+
+	void ClearSelection();
+
+	void BoxSelect(glm::vec2 start, glm::vec2 end, bool extend);
+
+	/// <summary>
+	/// Builds sceneBVH when objects were added or removed, refits it when only their bounds moved
+	/// </summary>
+	void UpdateSceneBVH();
+
 	void SetActiveTool(GLFWwindow* window, TransformTool activeTool, bool undoCurrent = true);
 
 	void UndoTransform();
@@ -105,8 +295,44 @@ public:
 		Face*& outFace
 	);
 
-	bool RayTriangle(const glm::vec3& orig, const glm::vec3& dir,
-		const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
-		float& tOut
-	);
+	/// <summary>
+	/// On screen radius in pixels of a world space sphere
+	/// </summary>
+	float ProjectedRadius(const BoundingSphere& sphere);
+
+	void RenderScene();
+
+	/// <summary>
+	/// Re-specifies the render target storage, the fbo, texture and renderbuffer objects themselves are kept
+	/// </summary>
+	void AllocateRenderTargets(int width, int height);
+
+	/// <summary>
+	/// Reallocates the render targets once a pending resize has settled
+	/// </summary>
+	void UpdateRenderTargets();
+
+	/// <summary>
+	/// True while the camera or a transform tool moved within the settle time
+	/// </summary>
+	bool IsInteracting();
+
+	/// <summary>
+	/// Reads back the previous render's GPU time and adjusts resolutionScale toward the frame budget
+	/// </summary>
+	void UpdateResolutionScale();
+
+	/// <summary>
+	/// Collects the previous render's GPU time if it is available yet
+	/// </summary>
+	void ReadRenderTimeQuery();
+
+	/// <summary>
+	/// Frames drawn at a reduced resolution or with proxies, replaced by a full frame once input settles
+	/// </summary>
+	bool IsDegradedFrame() const {
+		return frameWidth != renderWidth || frameHeight != renderHeight || stats.meshesProxied > 0;
+	}
+
+	bool MeshIntersectsFrustum(Mesh& mesh, const Frustum& frustum);
 };
@@ -1,15 +1,65 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+// Draws one screen space quad per edge, instanced: gl_InstanceID picks the edge (and the copy of instanced meshes),
+// gl_VertexID the quad corner. Both endpoints are fetched from texture buffers over the mesh's own index and vertex buffers.
+
+uniform usamplerBuffer edgeIndices; // eboEdges, two indices per edge
+uniform samplerBuffer vertexData;   // vbo, position and normal interleaved (6 floats per vertex)
+uniform int edgeBase;               // first edge of the range being drawn
+uniform int edgeCount;              // edges in the range, the instances run through them once per copy
+uniform samplerBuffer instanceTransforms; // four texels (columns) per copy matrix
+uniform bool instanced;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec2 viewportSize;
+uniform float lineWidth = 1.0;
 
-out vec3 vertWorldPos; // MUST match name/type used by GS
+vec3 FetchPosition(uint index)
+{
+    int base = int(index) * 6;
+    return vec3(texelFetch(vertexData, base).r,
+                texelFetch(vertexData, base + 1).r,
+                texelFetch(vertexData, base + 2).r);
+}
+
+mat4 InstanceMatrix(int copy)
+{
+    if (!instanced)
+        return mat4(1.0);
+    int base = copy * 4;
+    return mat4(texelFetch(instanceTransforms, base), texelFetch(instanceTransforms, base + 1),
+                texelFetch(instanceTransforms, base + 2), texelFetch(instanceTransforms, base + 3));
+}
 
 void main()
 {
-    vec4 world = model * vec4(aPos, 1.0);
-    vertWorldPos = world.xyz;                 // <<-- important!
-    gl_Position = projection * view * world;  // GS will override, but OK to set
+    int edge = edgeBase + gl_InstanceID % edgeCount;
+    uint i0 = texelFetch(edgeIndices, edge * 2).r;
+    uint i1 = texelFetch(edgeIndices, edge * 2 + 1).r;
+    mat4 objectToWorld = model * InstanceMatrix(gl_InstanceID / edgeCount);
+
+    // Project endpoints
+    vec4 clip0 = projection * view * objectToWorld * vec4(FetchPosition(i0), 1.0);
+    vec4 clip1 = projection * view * objectToWorld * vec4(FetchPosition(i1), 1.0);
+
+    // Convert to screen pixels
+    vec2 pix0 = (clip0.xy / clip0.w * 0.5 + 0.5) * viewportSize;
+    vec2 pix1 = (clip1.xy / clip1.w * 0.5 + 0.5) * viewportSize;
+
+    vec2 delta = pix1 - pix0;
+    float len = length(delta);
+    if (len < 1e-6)
+        delta = vec2(1.0, 0.0), len = 1.0;
+
+    vec2 dir = delta / len;
+    vec2 normal = vec2(-dir.y, dir.x) * (lineWidth * 0.5);
+
+    // Strip order: start + normal, start - normal, end + normal, end - normal
+    bool atEnd = gl_VertexID >= 2;
+    vec4 clip = atEnd ? clip1 : clip0;
+    vec2 pix = (atEnd ? pix1 : pix0) + ((gl_VertexID & 1) == 0 ? normal : -normal);
+
+    vec2 ndc = (pix / viewportSize) * 2.0 - 1.0;
+    gl_Position = vec4(ndc * clip.w, clip.z, clip.w);
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-﻿#version 330 core
+#version 330 core
 
 in vec3 worldPos;
 out vec4 FragColor;
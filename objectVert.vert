@@ -9,10 +9,27 @@ out vec3 FragPos;
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+// Copies drawn by instanced modifiers, four texels (columns) per matrix in the object's local space
+uniform samplerBuffer instanceTransforms;
+uniform bool instanced;
+// First copy of the draw, mirrored copies are drawn separately from the rest
+uniform int instanceBase;
+
+mat4 InstanceMatrix()
+{
+	if (!instanced)
+		return mat4(1.0);
+	int base = (instanceBase + gl_InstanceID) * 4;
+	return mat4(texelFetch(instanceTransforms, base), texelFetch(instanceTransforms, base + 1),
+		texelFetch(instanceTransforms, base + 2), texelFetch(instanceTransforms, base + 3));
+}
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-	FragPos = vec3(model * vec4(aPos, 1.0));
-	Normal = aNormal;
+	mat4 instance = InstanceMatrix();
+	vec4 worldPos = model * instance * vec4(aPos, 1.0);
+	gl_Position = projection * view * worldPos;
+	FragPos = vec3(worldPos);
+	// Array and curve copies can be scaled unevenly, which the normals have to undo rather than follow
+	Normal = instanced ? transpose(inverse(mat3(instance))) * aNormal : aNormal;
 }
\ No newline at end of file